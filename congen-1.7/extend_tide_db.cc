@@ -0,0 +1,182 @@
+/*  extend_tide_db:  change the range of years covered by a TCD file.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The constituent definitions are read from congen input on stdin and
+// matched to the constituents of the TCD file by name.  Years that the
+// file already covers keep the values it has; only the missing years
+// are taken from libcongen.  The file is then rewritten in place with
+// set_tide_db_years, which touches nothing but the header tables and
+// the position of the records.
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <Congen>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include <iostream>
+#include <cstring>
+#include "tcd.h"
+
+
+#if Congen_interfaceRevision != 0
+#error trying to compile with an incompatible version of libcongen
+#endif
+
+
+static Congen::year_t getYear (char const * const arg) {
+  assert (arg);
+  Congen::year_t y;
+  if (sscanf (arg, "%" SCNu16, &y) != 1) {
+    fprintf (stderr, "Bad year: %s\n", arg);
+    exit (-1);
+  }
+  if (y < 1 || y > 4000) {
+    fprintf (stderr, "Year out of range: %s\n", arg);
+    exit (-1);
+  }
+  return y;
+}
+
+
+static void usage () {
+  fprintf (stderr,
+    "Usage: extend_tide_db -b year -e year [-a1|-a2] [-f] file.tcd\n"
+    "              < congen_input.txt\n");
+  exit (-1);
+}
+
+
+int main (int argc, char **argv) {
+
+  bool ambitiousSpeeds (false), force (false);
+  Congen::year_t firstYear (0), lastYear (0);
+  char *tcdFileName (NULL);
+
+  for (int argnum(1); argnum<argc; ++argnum) {
+    if (!strcmp (argv[argnum], "-a1"))
+      ambitiousSpeeds = false;
+    else if (!strcmp (argv[argnum], "-a2"))
+      ambitiousSpeeds = true;
+    else if (!strcmp (argv[argnum], "-f"))
+      force = true;
+    else if (!strcmp (argv[argnum], "-b")) {
+      if (++argnum >= argc) {
+        fprintf (stderr, "Year missing after -b\n");
+        exit (-1);
+      }
+      firstYear = getYear (argv[argnum]);
+    } else if (!strcmp (argv[argnum], "-e")) {
+      if (++argnum >= argc) {
+        fprintf (stderr, "Year missing after -e\n");
+        exit (-1);
+      }
+      lastYear = getYear (argv[argnum]);
+    } else if (argv[argnum][0] != '-' && !tcdFileName)
+      tcdFileName = argv[argnum];
+    else
+      usage ();
+  }
+
+  if (!tcdFileName || !firstYear || !lastYear)
+    usage ();
+  if (lastYear < firstYear) {
+    fprintf (stderr, "End year is before start year\n");
+    exit (-1);
+  }
+  uint_fast16_t numYears (lastYear - firstYear + 1);
+
+  // Only the equilibrium arguments and node factors are used, and those
+  // don't depend on the epoch for speeds, but the option is accepted so
+  // the command line can match the one given to congen.
+  Congen::year_t epochForSpeeds (1900);
+  if (ambitiousSpeeds)
+    epochForSpeeds = (firstYear + lastYear) / 2;
+
+  std::vector<Congen::Constituent> constituents;
+  unsigned lineno (Congen::parseLegacyInput (std::cin, firstYear, lastYear,
+					     epochForSpeeds, constituents));
+  if (lineno) {
+    fprintf (stderr, "Error on input line %u\n", lineno);
+    exit (-1);
+  }
+
+  char **names;
+  double *speeds;
+  float **equilibriumArgs;
+  float **nodeFactors;
+  Congen::makeArrays (constituents, names, speeds, equilibriumArgs,
+		      nodeFactors);
+
+  if (!open_tide_db (tcdFileName)) {
+    fprintf (stderr, "Can't open %s\n", tcdFileName);
+    exit (-1);
+  }
+  DB_HEADER_PUBLIC db (get_tide_db_header());
+
+  // Rows of the new tables, in the order of the TCD file.  Years the
+  // file already has are copied from it and compared with libcongen's
+  // values, which should agree to the precision of the file.
+  std::vector<float *> newArgs (db.constituents), newNods (db.constituents);
+  unsigned mismatches (0);
+  for (uint_fast32_t i(0); i<db.constituents; ++i) {
+    const char *name (get_constituent (i));
+    uint_fast32_t k (0);
+    while (k < constituents.size() && strcmp (names[k], name))
+      ++k;
+    if (k == constituents.size()) {
+      fprintf (stderr, "Constituent %s is not in the input\n", name);
+      exit (-1);
+    }
+
+    newArgs[i] = new float [numYears];
+    newNods[i] = new float [numYears];
+    float *oldArgs (get_equilibriums (i)), *oldNods (get_node_factors (i));
+    for (uint_fast16_t y(0); y<numYears; ++y) {
+      newArgs[i][y] = equilibriumArgs[k][y];
+      newNods[i][y] = nodeFactors[k][y];
+      int_fast32_t old (firstYear + y - db.start_year);
+      if (old < 0 || old >= (int_fast32_t)db.number_of_years)
+        continue;
+      double dArg (fabs (oldArgs[old] - newArgs[i][y]));
+      if (dArg > 180.0)
+        dArg = 360.0 - dArg;
+      if (dArg > 0.0101 || fabs (oldNods[old] - newNods[i][y]) > 0.000101)
+        ++mismatches;
+      newArgs[i][y] = oldArgs[old];
+      newNods[i][y] = oldNods[old];
+    }
+  }
+
+  if (mismatches && !force) {
+    fprintf (stderr,
+      "%u values in the years %s already covers don't match the input.\n"
+      "It was probably built from different constituent definitions.  Use -f\n"
+      "to extend it anyway.\n", mismatches, tcdFileName);
+    exit (-1);
+  }
+
+  if (!set_tide_db_years (firstYear, numYears, &newArgs[0], &newNods[0])) {
+    fprintf (stderr, "set_tide_db_years returned nonspecific failure\n");
+    exit (-1);
+  }
+  close_tide_db();
+  printf ("%s now covers %u through %u (was %d through %d)\n", tcdFileName,
+    firstYear, lastYear, db.start_year,
+    db.start_year + (int)db.number_of_years - 1);
+  return 0;
+}
@@ -0,0 +1,447 @@
+/*****************************************************************************\
+
+                            DISTRIBUTION STATEMENT
+
+    This source file is unclassified, distribution unlimited, public
+    domain.  It is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+\*****************************************************************************/
+
+/*
+  bit_pack_bench - equivalence harness and microbenchmark for the
+  bit_pack.c codec.
+
+  Usage:  bit_pack_bench [-t] [file.tcd]
+
+  bit_pack_bench is linked directly against bit_pack.c (not libtcd.la),
+  so a replacement codec can be dropped in and checked without touching
+  the library.  "make bench-bit-pack" builds and runs it.
+
+  Part 1 compares bit_pack, bit_unpack, and signed_bit_unpack with the
+  reference implementation below, a frozen copy of the NAVO-derived code
+  in bit_pack.c.  Every width from 1 to 32 bits is tried at every start
+  offset from 0 to 63 (every bit within a byte, at every byte and word
+  alignment a wider implementation might care about), with random
+  surrounding buffer contents and random 32-bit values.  The upper bits
+  of the values are deliberately not cleared: tide_db.c packs negative
+  numbers by handing over the whole NV_INT32, so a replacement must
+  ignore those bits exactly as the reference does.  The packed buffers
+  must match byte for byte, including the bytes around the field.
+  signed_bit_unpack is only compared up to 31 bits; at 32 the reference
+  shifts by the full width of the type, which is undefined.
+
+  Part 2 reports fields per second for packing and unpacking runs of
+  consecutive fields at each width the TCD header uses.  The widths are
+  read from the "BITS" lines of the given database's ASCII header, or
+  else taken from the shipped harmonics files.
+
+  -t runs part 1 only.  Results are printed as JSON.  The exit status is
+  1 if any comparison failed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tcd.h"
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+/*  bit_pack.c has no header of its own; these match tide_db.c.  */
+
+void bit_pack (NV_U_BYTE *, NV_U_INT32, NV_U_INT32, NV_INT32);
+NV_U_INT32 bit_unpack (NV_U_BYTE *, NV_U_INT32, NV_U_INT32);
+NV_INT32 signed_bit_unpack (NV_U_BYTE buffer[], NV_U_INT32 start,
+                            NV_U_INT32 numbits);
+
+
+/*****************************************************************************\
+  Reference codec.  Do not "improve" this: it is the definition of the
+  format that the real one is checked against.
+\*****************************************************************************/
+
+static NV_U_BYTE        ref_mask[8] = {0x00, 0x80, 0xc0, 0xe0, 0xf0, 0xf8,
+                        0xfc, 0xfe}, ref_notmask[8] = {0xff, 0x7f, 0x3f,
+                        0x1f, 0x0f, 0x07, 0x03, 0x01};
+
+static void ref_bit_pack (NV_U_BYTE buffer[], NV_U_INT32 start,
+NV_U_INT32 numbits, NV_INT32 value)
+{
+    NV_INT32                start_byte, end_byte, start_bit, end_bit, i;
+
+    i = start + numbits;
+    start_byte = start >> 3;
+    end_byte = i >> 3;
+    start_bit = start & 7;
+    end_bit = i & 7;
+    i = end_byte - start_byte - 1;
+
+    if (start_byte == end_byte)
+    {
+        buffer[start_byte] &= ref_mask[start_bit] | ref_notmask[end_bit];
+        buffer[start_byte] |= (value << (8 - end_bit)) &
+            (ref_notmask[start_bit] & ref_mask[end_bit]);
+    }
+    else
+    {
+        buffer[start_byte] &= ref_mask[start_bit];
+        buffer[start_byte++] |= (value >> (numbits - (8 - start_bit))) &
+            ref_notmask[start_bit];
+        while (i--)
+        {
+            buffer[start_byte] &= 0;
+            buffer[start_byte++] |= (value >> ((i << 3) + end_bit)) & 255;
+        }
+        if (end_bit > 0)
+        {
+            buffer[start_byte] &= ref_notmask[end_bit];
+            buffer[start_byte] |= (value << (8 - end_bit));
+        }
+    }
+}
+
+static NV_U_INT32 ref_bit_unpack (NV_U_BYTE buffer[], NV_U_INT32 start,
+NV_U_INT32 numbits)
+{
+    NV_INT32                start_byte, end_byte, start_bit, end_bit, i;
+    NV_U_INT32              value;
+
+    i = start + numbits;
+    start_byte = start >> 3;
+    end_byte = i >> 3;
+    start_bit = start & 7;
+    end_bit = i & 7;
+    i = end_byte - start_byte - 1;
+
+    if (start_byte == end_byte)
+    {
+        value = (NV_U_INT32) buffer[start_byte] & (ref_notmask[start_bit] &
+            ref_mask[end_bit]);
+        value >>= (8 - end_bit);
+    }
+    else
+    {
+        value = (NV_U_INT32) (buffer[start_byte++] & ref_notmask[start_bit])
+            << (numbits - (8 - start_bit));
+        while (i--)
+            value += (NV_U_INT32) buffer[start_byte++] << ((i << 3) + end_bit);
+        if (end_bit > 0)
+            value += (NV_U_INT32) (buffer[start_byte] & ref_mask[end_bit]) >>
+                (8 - end_bit);
+    }
+    return (value);
+}
+
+static NV_INT32 ref_signed_bit_unpack (NV_U_BYTE buffer[], NV_U_INT32 start,
+NV_U_INT32 numbits)
+{
+    static NV_INT32              extend_mask = 0x7fffffff;
+    NV_INT32                     value;
+
+    value = ref_bit_unpack (buffer, start, numbits);
+    if (value & (1 << (numbits - 1))) value |= (extend_mask << numbits);
+    return (value);
+}
+
+
+/*****************************************************************************\
+  Harness
+\*****************************************************************************/
+
+#define MAX_START       64
+#define TRIALS          64
+#define CASE_BYTES      16      /* (MAX_START - 1 + 32) bits, rounded up */
+#define BENCH_FIELDS    4096
+
+static unsigned long seed = 1;
+
+/*  32 random bits from a small LCG, so runs are repeatable everywhere.  */
+
+static NV_U_INT32 next_random ()
+{
+    NV_U_INT32              hi, lo;
+
+    seed = seed * 1103515245UL + 12345UL;
+    hi = (NV_U_INT32) (seed >> 16) & 0xffff;
+    seed = seed * 1103515245UL + 12345UL;
+    lo = (NV_U_INT32) (seed >> 16) & 0xffff;
+    return (hi << 16) | lo;
+}
+
+
+static double now_ns ()
+{
+#if defined (HAVE_CLOCK_GETTIME) && defined (CLOCK_MONOTONIC)
+    struct timespec         ts;
+
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+        return ts.tv_sec * 1.0e9 + ts.tv_nsec;
+#endif
+    return clock () * 1.0e9 / CLOCKS_PER_SEC;
+}
+
+
+static unsigned long mismatches = 0;
+
+static void report (const char *what, NV_U_INT32 width, NV_U_INT32 start,
+NV_U_INT32 value)
+{
+    if (++mismatches <= 10)
+        fprintf (stderr, "bit_pack_bench: %s differs at width %u start %u "
+            "(value 0x%08x)\n", what, width, start, value);
+}
+
+
+static unsigned long check_case (NV_U_INT32 width, NV_U_INT32 start,
+NV_U_INT32 value)
+{
+    NV_U_BYTE               ref[CASE_BYTES], got[CASE_BYTES];
+    NV_U_INT32              i;
+    unsigned long           cases = 0;
+
+    for (i = 0 ; i < CASE_BYTES ; ++i) ref[i] = (NV_U_BYTE) next_random ();
+    memcpy (got, ref, CASE_BYTES);
+
+    /*  Unpacking from random contents first, then packing into them.  */
+
+    if (bit_unpack (got, start, width) != ref_bit_unpack (ref, start, width))
+        report ("bit_unpack", width, start, value);
+    ++cases;
+    if (width < 32)
+    {
+        if (signed_bit_unpack (got, start, width) !=
+            ref_signed_bit_unpack (ref, start, width))
+            report ("signed_bit_unpack", width, start, value);
+        ++cases;
+    }
+
+    ref_bit_pack (ref, start, width, (NV_INT32) value);
+    bit_pack (got, start, width, (NV_INT32) value);
+    if (memcmp (ref, got, CASE_BYTES))
+        report ("bit_pack", width, start, value);
+    ++cases;
+
+    return cases;
+}
+
+
+static unsigned long check_equivalence ()
+{
+    NV_U_INT32              width, start, trial, top;
+    unsigned long           cases = 0;
+
+    for (width = 1 ; width <= 32 ; ++width)
+    {
+        top = width == 32 ? 0xffffffff : ((NV_U_INT32) 1 << width) - 1;
+        for (start = 0 ; start < MAX_START ; ++start)
+        {
+            /*  The edges of the field's range, then random values with
+                whatever happens to be in the upper bits.  */
+
+            cases += check_case (width, start, 0);
+            cases += check_case (width, start, top);
+            cases += check_case (width, start, 0xffffffff);
+            cases += check_case (width, start, (NV_U_INT32) 1 << (width - 1));
+            for (trial = 0 ; trial < TRIALS ; ++trial)
+                cases += check_case (width, start, next_random ());
+        }
+    }
+    return cases;
+}
+
+
+/*  A field width and the header fields that use it.  */
+
+typedef struct
+{
+    NV_U_INT32              width;
+    char                    fields[256];
+} WIDTH;
+
+static WIDTH                widths[33];
+static NV_U_INT32           width_count = 0;
+
+static void add_width (NV_U_INT32 width, const char *field)
+{
+    NV_U_INT32              i;
+    WIDTH                   *w = NULL;
+
+    if (width < 1 || width > 32) return;
+    for (i = 0 ; i < width_count ; ++i)
+        if (widths[i].width == width) w = &widths[i];
+    if (!w)
+    {
+        for (i = width_count++ ; i && widths[i - 1].width > width ; --i)
+            widths[i] = widths[i - 1];
+        w = &widths[i];
+        w->width = width;
+        w->fields[0] = '\0';
+    }
+    if (strlen (w->fields) + strlen (field) + 3 < sizeof (w->fields))
+    {
+        if (w->fields[0]) strcat (w->fields, ", ");
+        strcat (w->fields, field);
+    }
+}
+
+/*  As found in the shipped harmonics files.  */
+
+static void default_widths ()
+{
+    add_width (31, "SPEED");
+    add_width (16, "EQUILIBRIUM");
+    add_width (15, "NODE");
+    add_width (19, "AMPLITUDE");
+    add_width (16, "EPOCH");
+    add_width (4, "RECORD TYPE");
+    add_width (25, "LATITUDE");
+    add_width (26, "LONGITUDE");
+    add_width (16, "RECORD SIZE");
+    add_width (18, "STATION");
+    add_width (28, "DATUM OFFSET");
+    add_width (27, "DATE");
+    add_width (10, "MONTHS ON STATION");
+    add_width (4, "CONFIDENCE VALUE");
+    add_width (13, "TIME");
+    add_width (17, "LEVEL ADD");
+    add_width (16, "LEVEL MULTIPLY");
+    add_width (9, "DIRECTION");
+    add_width (3, "LEVEL UNIT");
+    add_width (2, "DIRECTION UNIT");
+    add_width (4, "RESTRICTION");
+    add_width (7, "DATUM");
+    add_width (4, "LEGALESE");
+    add_width (8, "CONSTITUENT");
+    add_width (10, "TZFILE");
+    add_width (9, "COUNTRY");
+    add_width (8, "string characters");
+}
+
+static int file_widths (const char *file)
+{
+    FILE                    *fp;
+    char                    line[256], field[256];
+    unsigned int            width;
+
+    if ((fp = fopen (file, "rb")) == NULL) return 0;
+    while (fgets (line, sizeof (line), fp))
+    {
+        if (strstr (line, "[END OF ASCII HEADER DATA]")) break;
+        if (sscanf (line, "[%255[^]]] = %u", field, &width) == 2 &&
+            strlen (field) > 5 && !strcmp (field + strlen (field) - 5,
+            " BITS"))
+        {
+            field[strlen (field) - 5] = '\0';
+            add_width (width, field);
+        }
+    }
+    fclose (fp);
+    if (width_count) add_width (8, "string characters");
+    return width_count > 0;
+}
+
+
+/*  Times packing and unpacking BENCH_FIELDS consecutive fields, repeated
+    until about a tenth of a second has gone by.  */
+
+static void bench_width (const WIDTH *w, int last)
+{
+    static NV_U_BYTE        buf[BENCH_FIELDS * 4 + 4];
+    static NV_INT32         values[BENCH_FIELDS];
+    NV_U_INT32              i, pos;
+    unsigned long           reps, n;
+    double                  t, pack_ns, unpack_ns, signed_ns;
+    volatile NV_U_INT32     sink = 0;
+
+    for (i = 0 ; i < BENCH_FIELDS ; ++i)
+        values[i] = (NV_INT32) (next_random () >> (32 - w->width));
+
+    reps = 0;
+    t = now_ns ();
+    do
+    {
+        for (n = 0 ; n < 16 ; ++n)
+            for (i = 0, pos = 0 ; i < BENCH_FIELDS ; ++i, pos += w->width)
+                bit_pack (buf, pos, w->width, values[i]);
+        reps += 16;
+    } while ((pack_ns = now_ns () - t) < 1.0e8);
+    pack_ns /= (double) reps * BENCH_FIELDS;
+
+    reps = 0;
+    t = now_ns ();
+    do
+    {
+        for (n = 0 ; n < 16 ; ++n)
+            for (i = 0, pos = 0 ; i < BENCH_FIELDS ; ++i, pos += w->width)
+                sink += bit_unpack (buf, pos, w->width);
+        reps += 16;
+    } while ((unpack_ns = now_ns () - t) < 1.0e8);
+    unpack_ns /= (double) reps * BENCH_FIELDS;
+
+    signed_ns = 0.0;
+    if (w->width < 32)
+    {
+        reps = 0;
+        t = now_ns ();
+        do
+        {
+            for (n = 0 ; n < 16 ; ++n)
+                for (i = 0, pos = 0 ; i < BENCH_FIELDS ; ++i, pos += w->width)
+                    sink += signed_bit_unpack (buf, pos, w->width);
+            reps += 16;
+        } while ((signed_ns = now_ns () - t) < 1.0e8);
+        signed_ns /= (double) reps * BENCH_FIELDS;
+    }
+
+    printf ("    {\"width\": %u, \"fields\": \"%s\", "
+        "\"pack_per_sec\": %.0f, \"unpack_per_sec\": %.0f, "
+        "\"signed_unpack_per_sec\": %.0f}%s\n", w->width, w->fields,
+        1.0e9 / pack_ns, 1.0e9 / unpack_ns,
+        signed_ns > 0.0 ? 1.0e9 / signed_ns : 0.0, last ? "" : ",");
+}
+
+
+int main (int argc, char **argv)
+{
+    int                     test_only = 0, i;
+    const char              *file = NULL;
+    unsigned long           cases;
+
+    for (i = 1 ; i < argc ; ++i)
+    {
+        if (!strcmp (argv[i], "-t")) test_only = 1;
+        else if (!file) file = argv[i];
+        else
+        {
+            fprintf (stderr, "Usage:  bit_pack_bench [-t] [file.tcd]\n");
+            return 2;
+        }
+    }
+
+    cases = check_equivalence ();
+    printf ("{\n  \"equivalence\": {\"cases\": %lu, \"mismatches\": %lu}",
+        cases, mismatches);
+
+    if (!test_only)
+    {
+        if (!file || !file_widths (file))
+        {
+            if (file)
+                fprintf (stderr, "bit_pack_bench: can't read widths from "
+                    "%s, using the built-in ones\n", file);
+            default_widths ();
+        }
+
+        printf (",\n  \"widths\": [\n");
+        for (i = 0 ; i < (int) width_count ; ++i)
+            bench_width (&widths[i], i == (int) width_count - 1);
+        printf ("  ]");
+    }
+    printf ("\n}\n");
+
+    return mismatches != 0;
+}
@@ -0,0 +1,130 @@
+/*****************************************************************************\
+
+                            DISTRIBUTION STATEMENT
+
+    This source file is unclassified, distribution unlimited, public
+    domain.  It is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+\*****************************************************************************/
+
+/*
+  read_alloc_test - checks that steady-state record reads make no heap
+  allocations.
+
+  The database is named by the TCD_TEST_FILE environment variable
+  (make check points it at the free harmonics file in tcd-utils).
+  malloc, calloc, and realloc are interposed to count calls, which
+  relies on glibc's __libc_* entry points; elsewhere the test is
+  skipped.
+
+  Every record is read once to warm up, then every record is read again
+  through read_tide_record, read_next_tide_record, and
+  read_tide_record_into.  The second pass must not allocate.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tcd.h"
+
+#define SKIP 77
+
+#ifdef __GLIBC__
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static unsigned long allocations = 0;
+
+void *malloc (size_t size)
+{
+    ++allocations;
+    return __libc_malloc (size);
+}
+
+void *calloc (size_t nmemb, size_t size)
+{
+    ++allocations;
+    return __libc_calloc (nmemb, size);
+}
+
+void *realloc (void *ptr, size_t size)
+{
+    ++allocations;
+    return __libc_realloc (ptr, size);
+}
+
+int main ()
+{
+    const char              *file;
+    static TIDE_RECORD      rec;
+    DB_HEADER_PUBLIC        db;
+    NV_U_BYTE               *scratch;
+    NV_U_INT32              size;
+    NV_INT32                i, n;
+    unsigned long           before, used;
+    int                     fail = 0;
+
+    if (!(file = getenv ("TCD_TEST_FILE")) || !open_tide_db (file))
+    {
+        fprintf (stderr, "read_alloc_test: no test database, skipping\n");
+        return SKIP;
+    }
+    db = get_tide_db_header ();
+    n = db.number_of_records;
+
+    size = get_max_record_size ();
+    if (!(scratch = (NV_U_BYTE *) malloc (size)))
+    {
+        perror ("Allocating scratch buffer");
+        return 1;
+    }
+
+    /*  Warm up: stdio buffer, read_tide_record's own buffer.  */
+
+    for (i = 0 ; i < n ; ++i) read_tide_record (i, &rec);
+
+
+    before = allocations;
+    for (i = 0 ; i < n ; ++i)
+    {
+        if (read_tide_record (i, &rec) != i) fail = 1;
+    }
+    used = allocations - before;
+    printf ("read_tide_record:       %lu allocations for %d reads\n", used, n);
+    if (used) fail = 1;
+
+    before = allocations;
+    read_tide_record (0, &rec);
+    while (read_next_tide_record (&rec) >= 0) ;
+    used = allocations - before;
+    printf ("read_next_tide_record:  %lu allocations for %d reads\n", used, n);
+    if (used) fail = 1;
+
+    before = allocations;
+    for (i = n - 1 ; i >= 0 ; --i)
+    {
+        if (read_tide_record_into (i, &rec, TIDE_FIELDS_ALL, scratch, size)
+            != i) fail = 1;
+    }
+    used = allocations - before;
+    printf ("read_tide_record_into:  %lu allocations for %d reads\n", used, n);
+    if (used) fail = 1;
+
+    free (scratch);
+    close_tide_db ();
+
+    return fail;
+}
+
+#else
+
+int main ()
+{
+    fprintf (stderr, "read_alloc_test: needs glibc to count allocations, skipping\n");
+    return SKIP;
+}
+
+#endif
@@ -0,0 +1,286 @@
+/*****************************************************************************\
+
+                            DISTRIBUTION STATEMENT
+
+    This source file is unclassified, distribution unlimited, public
+    domain.  It is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+\*****************************************************************************/
+
+/*
+  read_bench - times the libtcd read path and prints the results as JSON.
+
+  Usage:  read_bench [-n scale] file.tcd ...
+
+  "make bench" builds it and runs it on the harmonics files shipped in
+  the tree.  For each database the following are timed:
+
+    open_cold       open_tide_db after asking the kernel to drop the
+                    file from the page cache (posix_fadvise; where that
+                    is unavailable, or the kernel ignores it, this is
+                    just another warm open)
+    open_warm       open_tide_db with the file already cached
+    close           close_tide_db
+    read_next       read_tide_record (0) then read_next_tide_record to
+                    the end, per record
+    read_random     read_tide_record on pseudo-random record numbers
+    search_station  search_station for a few substrings, per call,
+                    including the final call that returns -1
+    find_station    find_station on the names of random stations
+    get_nearest     get_nearest_partial_tide_record on random positions
+
+  Every result gives the iteration count and the mean, minimum, and
+  maximum time per operation in nanoseconds.  -n multiplies the default
+  iteration counts.  The random sequences use a fixed seed so that runs
+  are comparable.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tcd.h"
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+
+typedef struct
+{
+    unsigned long           iterations;
+    double                  total_ns;
+    double                  min_ns;
+    double                  max_ns;
+} RESULT;
+
+
+static double now_ns ()
+{
+#if defined (HAVE_CLOCK_GETTIME) && defined (CLOCK_MONOTONIC)
+    struct timespec         ts;
+
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+        return ts.tv_sec * 1.0e9 + ts.tv_nsec;
+#endif
+    return clock () * 1.0e9 / CLOCKS_PER_SEC;
+}
+
+
+/*  Adds one timed batch of ops operations to r.  */
+
+static void add_sample (RESULT *r, double ns, unsigned long ops)
+{
+    double                  per_op;
+
+    if (!ops) return;
+    per_op = ns / ops;
+    if (!r->iterations || per_op < r->min_ns) r->min_ns = per_op;
+    if (!r->iterations || per_op > r->max_ns) r->max_ns = per_op;
+    r->iterations += ops;
+    r->total_ns += ns;
+}
+
+
+/*  Small LCG so the sequences don't depend on the C library's rand.  */
+
+static unsigned long seed;
+
+static unsigned long next_random (unsigned long range)
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return ((seed >> 16) & 0x7fffffffUL) % range;
+}
+
+
+static void drop_cache (const char *file)
+{
+#if defined (HAVE_POSIX_FADVISE) && defined (POSIX_FADV_DONTNEED)
+    int                     fd;
+
+    if ((fd = open (file, O_RDONLY)) >= 0)
+    {
+        posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+        close (fd);
+    }
+#else
+    (void) file;
+#endif
+}
+
+
+static void print_string (const char *s)
+{
+    putchar ('"');
+    for ( ; *s ; ++s)
+    {
+        if (*s == '"' || *s == '\\') printf ("\\%c", *s);
+        else if ((unsigned char) *s < 0x20) printf ("\\u%04x", *s);
+        else putchar (*s);
+    }
+    putchar ('"');
+}
+
+
+static void print_result (const char *name, const RESULT *r, int last)
+{
+    printf ("        \"%s\": {\"iterations\": %lu, \"mean_ns\": %.1f, "
+        "\"min_ns\": %.1f, \"max_ns\": %.1f}%s\n", name, r->iterations,
+        r->iterations ? r->total_ns / r->iterations : 0.0, r->min_ns,
+        r->max_ns, last ? "" : ",");
+}
+
+
+static void bench_file (const char *file, unsigned long scale, int last)
+{
+    static const char       *terms[] = {"harbor", "point", "island",
+                                        "no such station"};
+    static TIDE_RECORD      rec;
+    TIDE_STATION_HEADER     header;
+    DB_HEADER_PUBLIC        db;
+    RESULT                  open_cold, open_warm, close_db, read_next,
+                            read_random, search, find, nearest;
+    NV_CHAR                 name[ONELINER_LENGTH];
+    unsigned long           i, j, ops;
+    NV_INT32                n, num;
+    double                  t;
+
+    memset (&open_cold, 0, sizeof (RESULT));
+    open_warm = close_db = read_next = read_random = search = find =
+        nearest = open_cold;
+    seed = 1;
+
+    for (i = 0 ; i < 5 * scale ; ++i)
+    {
+        drop_cache (file);
+        t = now_ns ();
+        open_tide_db (file);
+        add_sample (&open_cold, now_ns () - t, 1);
+        close_tide_db ();
+    }
+
+    for (i = 0 ; i < 20 * scale ; ++i)
+    {
+        t = now_ns ();
+        open_tide_db (file);
+        add_sample (&open_warm, now_ns () - t, 1);
+        t = now_ns ();
+        close_tide_db ();
+        add_sample (&close_db, now_ns () - t, 1);
+    }
+
+    open_tide_db (file);
+    db = get_tide_db_header ();
+    n = db.number_of_records;
+
+    for (i = 0 ; i < 3 * scale ; ++i)
+    {
+        t = now_ns ();
+        ops = read_tide_record (0, &rec) >= 0;
+        while (read_next_tide_record (&rec) >= 0) ++ops;
+        add_sample (&read_next, now_ns () - t, ops);
+    }
+
+    for (i = 0 ; i < 20 * scale ; ++i)
+    {
+        t = now_ns ();
+        for (j = 0 ; j < 1000 ; ++j)
+            read_tide_record ((NV_INT32) next_random (n), &rec);
+        add_sample (&read_random, now_ns () - t, 1000);
+    }
+
+    for (i = 0 ; i < scale ; ++i)
+    {
+        for (j = 0 ; j < sizeof (terms) / sizeof (terms[0]) ; ++j)
+        {
+            t = now_ns ();
+            ops = 1;
+            while (search_station (terms[j]) >= 0) ++ops;
+            add_sample (&search, now_ns () - t, ops);
+        }
+    }
+
+    for (i = 0 ; i < 20 * scale ; ++i)
+    {
+        num = (NV_INT32) next_random (n);
+        get_partial_tide_record (num, &header);
+        strcpy (name, header.name);
+        t = now_ns ();
+        find_station (name);
+        add_sample (&find, now_ns () - t, 1);
+    }
+
+    for (i = 0 ; i < 20 * scale ; ++i)
+    {
+        double lat = next_random (18000) / 100.0 - 90.0;
+        double lon = next_random (36000) / 100.0 - 180.0;
+
+        t = now_ns ();
+        get_nearest_partial_tide_record (lat, lon, &header);
+        add_sample (&nearest, now_ns () - t, 1);
+    }
+
+    close_tide_db ();
+
+    printf ("    {\n      \"file\": ");
+    print_string (file);
+    printf (",\n      \"version\": ");
+    print_string (db.version);
+    printf (",\n      \"records\": %d,\n      \"results\": {\n", n);
+    print_result ("open_cold", &open_cold, 0);
+    print_result ("open_warm", &open_warm, 0);
+    print_result ("close", &close_db, 0);
+    print_result ("read_next", &read_next, 0);
+    print_result ("read_random", &read_random, 0);
+    print_result ("search_station", &search, 0);
+    print_result ("find_station", &find, 0);
+    print_result ("get_nearest", &nearest, 1);
+    printf ("      }\n    }%s\n", last ? "" : ",");
+}
+
+
+int main (int argc, char **argv)
+{
+    unsigned long           scale = 1;
+    int                     i, first = 1;
+
+    if (argc > 2 && !strcmp (argv[1], "-n"))
+    {
+        scale = strtoul (argv[2], NULL, 10);
+        if (!scale) scale = 1;
+        first = 3;
+    }
+    if (first >= argc)
+    {
+        fprintf (stderr, "Usage:  read_bench [-n scale] file.tcd ...\n");
+        return 2;
+    }
+
+    /*  Check them all up front so a bad name doesn't leave half a
+        JSON document behind.  */
+
+    for (i = first ; i < argc ; ++i)
+    {
+        if (!open_tide_db (argv[i]))
+        {
+            fprintf (stderr, "read_bench: can't open %s\n", argv[i]);
+            return 1;
+        }
+        close_tide_db ();
+    }
+
+    printf ("{\n  \"libtcd\": ");
+    print_string (LIBTCD_VERSION);
+    printf (",\n  \"scale\": %lu,\n  \"databases\": [\n", scale);
+    for (i = first ; i < argc ; ++i)
+        bench_file (argv[i], scale, i == argc - 1);
+    printf ("  ]\n}\n");
+
+    return 0;
+}
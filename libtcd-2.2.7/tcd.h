@@ -61,6 +61,11 @@
 #define LIBTCD_MAJOR_REV 2
 #define LIBTCD_MINOR_REV 2
 
+/* Major revision of the large format written by create_large_tide_db:
+   64-bit file offsets and wider station and record size fields.
+   Libraries that only know LIBTCD_MAJOR_REV refuse to open it. */
+#define LIBTCD_LARGE_MAJOR_REV 3
+
 
 /*
   COMPAT114 is defined here if and only if libtcd was compiled with
@@ -213,6 +218,78 @@ typedef struct
 #define NINT(a)   ((a)<0.0 ? (NV_INT32) ((a) - 0.5) : (NV_INT32) ((a) + 0.5))
 
 
+/*  Record iteration.  */
+/* See libtcd.html for documentation */
+
+/* Parts of the record decoded by iterate_tide_records.  The station
+   header and the fixed-size fields are always decoded. */
+#define TIDE_FIELDS_TEXT          0x01
+#define TIDE_FIELDS_CONSTITUENTS  0x02
+#define TIDE_FIELDS_ALL           (TIDE_FIELDS_TEXT | TIDE_FIELDS_CONSTITUENTS)
+
+/* Index predicate for iterate_tide_records.  A record must pass every
+   test that is enabled.  A box with min_lon > max_lon crosses the
+   180th meridian. */
+typedef struct
+{
+    NV_U_BYTE               record_type;    /* 0 for any */
+    NV_INT32                tzfile;         /* -1 for any */
+    NV_INT32                country;        /* -1 for any */
+    NV_BOOL                 bbox;           /* NVTrue to test the box */
+    NV_FLOAT64              min_lat;
+    NV_FLOAT64              max_lat;
+    NV_FLOAT64              min_lon;
+    NV_FLOAT64              max_lon;
+} TIDE_RECORD_FILTER;
+
+/* A database replaced by reload_tide_db, kept until
+   release_tide_db_snapshot. */
+typedef struct TIDE_DB_SNAPSHOT TIDE_DB_SNAPSHOT;
+
+/* Visitor for iterate_tide_records.  Return NVFalse to stop. */
+typedef NV_BOOL (*TIDE_RECORD_VISITOR) (const TIDE_RECORD *rec,
+                                        void *user_data);
+
+/* Entry points with latency histograms in TIDE_DB_STATS.
+   TIDE_STATS_FIND_TABLE covers find_tzfile, find_country,
+   find_level_units, find_dir_units, find_datum, find_legalese,
+   find_constituent, and find_restriction. */
+#define TIDE_STATS_READ_TIDE_RECORD     0
+#define TIDE_STATS_READ_TIDE_RECORDS    1
+#define TIDE_STATS_SEARCH_STATION       2
+#define TIDE_STATS_FIND_STATION         3
+#define TIDE_STATS_FIND_TABLE           4
+#define TIDE_STATS_GET_NEAREST          5
+#define TIDE_STATS_ADD_TIDE_RECORD      6
+#define TIDE_STATS_ENTRY_POINTS         7
+
+/* histogram[0] counts calls under 2 ns and histogram[i] calls from 2^i
+   up to 2^(i+1) ns; the last bucket also takes everything longer. */
+#define TIDE_STATS_BUCKETS              32
+
+typedef struct
+{
+    NV_U_INT64              calls;
+    NV_U_INT64              total_ns;
+    NV_U_INT64              max_ns;
+    NV_U_INT64              histogram[TIDE_STATS_BUCKETS];
+} TIDE_DB_LATENCY;
+
+/* Performance statistics; see enable_tide_db_stats. */
+typedef struct
+{
+    NV_U_INT64              bytes_read;
+    NV_U_INT64              seeks;          /* to reach a record */
+    NV_U_INT64              records_decoded;
+    NV_U_INT64              cache_hits;     /* record read buffer reused */
+    NV_U_INT64              cache_misses;   /* record read buffer grown */
+    NV_U_INT64              opens;
+    NV_U_INT64              open_ns;        /* includes index_build_ns */
+    NV_U_INT64              index_build_ns;
+    TIDE_DB_LATENCY         latency[TIDE_STATS_ENTRY_POINTS];
+} TIDE_DB_STATS;
+
+
 /*  Public function prototypes.  */
 
 /* Prints a low-level dump of the tide record to stderr. */
@@ -255,7 +332,9 @@ NV_FLOAT32 get_node_factor (NV_INT32 num, NV_INT32 year);
    constituent indicated by num [0,constituents-1].  The return value
    is a pointer into static memory which is an array of
    number_of_years floats, corresponding to the years start_year
-   through start_year+number_of_years-1. */
+   through start_year+number_of_years-1.  The tables are decoded on
+   demand; the first call for a constituent decodes its row, which
+   then stays in memory until the database is closed. */
 NV_FLOAT32 *get_equilibriums (NV_INT32 num);
 NV_FLOAT32 *get_node_factors (NV_INT32 num);
 
@@ -331,6 +410,41 @@ NV_BOOL open_tide_db (const NV_CHAR *file);
 /* Closes the open database. */
 void close_tide_db ();
 
+/* Rereads the header and index of the open database from the file,
+   writing out any pending changes first.  The memory holding the
+   station names and lookup tables is reused, which makes this much
+   cheaper than close_tide_db followed by open_tide_db.  Returns false
+   if the database could not be reopened. */
+NV_BOOL reopen_tide_db ();
+
+/* Returns true if the file of the open database is no longer the one
+   that was opened, because a new file was renamed into place or it
+   was rewritten by another process.  open_tide_db with the same file
+   name reopens it in that case instead of returning early. */
+NV_BOOL tide_db_changed ();
+
+/* If tide_db_changed, reads the new file's header and index into fresh
+   memory and then switches the open database over to them in one step.
+   The old database is returned rather than freed, so that strings and
+   tables obtained from it before the switch remain valid; pass it to
+   release_tide_db_snapshot when nothing uses them any more.  Returns
+   NULL, with the old database still open, if the file has not changed,
+   if it could not be read, or if there are unwritten changes. */
+TIDE_DB_SNAPSHOT *reload_tide_db ();
+void release_tide_db_snapshot (TIDE_DB_SNAPSHOT *snap);
+
+/* Staged updates.  begin_tide_db_update copies the open file to
+   file.new, and until commit_tide_db_update or abort_tide_db_update all
+   changes are made to the copy, so that the original is never seen
+   half-written.  commit_tide_db_update writes out the header, fsyncs the
+   copy, and renames it over the original; the database stays open.
+   abort_tide_db_update deletes the copy and reopens the original.
+   close_tide_db, and open_tide_db when it closes the database, commit.
+   All return false on failure. */
+NV_BOOL begin_tide_db_update ();
+NV_BOOL commit_tide_db_update ();
+NV_BOOL abort_tide_db_update ();
+
 /* Creates a TCD file with the supplied constituents and no tide
    stations.  Returns false if creation failed.  The database is left
    in an open state. */
@@ -340,6 +454,17 @@ NV_BOOL create_tide_db (const NV_CHAR *file, NV_U_INT32 constituents,
     NV_FLOAT32 const * const equilibrium[],
     NV_FLOAT32 const * const node_factor[]);
 
+/* As create_tide_db, but the file uses the large format
+   (LIBTCD_LARGE_MAJOR_REV):  64-bit record offsets, so it can pass
+   2 GB, and station and record size fields wide enough for millions of
+   stations.  Use it only when create_tide_db's limits are in the way;
+   older libraries can't read the result. */
+NV_BOOL create_large_tide_db (const NV_CHAR *file, NV_U_INT32 constituents,
+    NV_CHAR const * const constituent[], const NV_FLOAT64 *speed,
+    NV_INT32 start_year, NV_U_INT32 num_years,
+    NV_FLOAT32 const * const equilibrium[],
+    NV_FLOAT32 const * const node_factor[]);
+
 /* Returns a copy of the database header for the open database. */
 DB_HEADER_PUBLIC get_tide_db_header ();
 
@@ -365,10 +490,43 @@ NV_INT32 get_nearest_partial_tide_record (NV_FLOAT64 lat, NV_FLOAT64 lon,
    out of range. */
 NV_INT32 read_tide_record (NV_INT32 num, TIDE_RECORD *rec);
 
+/* As read_tide_record, but the packed record is read into the
+   caller's scratch buffer and only the parts selected by fields
+   (TIDE_FIELDS_*) are decoded.  A scratch_size of
+   get_max_record_size() is always enough.  Makes no heap
+   allocations.  Returns num, or -1 if num is out of range or scratch
+   is too small. */
+NV_INT32 read_tide_record_into (NV_INT32 num, TIDE_RECORD *rec,
+    NV_U_INT32 fields, NV_U_BYTE *scratch, NV_U_INT32 scratch_size);
+
+/* Returns the size in bytes of the largest packed record in the
+   database. */
+NV_U_INT32 get_max_record_size ();
+
+/* Reads records nums[0..count-1] into recs[0..count-1], decoding the
+   parts selected by fields (TIDE_FIELDS_*).  The reads are done in
+   file order and neighbouring records share a read.  current_record
+   is not changed.  Returns count, or -1 if any num is out of range
+   (in which case nothing is read). */
+NV_INT32 read_tide_records (const NV_INT32 *nums, NV_U_INT32 count,
+    TIDE_RECORD *recs, NV_U_INT32 fields);
+
 /* Invokes read_tide_record for current_record+1.  Returns the record
    number or -1 for failure. */
 NV_INT32 read_next_tide_record (TIDE_RECORD *rec);
 
+/* Decodes the parts of the record selected by fields for every station
+   that passes filter (NULL for all) and passes each one to visitor,
+   using threads worker threads (0 for one per processor).  If ordered
+   is true the visitor calls are serialized and in record order;
+   otherwise they are made concurrently as records are decoded.  The
+   record passed to visitor is valid only during the call.  Does not
+   use or change current_record.  Returns the number of records
+   visited, or -1 if no database is open. */
+NV_INT32 iterate_tide_records (const TIDE_RECORD_FILTER *filter,
+    NV_U_INT32 fields, NV_U_INT32 threads, NV_BOOL ordered,
+    TIDE_RECORD_VISITOR visitor, void *user_data);
+
 /* Add a new record, update an existing record, or delete an existing
    record.  If the deleted record is a reference station, all
    dependent subordinate stations will also be deleted.  Add and
@@ -385,6 +543,32 @@ NV_BOOL update_tide_record (NV_INT32 num, TIDE_RECORD *rec, DB_HEADER_PUBLIC *db
 #endif
 NV_BOOL delete_tide_record (NV_INT32 num, DB_HEADER_PUBLIC *db);
 
+/* Rewrites the records of the open database so that record i is the
+   one that was numbered order[i], relinking subordinate stations to
+   match.  order must be a permutation of [0,number_of_records-1].
+   Returns false on failure, in which case the file is unchanged. */
+NV_BOOL reorder_tide_db (const NV_INT32 *order);
+
+/* Space-filling curves for sort_tide_db_by_location. */
+#define TIDE_ORDER_HILBERT        1
+#define TIDE_ORDER_ZORDER         2
+
+/* Reorders the records of the open database along a Hilbert or Z-order
+   curve over longitude and latitude, using reorder_tide_db, so that
+   nearby stations are stored close together in the file.  Returns
+   false on failure. */
+NV_BOOL sort_tide_db_by_location (NV_U_INT32 curve);
+
+/* Replaces the equilibrium arguments and node factors of the open
+   database with tables for num_years years starting at start_year,
+   laid out as for create_tide_db, and moves the records to follow the
+   new tables.  Nothing else changes.  Returns false if num_years is
+   zero or a node factor is not positive, in which case the file is
+   unchanged. */
+NV_BOOL set_tide_db_years (NV_INT32 start_year, NV_U_INT32 num_years,
+    NV_FLOAT32 const * const equilibrium[],
+    NV_FLOAT32 const * const node_factor[]);
+
 /* Computes inferred constituents when M2, S2, K1, and O1 are given
    and fills in the remaining unfilled constituents.  The inferred
    constituents are developed or decided based on Article 230 of
@@ -393,6 +577,18 @@ NV_BOOL delete_tide_record (NV_INT32 num, DB_HEADER_PUBLIC *db);
    false if M2, S2, K1, or O1 is missing. */
 NV_BOOL infer_constituents (TIDE_RECORD *rec);
 
+/* Performance statistics.  Nothing is counted until
+   enable_tide_db_stats(NVTrue) is called, or LIBTCD_STATS is set to a
+   value other than 0 in the environment when the first database is
+   opened; in the latter case close_tide_db also calls
+   dump_tide_db_stats.  get_tide_db_stats copies the current totals
+   into snapshot and returns whether counting is on.
+   dump_tide_db_stats prints them to stderr. */
+void enable_tide_db_stats (NV_BOOL enable);
+NV_BOOL get_tide_db_stats (TIDE_DB_STATS *snapshot);
+void reset_tide_db_stats ();
+void dump_tide_db_stats ();
+
 
 #ifdef COMPAT114
 /* Deprecated stuff. */
@@ -1,5 +1,15 @@
 /* $Id: tide_db.c 5422 2014-02-23 21:11:04Z flaterco $ */
 
+/* Large-format TCD files can exceed 2 GB, so ask for a 64-bit off_t on
+   platforms where it is not the default.  Must come before any system
+   header. */
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+#ifndef _LARGEFILE_SOURCE
+#define _LARGEFILE_SOURCE
+#endif
+
 #include "tcd.h"
 #include "tide_db_header.h"
 #include "tide_db_default.h"
@@ -39,6 +49,18 @@
 #include <io.h>
 #endif
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
 
 /*****************************************************************************\
 
@@ -347,6 +369,8 @@ void bit_pack (NV_U_BYTE *, NV_U_INT32, NV_U_INT32, NV_INT32);
 NV_U_INT32 bit_unpack (NV_U_BYTE *, NV_U_INT32, NV_U_INT32);
 NV_INT32 signed_bit_unpack (NV_U_BYTE buffer[], NV_U_INT32 start,
                             NV_U_INT32 numbits);
+static void close_db (NV_BOOL keep_arena);
+static NV_BOOL open_stage ();
 
 
 
@@ -354,7 +378,7 @@ NV_INT32 signed_bit_unpack (NV_U_BYTE buffer[], NV_U_INT32 start,
 
 typedef struct
 {
-    NV_INT32                address;
+    NV_INT64                address;
     NV_U_INT32              record_size;
     NV_U_INT16              tzfile;
     NV_INT32                reference_station;
@@ -371,6 +395,211 @@ static NV_BOOL              modified = NVFalse;
 static NV_INT32             current_record, current_index;
 static NV_U_INT32           current_search_index;
 static NV_CHAR              filename[MONOLOGUE_LENGTH];
+#ifdef HAVE_SYS_STAT_H
+static struct stat          file_stat;      /* as of open, for tide_db_changed */
+#endif
+
+/*  While staging, fp is the copy named stage_name that
+    commit_tide_db_update renames over filename.  */
+static NV_BOOL              staging = NVFalse;
+static NV_CHAR              stage_name[MONOLOGUE_LENGTH + 4];
+
+/*  Read-path state that is fixed for the life of an open database, so
+    that a steady-state read_tide_record makes no heap allocations:
+    the "degrees true" direction units index (looked up once at open
+    rather than on every record), the largest record in the file, and
+    a packed-record buffer that only ever grows.  */
+static NV_U_BYTE            degrees_true = 0;
+static NV_U_INT32           max_record_size = 0;
+static NV_U_BYTE            *read_buf = NULL;
+static NV_U_INT32           read_buf_size = 0;
+
+/*  The equilibrium argument and node factor tables are decoded on
+    demand.  A whole row (one constituent, every year) is decoded into
+    hd.equilibrium[i] or hd.node_factor[i] when get_equilibriums or
+    get_node_factors asks for it or when the table is modified, and
+    stays until close.  Single values come from a small direct-mapped
+    cache of decoded year blocks.  table_address is where the packed
+    table starts in the file, or 0 if it has never been written.  A
+    table is only re-encoded by write_tide_db_header if it is dirty.  */
+#define EQUILIBRIUM_TABLE       0
+#define NODE_FACTOR_TABLE       1
+#define TABLE_BLOCK_YEARS       32
+#define TABLE_CACHE_BLOCKS      64
+
+typedef struct
+{
+    NV_INT32                num;            /* constituent, -1 if empty */
+    NV_U_INT32              block;
+    NV_U_BYTE               table;
+    NV_FLOAT32              value[TABLE_BLOCK_YEARS];
+} TABLE_BLOCK;
+
+static NV_INT64             table_address[2];
+static NV_BOOL              table_dirty[2];
+static TABLE_BLOCK          table_cache[TABLE_CACHE_BLOCKS];
+static NV_U_BYTE            *table_buf = NULL;
+static NV_U_INT32           table_buf_size = 0;
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t      table_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+/*****************************************************************************\
+  Performance statistics
+  2026-10-19
+
+  Off unless enable_tide_db_stats is called or LIBTCD_STATS is set in
+  the environment when a database is first opened.  When off, each
+  instrumented site costs one test of stats_enabled.  LIBTCD_STATS also
+  makes close_tide_db print the statistics to stderr.
+
+  Counters that can be bumped from iterate_tide_records workers are
+  only touched under its io_lock or after the workers have been
+  joined.  The latency histograms are kept for the public entry points
+  listed in tcd.h, which are not themselves thread-safe.
+\*****************************************************************************/
+
+static TIDE_DB_STATS        stats;
+static NV_BOOL              stats_enabled = NVFalse;
+static NV_BOOL              stats_dump = NVFalse;
+static NV_BOOL              stats_env_checked = NVFalse;
+
+#define STATS_START(t) ((t) = stats_enabled ? stats_clock () : 0)
+#define STATS_END(point, t) \
+  do { if (stats_enabled) stats_latency (point, t); } while (0)
+#define STATS_ADD(field, n) \
+  do { if (stats_enabled) stats.field += (n); } while (0)
+
+
+/*  Monotonic time in nanoseconds.  Without clock_gettime this falls
+    back on processor time, which is still useful for comparisons.  */
+
+static NV_U_INT64 stats_clock ()
+{
+#if defined (HAVE_CLOCK_GETTIME) && defined (CLOCK_MONOTONIC)
+    struct timespec         ts;
+
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+        return (NV_U_INT64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+    return (NV_U_INT64) ((NV_FLOAT64) clock () * 1.0e9 / CLOCKS_PER_SEC);
+}
+
+
+static void stats_latency (NV_U_INT32 point, NV_U_INT64 start)
+{
+    TIDE_DB_LATENCY         *lat;
+    NV_U_INT64              ns, v;
+    NV_U_INT32              bucket;
+
+    /*  Stats were switched on part way through the call.  */
+
+    if (!start) return;
+
+    assert (point < TIDE_STATS_ENTRY_POINTS);
+    ns = stats_clock () - start;
+    lat = &stats.latency[point];
+    ++lat->calls;
+    lat->total_ns += ns;
+    if (ns > lat->max_ns) lat->max_ns = ns;
+
+    for (bucket = 0, v = ns ; v > 1 && bucket < TIDE_STATS_BUCKETS - 1 ;
+        v >>= 1) ++bucket;
+    ++lat->histogram[bucket];
+}
+
+
+/*****************************************************************************\
+  String arena
+  2026-10-19
+
+  Every string owned by the open database -- the header lookup tables
+  and the station names in tindex -- is carved out of a chain of large
+  blocks instead of being allocated one at a time.  With 12k stations
+  that saves tens of thousands of calloc/free pairs on every open and
+  close.  close_tide_db releases the whole chain; reopen_tide_db (and
+  open_tide_db when it replaces an open database) keeps the memory,
+  consolidated into a single block, so reading the next header does no
+  string allocations at all.
+
+  Strings are never freed individually.  A station renamed by
+  update_tide_record leaves its old name behind until the next close.
+\*****************************************************************************/
+
+typedef struct STRING_BLOCK
+{
+    struct STRING_BLOCK     *next;
+    size_t                  size;
+    size_t                  used;
+} STRING_BLOCK;
+
+#define STRING_BLOCK_SIZE 65536
+
+static STRING_BLOCK         *arena = NULL;
+
+static NV_CHAR *arena_strdup (const NV_CHAR *string)
+{
+    STRING_BLOCK            *block;
+    NV_CHAR                 *copy;
+    size_t                  len, size;
+
+    assert (string);
+    len = strlen (string) + 1;
+
+    if (!arena || arena->size - arena->used < len)
+    {
+        size = len > STRING_BLOCK_SIZE ? len : STRING_BLOCK_SIZE;
+        if ((block = (STRING_BLOCK *) malloc (sizeof (STRING_BLOCK) + size))
+            == NULL)
+        {
+            perror ("Allocating string arena");
+            exit (-1);
+        }
+        block->next = arena;
+        block->size = size;
+        block->used = 0;
+        arena = block;
+    }
+
+    copy = (NV_CHAR *) (arena + 1) + arena->used;
+    memcpy (copy, string, len);
+    arena->used += len;
+    return copy;
+}
+
+static void arena_release (NV_BOOL keep)
+{
+    STRING_BLOCK            *block, *next;
+    size_t                  total = 0;
+
+    if (keep && arena && !arena->next)
+    {
+        arena->used = 0;
+        return;
+    }
+
+    for (block = arena ; block ; block = next)
+    {
+        next = block->next;
+        total += block->size;
+        free (block);
+    }
+    arena = NULL;
+
+    if (keep && total)
+    {
+        if ((arena = (STRING_BLOCK *) malloc (sizeof (STRING_BLOCK) + total))
+            == NULL)
+        {
+            perror ("Allocating string arena");
+            exit (-1);
+        }
+        arena->next = NULL;
+        arena->size = total;
+        arena->used = 0;
+    }
+}
 
 
 /*****************************************************************************\
@@ -384,6 +613,7 @@ static NV_CHAR              filename[MONOLOGUE_LENGTH];
 static void chk_fread (void *ptr, size_t size, size_t nmemb, FILE *stream) {
   size_t ret;
   ret = fread (ptr, size, nmemb, stream);
+  STATS_ADD (bytes_read, (NV_U_INT64) size * ret);
   if (ret != nmemb) {
     fprintf (stderr, "libtcd unexpected error: fread failed\n");
     fprintf (stderr, "nmemb = %u, got %u\n", nmemb, ret);
@@ -404,6 +634,36 @@ static void chk_fwrite (const void *ptr, size_t size, size_t nmemb,
 }
 
 
+/*****************************************************************************\
+  64-bit seek and tell on the database file
+  2026-10-19
+
+  Record addresses and end_of_file are 64-bit so that large-format files
+  can pass 2 GB.  The offsets in the ASCII header and the lookup tables
+  that follow it are always small and still use plain fseek/ftell.
+\*****************************************************************************/
+
+static int seek_db (NV_INT64 offset, int whence) {
+#if defined (HAVE_FSEEKO)
+  return fseeko (fp, (off_t) offset, whence);
+#elif defined (_MSC_VER)
+  return _fseeki64 (fp, offset, whence);
+#else
+  return fseek (fp, (long) offset, whence);
+#endif
+}
+
+static NV_INT64 tell_db () {
+#if defined (HAVE_FSEEKO)
+  return (NV_INT64) ftello (fp);
+#elif defined (_MSC_VER)
+  return (NV_INT64) _ftelli64 (fp);
+#else
+  return (NV_INT64) ftell (fp);
+#endif
+}
+
+
 /*****************************************************************************\
 
     Function        dump_tide_record - prints out all of the fields in the
@@ -806,6 +1066,142 @@ NV_FLOAT64 get_speed (NV_INT32 num)
 }
 
 
+/*****************************************************************************\
+  2026-10-19
+  Decodes count values of row num of table t (EQUILIBRIUM_TABLE or
+  NODE_FACTOR_TABLE), starting at year index first, from the file into
+  out.  The caller holds table_lock.  pread is used where available so
+  that the position of fp is left alone for whoever else is using it.
+\*****************************************************************************/
+static NV_U_INT32 bits2bytes (NV_U_INT32 nbits);
+
+static void decode_table (NV_U_INT32 t, NV_U_INT32 num, NV_U_INT32 first,
+NV_U_INT32 count, NV_FLOAT32 *out) {
+  NV_U_INT32 bits, scale, size, pos, k;
+  NV_INT32 offset;
+  NV_U_INT64 start;
+
+  assert (table_address[t]);
+  if (t == EQUILIBRIUM_TABLE) {
+    bits = hd.equilibrium_bits;
+    scale = hd.equilibrium_scale;
+    offset = hd.equilibrium_offset;
+  } else {
+    bits = hd.node_bits;
+    scale = hd.node_scale;
+    offset = hd.node_offset;
+  }
+
+  start = ((NV_U_INT64) num * hd.pub.number_of_years + first) * bits;
+  size = bits2bytes ((NV_U_INT32) (start % 8) + count * bits);
+  if (size > table_buf_size) {
+    free (table_buf);
+    if ((table_buf = (NV_U_BYTE *) malloc (size)) == NULL) {
+      perror ("Allocating table read buffer");
+      exit (-1);
+    }
+    table_buf_size = size;
+  }
+
+#if defined (HAVE_PREAD) && defined (HAVE_UNISTD_H)
+  if (pread (fileno (fp), table_buf, size,
+             (off_t) (table_address[t] + start / 8)) != (ssize_t) size) {
+    fprintf (stderr, "libtcd unexpected error: pread failed\n");
+    abort();
+  }
+  STATS_ADD (bytes_read, size);
+#else
+  require (seek_db (table_address[t] + start / 8, SEEK_SET) == 0);
+  chk_fread (table_buf, size, 1, fp);
+#endif
+
+  pos = start % 8;
+  for (k = 0 ; k < count ; ++k) {
+    out[k] = (NV_FLOAT32) ((NV_INT32) bit_unpack (table_buf, pos, bits) +
+      offset) / scale;
+    pos += bits;
+    assert (t == EQUILIBRIUM_TABLE || out[k] > 0.0);
+  }
+}
+
+
+/*****************************************************************************\
+  2026-10-19
+  Returns row num of table t, decoding it first if need be.
+\*****************************************************************************/
+static NV_FLOAT32 *table_row (NV_U_INT32 t, NV_U_INT32 num) {
+  NV_FLOAT32 **rows = (t == EQUILIBRIUM_TABLE ? hd.equilibrium :
+                       hd.node_factor);
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock (&table_lock);
+#endif
+  if (!rows[num]) {
+    if ((rows[num] = (NV_FLOAT32 *) calloc (hd.pub.number_of_years,
+         sizeof (NV_FLOAT32))) == NULL) {
+      perror ("Allocating table row");
+      exit (-1);
+    }
+    decode_table (t, num, 0, hd.pub.number_of_years, rows[num]);
+  }
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock (&table_lock);
+#endif
+  return rows[num];
+}
+
+
+/*****************************************************************************\
+  2026-10-19
+  Returns the value for constituent num and year index year from table t
+  without decoding the whole row.
+\*****************************************************************************/
+static NV_FLOAT32 table_value (NV_U_INT32 t, NV_U_INT32 num,
+NV_U_INT32 year) {
+  NV_FLOAT32 **rows = (t == EQUILIBRIUM_TABLE ? hd.equilibrium :
+                       hd.node_factor);
+  NV_U_INT32 block = year / TABLE_BLOCK_YEARS, first, count;
+  TABLE_BLOCK *b;
+  NV_FLOAT32 value;
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock (&table_lock);
+#endif
+  if (rows[num])
+    value = rows[num][year];
+  else {
+    b = &table_cache[((num << 1 | t) * 7 + block) % TABLE_CACHE_BLOCKS];
+    if (b->num != (NV_INT32) num || b->table != t || b->block != block) {
+      first = block * TABLE_BLOCK_YEARS;
+      count = hd.pub.number_of_years - first;
+      if (count > TABLE_BLOCK_YEARS) count = TABLE_BLOCK_YEARS;
+      decode_table (t, num, first, count, b->value);
+      b->num = num;
+      b->table = t;
+      b->block = block;
+    }
+    value = b->value[year % TABLE_BLOCK_YEARS];
+  }
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock (&table_lock);
+#endif
+  return value;
+}
+
+
+/*****************************************************************************\
+  2026-10-19
+  Forgets every decoded year block.  Called when a database is opened
+  or closed.
+\*****************************************************************************/
+static void clear_table_cache () {
+  NV_U_INT32 i;
+
+  for (i = 0 ; i < TABLE_CACHE_BLOCKS ; ++i)
+    table_cache[i].num = -1;
+}
+
+
 /*****************************************************************************\
 
     Function        get_equilibrium - gets the equilibrium value for
@@ -832,7 +1228,7 @@ NV_FLOAT32 get_equilibrium (NV_INT32 num, NV_INT32 year)
     exit(-1);
   }
   assert (num >= 0 && num < (NV_INT32)hd.pub.constituents && year >= 0 && year < (NV_INT32)hd.pub.number_of_years);
-  return hd.equilibrium[num][year];
+  return table_value (EQUILIBRIUM_TABLE, num, year);
 }
 
 
@@ -845,7 +1241,7 @@ NV_FLOAT32 *get_equilibriums (NV_INT32 num) {
     exit(-1);
   }
   assert (num >= 0 && num < (NV_INT32)hd.pub.constituents);
-  return hd.equilibrium[num];
+  return table_row (EQUILIBRIUM_TABLE, num);
 }
 
 
@@ -875,7 +1271,7 @@ NV_FLOAT32 get_node_factor (NV_INT32 num, NV_INT32 year)
     exit(-1);
   }
   assert (num >= 0 && num < (NV_INT32)hd.pub.constituents && year >= 0 && year < (NV_INT32)hd.pub.number_of_years);
-  return hd.node_factor[num][year];
+  return table_value (NODE_FACTOR_TABLE, num, year);
 }
 
 
@@ -888,7 +1284,7 @@ NV_FLOAT32 *get_node_factors (NV_INT32 num) {
     exit(-1);
   }
   assert (num >= 0 && num < (NV_INT32)hd.pub.constituents);
-  return hd.node_factor[num];
+  return table_row (NODE_FACTOR_TABLE, num);
 }
 
 
@@ -992,7 +1388,10 @@ TIDE_STATION_HEADER *rec)
 {
     NV_FLOAT64           diff, min_diff, lt, ln;
     NV_U_INT32             i, shortest = 0;
+    NV_INT32               ret;
+    NV_U_INT64             start;
 
+    STATS_START (start);
     min_diff = 999999999.9;
     for (i = 0 ; i < hd.pub.number_of_records ; ++i)
     {
@@ -1008,8 +1407,9 @@ TIDE_STATION_HEADER *rec)
         }
     }
 
-    if (!get_partial_tide_record (shortest, rec)) return (-1);
-    return (shortest);
+    ret = get_partial_tide_record (shortest, rec) ? (NV_INT32) shortest : -1;
+    STATS_END (TIDE_STATS_GET_NEAREST, start);
+    return (ret);
 }
 
 
@@ -1273,12 +1673,15 @@ NV_INT32 search_station (const NV_CHAR *string)
     static NV_CHAR        last_search[ONELINER_LENGTH];
     NV_U_INT32            i;
     NV_CHAR               name[ONELINER_LENGTH], search[ONELINER_LENGTH];
+    NV_INT32              found = -1;
+    NV_U_INT64            start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
     return -1;
   }
 
+    STATS_START (start);
     boundscheck_oneliner (string);
 
     for (i = 0 ; i < strlen(string) + 1 ; ++i)
@@ -1295,11 +1698,15 @@ NV_INT32 search_station (const NV_CHAR *string)
 
         ++current_search_index;
         if (strstr (name, search))
-          return (current_search_index - 1);
+        {
+          found = current_search_index - 1;
+          break;
+        }
     }
 
-    current_search_index = 0;
-    return -1;
+    if (found < 0) current_search_index = 0;
+    STATS_END (TIDE_STATS_SEARCH_STATION, start);
+    return found;
 }
 
 
@@ -1324,19 +1731,27 @@ NV_INT32 search_station (const NV_CHAR *string)
 NV_INT32 find_station (const NV_CHAR *name)
 {
     NV_U_INT32              i;
+    NV_INT32                found = -1;
+    NV_U_INT64              start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
     return -1;
   }
 
+    STATS_START (start);
     assert (name);
     for (i = 0 ; i < hd.pub.number_of_records ; ++i)
     {
-        if (!strcmp (name, tindex[i].name)) return (i);
+        if (!strcmp (name, tindex[i].name))
+        {
+            found = i;
+            break;
+        }
     }
 
-    return (-1);
+    STATS_END (TIDE_STATS_FIND_STATION, start);
+    return (found);
 }
 
 
@@ -1363,12 +1778,14 @@ NV_INT32 find_tzfile (const NV_CHAR *name)
     NV_INT32   j;
     NV_U_INT32 i;
     NV_CHAR     *temp;
+    NV_U_INT64  start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
     return -1;
   }
 
+    STATS_START (start);
     temp = clip_string(name);
 
     j = -1;
@@ -1381,6 +1798,7 @@ NV_INT32 find_tzfile (const NV_CHAR *name)
         }
     }
 
+    STATS_END (TIDE_STATS_FIND_TABLE, start);
     return (j);
 }
 
@@ -1408,12 +1826,14 @@ NV_INT32 find_country (const NV_CHAR *name)
     NV_INT32    j;
     NV_U_INT32  i;
     NV_CHAR     *temp;
+    NV_U_INT64  start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
     return -1;
   }
 
+    STATS_START (start);
     temp = clip_string(name);
 
     j = -1;
@@ -1426,6 +1846,7 @@ NV_INT32 find_country (const NV_CHAR *name)
         }
     }
 
+    STATS_END (TIDE_STATS_FIND_TABLE, start);
     return (j);
 }
 
@@ -1453,12 +1874,14 @@ NV_INT32 find_level_units (const NV_CHAR *name)
     NV_INT32    j;
     NV_U_INT32  i;
     NV_CHAR     *temp;
+    NV_U_INT64  start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
     return -1;
   }
 
+    STATS_START (start);
     temp = clip_string(name);
 
     j = -1;
@@ -1471,6 +1894,7 @@ NV_INT32 find_level_units (const NV_CHAR *name)
         }
     }
 
+    STATS_END (TIDE_STATS_FIND_TABLE, start);
     return (j);
 }
 
@@ -1498,12 +1922,14 @@ NV_INT32 find_dir_units (const NV_CHAR *name)
     NV_INT32    j;
     NV_U_INT32  i;
     NV_CHAR     *temp;
+    NV_U_INT64  start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
     return -1;
   }
 
+    STATS_START (start);
     temp = clip_string(name);
 
     j = -1;
@@ -1516,6 +1942,7 @@ NV_INT32 find_dir_units (const NV_CHAR *name)
         }
     }
 
+    STATS_END (TIDE_STATS_FIND_TABLE, start);
     return (j);
 }
 
@@ -1568,12 +1995,14 @@ NV_INT32 find_datum (const NV_CHAR *name)
     NV_INT32    j;
     NV_U_INT32  i;
     NV_CHAR     *temp;
+    NV_U_INT64  start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
     return -1;
   }
 
+    STATS_START (start);
     temp = clip_string(name);
 
     j = -1;
@@ -1586,6 +2015,7 @@ NV_INT32 find_datum (const NV_CHAR *name)
         }
     }
 
+    STATS_END (TIDE_STATS_FIND_TABLE, start);
     return (j);
 }
 
@@ -1598,12 +2028,14 @@ NV_INT32 find_legalese (const NV_CHAR *name)
   NV_INT32    j;
   NV_U_INT32  i;
   NV_CHAR     *temp;
+  NV_U_INT64  start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
     return -1;
   }
 
+  STATS_START (start);
   temp = clip_string(name);
 
   j = -1;
@@ -1616,6 +2048,7 @@ NV_INT32 find_legalese (const NV_CHAR *name)
     }
   }
 
+  STATS_END (TIDE_STATS_FIND_TABLE, start);
   return (j);
 }
 
@@ -1642,21 +2075,29 @@ NV_INT32 find_legalese (const NV_CHAR *name)
 NV_INT32 find_constituent (const NV_CHAR *name)
 {
     NV_U_INT32               i;
+    NV_INT32                 j = -1;
     NV_CHAR     *temp;
+    NV_U_INT64  start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
     return -1;
   }
 
+    STATS_START (start);
     temp = clip_string(name);
 
     for (i = 0 ; i < hd.pub.constituents ; ++i)
     {
-      if (!strcmp (get_constituent (i), temp)) return (i);
+      if (!strcmp (get_constituent (i), temp))
+      {
+        j = i;
+        break;
+      }
     }
 
-    return (-1);
+    STATS_END (TIDE_STATS_FIND_TABLE, start);
+    return (j);
 }
 
 
@@ -1683,12 +2124,14 @@ NV_INT32 find_restriction (const NV_CHAR *name)
     NV_INT32    j;
     NV_U_INT32  i;
     NV_CHAR     *temp;
+    NV_U_INT64  start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
     return -1;
   }
 
+    STATS_START (start);
     temp = clip_string(name);
 
     j = -1;
@@ -1700,6 +2143,7 @@ NV_INT32 find_restriction (const NV_CHAR *name)
             break;
         }
     }
+    STATS_END (TIDE_STATS_FIND_TABLE, start);
     return (j);
 }
 
@@ -1767,7 +2211,8 @@ void set_equilibrium (NV_INT32 num, NV_INT32 year, NV_FLOAT32 value)
   }
   write_protect();
   assert (num >= 0 && num < (NV_INT32)hd.pub.constituents && year >= 0 && year < (NV_INT32)hd.pub.number_of_years);
-  hd.equilibrium[num][year] = value;
+  table_row (EQUILIBRIUM_TABLE, num)[year] = value;
+  table_dirty[EQUILIBRIUM_TABLE] = NVTrue;
   modified = NVTrue;
 }
 
@@ -1804,7 +2249,8 @@ void set_node_factor (NV_INT32 num, NV_INT32 year, NV_FLOAT32 value)
     fprintf (stderr, "libtcd set_node_factor: somebody tried to set a negative or zero node factor (%f)\n", value);
     exit (-1);
   }
-  hd.node_factor[num][year] = value;
+  table_row (NODE_FACTOR_TABLE, num)[year] = value;
+  table_dirty[NODE_FACTOR_TABLE] = NVTrue;
   modified = NVTrue;
 }
 
@@ -1883,16 +2329,7 @@ NV_INT32 add_tzfile (const NV_CHAR *name, DB_HEADER_PUBLIC *db)
 
     c_name = clip_string (name);
 
-    hd.tzfile[hd.pub.tzfiles] = (NV_CHAR *) calloc (strlen (c_name) + 1,
-        sizeof (NV_CHAR));
-
-    if (hd.tzfile[hd.pub.tzfiles] == NULL)
-    {
-        perror ("Allocating new tzfile string");
-        exit (-1);
-    }
-
-    strcpy (hd.tzfile[hd.pub.tzfiles++], c_name);
+    hd.tzfile[hd.pub.tzfiles++] = arena_strdup (c_name);
     if (db)
       *db = hd.pub;
     modified = NVTrue;
@@ -1949,16 +2386,7 @@ NV_INT32 add_country (const NV_CHAR *name, DB_HEADER_PUBLIC *db)
 
     c_name = clip_string (name);
 
-    hd.country[hd.pub.countries] = (NV_CHAR *) calloc (strlen (c_name) + 1,
-        sizeof (NV_CHAR));
-
-    if (hd.country[hd.pub.countries] == NULL)
-    {
-        perror ("Allocating new country string");
-        exit (-1);
-    }
-
-    strcpy (hd.country[hd.pub.countries++], c_name);
+    hd.country[hd.pub.countries++] = arena_strdup (c_name);
     if (db)
       *db = hd.pub;
     modified = NVTrue;
@@ -2015,16 +2443,7 @@ NV_INT32 add_datum (const NV_CHAR *name, DB_HEADER_PUBLIC *db)
 
     c_name = clip_string (name);
 
-    hd.datum[hd.pub.datum_types] = (NV_CHAR *) calloc (strlen (c_name) + 1,
-        sizeof (NV_CHAR));
-
-    if (hd.datum[hd.pub.datum_types] == NULL)
-    {
-        perror ("Allocating new datum string");
-        exit (-1);
-    }
-
-    strcpy (hd.datum[hd.pub.datum_types++], c_name);
+    hd.datum[hd.pub.datum_types++] = arena_strdup (c_name);
     if (db)
       *db = hd.pub;
     modified = NVTrue;
@@ -2066,16 +2485,7 @@ NV_INT32 add_legalese (const NV_CHAR *name, DB_HEADER_PUBLIC *db)
 
     c_name = clip_string (name);
 
-    hd.legalese[hd.pub.legaleses] = (NV_CHAR *) calloc (strlen (c_name) + 1,
-        sizeof (NV_CHAR));
-
-    if (hd.legalese[hd.pub.legaleses] == NULL)
-    {
-        perror ("Allocating new legalese string");
-        exit (-1);
-    }
-
-    strcpy (hd.legalese[hd.pub.legaleses++], c_name);
+    hd.legalese[hd.pub.legaleses++] = arena_strdup (c_name);
     if (db)
       *db = hd.pub;
     modified = NVTrue;
@@ -2132,16 +2542,7 @@ NV_INT32 add_restriction (const NV_CHAR *name, DB_HEADER_PUBLIC *db)
 
     c_name = clip_string (name);
 
-    hd.restriction[hd.pub.restriction_types] =
-        (NV_CHAR *) calloc (strlen (c_name) + 1, sizeof (NV_CHAR));
-
-    if (hd.restriction[hd.pub.restriction_types] == NULL)
-    {
-        perror ("Allocating new restriction string");
-        exit (-1);
-    }
-
-    strcpy (hd.restriction[hd.pub.restriction_types++], c_name);
+    hd.restriction[hd.pub.restriction_types++] = arena_strdup (c_name);
     if (db)
       *db = hd.pub;
     modified = NVTrue;
@@ -2431,6 +2832,68 @@ static NV_U_INT32 bits2bytes (NV_U_INT32 nbits) {
 }
 
 
+/*****************************************************************************\
+  2026-10-19
+  Writes table t (EQUILIBRIUM_TABLE or NODE_FACTOR_TABLE) at the current
+  position of fp.  A table that hasn't been modified since it was read
+  is already there and is just skipped, which also spares decoding the
+  rows nobody asked for.
+\*****************************************************************************/
+static void write_table (NV_U_INT32 t) {
+  NV_FLOAT32 **rows;
+  NV_U_INT32 i, j, size, pos, bits, scale;
+  NV_INT32 offset, temp_int;
+  NV_INT64 here;
+  NV_U_BYTE *buf;
+
+  if (t == EQUILIBRIUM_TABLE) {
+    rows = hd.equilibrium;
+    bits = hd.equilibrium_bits;
+    scale = hd.equilibrium_scale;
+    offset = hd.equilibrium_offset;
+  } else {
+    rows = hd.node_factor;
+    bits = hd.node_bits;
+    scale = hd.node_scale;
+    offset = hd.node_offset;
+  }
+  size = bits2bytes (hd.pub.constituents * hd.pub.number_of_years * bits);
+
+  if (!table_dirty[t]) {
+    assert (table_address[t] == tell_db ());
+    require (seek_db (size, SEEK_CUR) == 0);
+    return;
+  }
+
+  /* Rows that were never loaded are still only on disk.  Without pread
+     loading them moves fp, so come back afterwards. */
+  here = tell_db ();
+  for (i = 0 ; i < hd.pub.constituents ; ++i)
+    if (!rows[i]) table_row (t, i);
+  require (seek_db (here, SEEK_SET) == 0);
+
+  if ((buf = (NV_U_BYTE *) calloc (size, sizeof (NV_U_BYTE))) == NULL) {
+    perror ("Allocating table write buffer");
+    exit (-1);
+  }
+
+  pos = 0;
+  for (i = 0 ; i < hd.pub.constituents ; ++i) {
+    for (j = 0 ; j < hd.pub.number_of_years ; ++j) {
+      temp_int = NINT (rows[i][j] * scale) - offset;
+      assert (temp_int >= 0);
+      bit_pack (buf, pos, bits, temp_int);
+      pos += bits;
+    }
+  }
+
+  table_address[t] = here;
+  chk_fwrite (buf, size, 1, fp);
+  free (buf);
+  table_dirty[t] = NVFalse;
+}
+
+
 /*****************************************************************************\
 
     Function        write_tide_db_header - writes the database header to the
@@ -2463,7 +2926,7 @@ static void write_tide_db_header ()
     fseek (fp, 0, SEEK_SET);
 
     fprintf (fp, "[VERSION] = %s\n", LIBTCD_VERSION);
-    fprintf (fp, "[MAJOR REV] = %u\n", LIBTCD_MAJOR_REV);
+    fprintf (fp, "[MAJOR REV] = %u\n", hd.pub.major_rev);
     fprintf (fp, "[MINOR REV] = %u\n", LIBTCD_MINOR_REV);
 
     fprintf (fp, "[LAST MODIFIED] = %s\n", curtime());
@@ -2543,7 +3006,8 @@ static void write_tide_db_header ()
     fprintf (fp, "[COUNTRIES] = %u\n", hd.pub.countries);
     fprintf (fp, "[COUNTRY SIZE] = %u\n", hd.country_size);
 
-    fprintf (fp, "[END OF FILE] = %u\n", hd.end_of_file);
+    fprintf (fp, "[END OF FILE] = %llu\n",
+      (unsigned long long) hd.end_of_file);
     fprintf (fp, "[END OF ASCII HEADER DATA]\n");
 
 
@@ -2783,64 +3247,10 @@ static void write_tide_db_header ()
     free (buf);
 
 
-    /*  Write equilibrium arguments.  */
-
-    pos = 0;
-    size = bits2bytes (hd.pub.constituents *  hd.pub.number_of_years *
-		       hd.equilibrium_bits);
-
-    if ((buf = (NV_U_BYTE *) calloc (size, sizeof (NV_U_BYTE))) == NULL)
-    {
-        perror ("Allocating equilibrium write buffer");
-        exit (-1);
-    }
-    memset (buf, 0, size);
-
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        NV_U_INT32 j;
-        for (j = 0 ; j < hd.pub.number_of_years ; ++j)
-        {
-            temp_int = NINT (hd.equilibrium[i][j] * hd.equilibrium_scale) -
-                hd.equilibrium_offset;
-            assert (temp_int >= 0);
-            bit_pack (buf, pos, hd.equilibrium_bits, temp_int);
-            pos += hd.equilibrium_bits;
-        }
-    }
-
-    chk_fwrite (buf, size, 1, fp);
-    free (buf);
-
-
-    /*  Write node factors.  */
-
-    pos = 0;
-    size = bits2bytes (hd.pub.constituents * hd.pub.number_of_years *
-		       hd.node_bits);
-
-    if ((buf = (NV_U_BYTE *) calloc (size, sizeof (NV_U_BYTE))) == NULL)
-    {
-        perror ("Allocating node write buffer");
-        exit (-1);
-    }
-    memset (buf, 0, size);
-
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        NV_U_INT32 j;
-        for (j = 0 ; j < hd.pub.number_of_years ; ++j)
-        {
-            temp_int = NINT (hd.node_factor[i][j] * hd.node_scale) -
-                hd.node_offset;
-            assert (temp_int >= 0);
-            bit_pack (buf, pos, hd.node_bits, temp_int);
-            pos += hd.node_bits;
-        }
-    }
+    /*  Write equilibrium arguments and node factors.  */
 
-    chk_fwrite (buf, size, 1, fp);
-    free (buf);
+    write_table (EQUILIBRIUM_TABLE);
+    write_table (NODE_FACTOR_TABLE);
 }
 
 
@@ -2867,7 +3277,9 @@ static void write_tide_db_header ()
     Date            2004-09-30
 
     pos will be left at the start of the next field even if the string
-    gets truncated.
+    gets truncated.  If outbuf is NULL the string is skipped without
+    being copied (used by iterate_tide_records when text fields are
+    masked out).
 
 \*****************************************************************************/
 
@@ -2877,11 +3289,18 @@ NV_CHAR *outbuf, NV_U_INT32 outbuflen, NV_CHAR *desc) {
   NV_CHAR c = 'x';
   assert (buf);
   assert (pos);
-  assert (outbuf);
   assert (desc);
   assert (outbuflen);
   --outbuflen;
   bufsize <<= 3;
+  if (!outbuf) {
+    while (c) {
+      assert (*pos < bufsize); /* Catch unterminated strings */
+      c = bit_unpack (buf, *pos, 8);
+      (*pos) += 8;
+    }
+    return;
+  }
   for (i = 0 ; c ; ++i) {
     assert (*pos < bufsize); /* Catch unterminated strings */
     c = bit_unpack (buf, *pos, 8);
@@ -2984,8 +3403,11 @@ TIDE_RECORD *rec, NV_U_INT32 *pos)
 
 static NV_INT32 read_partial_tide_record (NV_INT32 num, TIDE_RECORD *rec)
 {
-    NV_U_BYTE               *buf;
+    /*  Five fields of at most 32 bits, the name, and the reference
+        station fit easily.  */
+    NV_U_BYTE               buf[ONELINER_LENGTH + 32];
     NV_U_INT32              maximum_possible_size, pos;
+    size_t                  got;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
@@ -3001,23 +3423,20 @@ static NV_INT32 read_partial_tide_record (NV_INT32 num, TIDE_RECORD *rec)
         hd.latitude_bits + hd.longitude_bits + hd.tzfile_bits +
         (ONELINER_LENGTH * 8) + hd.station_bits;
     maximum_possible_size = bits2bytes (maximum_possible_size);
-
-    if ((buf = (NV_U_BYTE *) calloc (maximum_possible_size, sizeof (NV_U_BYTE))) == NULL)
-    {
-        perror ("Allocating partial tide record buffer");
-        exit (-1);
-    }
+    assert (maximum_possible_size <= sizeof (buf));
+    memset (buf, 0, maximum_possible_size);
 
     current_record = num;
-    fseek (fp, tindex[num].address, SEEK_SET);
+    seek_db (tindex[num].address, SEEK_SET);
+    STATS_ADD (seeks, 1);
     /* DWF 2007-12-02:  This is the one place where a short read would not
        necessarily mean catastrophe.  We don't know how long the partial
        record actually is yet, and it's possible that the full record will
        be shorter than maximum_possible_size.  So the return of fread is
-       deliberately unchecked. */
-    (void) fread (buf, maximum_possible_size, 1, fp);
+       deliberately unchecked, other than for the byte count. */
+    got = fread (buf, 1, maximum_possible_size, fp);
+    STATS_ADD (bytes_read, got);
     unpack_partial_tide_record (buf, maximum_possible_size, rec, &pos);
-    free (buf);
     return (num);
 }
 
@@ -3041,9 +3460,10 @@ static NV_BOOL read_tide_db_header ()
 {
     NV_INT32            temp_int;
     NV_CHAR             varin[ONELINER_LENGTH], *info;
-    NV_U_INT32          utemp, i, j, pos, size, key_count;
+    NV_U_INT32          utemp, i, pos, size, key_count;
     NV_U_BYTE           *buf, checksum_c[4];
     TIDE_RECORD         rec;
+    NV_U_INT64          index_start;
 
   if (!fp) {
     fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
@@ -3106,6 +3526,16 @@ static NV_BOOL read_tide_db_header ()
           fclose (fp);
           return NVFalse;
               }
+            } else if (!strcmp (keys[i].datatype, "ui64")) {
+              unsigned long long ull;
+              if (sscanf (info, "%llu", &ull) != 1) {
+          fprintf (stderr, "libtcd error:  invalid tide db header line:\n");
+          fprintf (stderr, "%s", varin);
+          fprintf (stderr, "in file %s\n", filename);
+          fclose (fp);
+          return NVFalse;
+              }
+              *keys[i].address.ui64 = ull;
             } else
               assert (0);
           }
@@ -3123,9 +3553,9 @@ static NV_BOOL read_tide_db_header ()
     }
 
     /* If no major or minor rev, they're 0 (pre-1.99) */
-    if (hd.pub.major_rev > LIBTCD_MAJOR_REV) {
+    if (hd.pub.major_rev > LIBTCD_LARGE_MAJOR_REV) {
       fprintf (stderr, "libtcd error:  major revision in TCD file (%u) exceeds major revision of\n", hd.pub.major_rev);
-      fprintf (stderr, "libtcd (%u).  You must upgrade libtcd to read this file.\n", LIBTCD_MAJOR_REV);
+      fprintf (stderr, "libtcd (%u).  You must upgrade libtcd to read this file.\n", LIBTCD_LARGE_MAJOR_REV);
       fclose (fp);
       return NVFalse;
     }
@@ -3212,9 +3642,7 @@ defined.\n");
     for (i = 0 ; i < hd.pub.level_unit_types ; ++i)
     {
         chk_fread (buf, hd.level_unit_size, 1, fp);
-        hd.level_unit[i] = (NV_CHAR *) calloc (strlen((char*)buf) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.level_unit[i], (NV_CHAR *) buf);
+        hd.level_unit[i] = arena_strdup ((NV_CHAR *) buf);
     }
     free (buf);
 
@@ -3235,12 +3663,17 @@ defined.\n");
     for (i = 0 ; i < hd.pub.dir_unit_types ; ++i)
     {
         chk_fread (buf, hd.dir_unit_size, 1, fp);
-        hd.dir_unit[i] = (NV_CHAR *) calloc (strlen((char*)buf) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.dir_unit[i], (NV_CHAR *) buf);
+        hd.dir_unit[i] = arena_strdup ((NV_CHAR *) buf);
     }
     free (buf);
 
+    /*  Every record that doesn't say otherwise is in degrees true.  */
+    {
+      int r = find_dir_units ("degrees true");
+      assert (r > 0);
+      degrees_true = (NV_U_BYTE)r;
+    }
+
 
 
     /*  Read restrictions.  */
@@ -3265,9 +3698,7 @@ defined.\n");
             hd.pub.restriction_types = i;
             break;
         }
-        hd.restriction[i] = (NV_CHAR *) calloc (strlen((char*)buf) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.restriction[i], (NV_CHAR *) buf);
+        hd.restriction[i] = arena_strdup ((NV_CHAR *) buf);
     }
     free (buf);
     fseek (fp, utemp + hd.max_restriction_types * hd.restriction_size,
@@ -3303,8 +3734,7 @@ defined.\n");
             hd.pub.tzfiles = i;
             break;
         }
-        hd.tzfile[i] = (NV_CHAR *) calloc (strlen((char*)buf) + 1, sizeof (NV_CHAR));
-        strcpy (hd.tzfile[i], (NV_CHAR *) buf);
+        hd.tzfile[i] = arena_strdup ((NV_CHAR *) buf);
     }
     free (buf);
     fseek (fp, utemp + hd.max_tzfiles * hd.tzfile_size, SEEK_SET);
@@ -3331,9 +3761,7 @@ defined.\n");
             hd.pub.countries = i;
             break;
         }
-        hd.country[i] = (NV_CHAR *) calloc (strlen((char*)buf) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.country[i], (NV_CHAR *) buf);
+        hd.country[i] = arena_strdup ((NV_CHAR *) buf);
     }
     free (buf);
     fseek (fp, utemp + hd.max_countries * hd.country_size, SEEK_SET);
@@ -3360,8 +3788,7 @@ defined.\n");
             hd.pub.datum_types = i;
             break;
         }
-        hd.datum[i] = (NV_CHAR *) calloc (strlen((char*)buf) + 1, sizeof (NV_CHAR));
-        strcpy (hd.datum[i], (NV_CHAR *) buf);
+        hd.datum[i] = arena_strdup ((NV_CHAR *) buf);
     }
     free (buf);
     fseek (fp, utemp + hd.max_datum_types * hd.datum_size, SEEK_SET);
@@ -3373,9 +3800,7 @@ defined.\n");
     if (hd.pub.major_rev < 2) {
       hd.legalese = (NV_CHAR **) malloc (sizeof (NV_CHAR *));
       assert (hd.legalese != NULL);
-      hd.legalese[0] = (NV_CHAR *) malloc (5 * sizeof (NV_CHAR));
-      assert (hd.legalese[0] != NULL);
-      strcpy (hd.legalese[0], "NULL");
+      hd.legalese[0] = arena_strdup ("NULL");
       hd.pub.legaleses = 1;
     } else {
       utemp = ftell (fp);
@@ -3397,8 +3822,7 @@ defined.\n");
 	      hd.pub.legaleses = i;
 	      break;
 	  }
-	  hd.legalese[i] = (NV_CHAR *) calloc (strlen((char*)buf) + 1, sizeof (NV_CHAR));
-	  strcpy (hd.legalese[i], (NV_CHAR *) buf);
+	  hd.legalese[i] = arena_strdup ((NV_CHAR *) buf);
       }
       free (buf);
       fseek (fp, utemp + hd.max_legaleses * hd.legalese_size, SEEK_SET);
@@ -3421,9 +3845,7 @@ defined.\n");
     for (i = 0 ; i < hd.pub.constituents ; ++i)
     {
         chk_fread (buf, hd.constituent_size, 1, fp);
-        hd.constituent[i] = (NV_CHAR *) calloc (strlen((char*)buf) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.constituent[i], (NV_CHAR *) buf);
+        hd.constituent[i] = arena_strdup ((NV_CHAR *) buf);
     }
     free (buf);
 
@@ -3472,20 +3894,23 @@ database should be rebuilt from the original data if possible.\n");
 
 
 
-    /*  Read equilibrium arguments.  */
+    /*  Equilibrium arguments and node factors.  Only the row pointers
+        are set up here; the values are decoded when they are asked for
+        (see table_row and table_value).  */
 
     hd.equilibrium = (NV_FLOAT32 **) calloc (hd.pub.constituents,
         sizeof (NV_FLOAT32 *));
-
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
+    hd.node_factor = (NV_FLOAT32 **) calloc (hd.pub.constituents,
+        sizeof (NV_FLOAT32 *));
+    if (hd.equilibrium == NULL || hd.node_factor == NULL)
     {
-        hd.equilibrium[i] = (NV_FLOAT32 *) calloc (hd.pub.number_of_years,
-            sizeof (NV_FLOAT32));
+        perror ("Allocating table rows");
+        exit (-1);
     }
+    clear_table_cache ();
+    table_dirty[EQUILIBRIUM_TABLE] = table_dirty[NODE_FACTOR_TABLE] = NVFalse;
 
-
-
-    pos = 0;
+    table_address[EQUILIBRIUM_TABLE] = tell_db ();
     /* wasted byte bug in V1 */
     if (hd.pub.major_rev < 2)
       size = ((hd.pub.constituents * hd.pub.number_of_years *
@@ -3493,77 +3918,20 @@ database should be rebuilt from the original data if possible.\n");
     else
       size = bits2bytes (hd.pub.constituents * hd.pub.number_of_years *
         hd.equilibrium_bits);
+    require (seek_db (size, SEEK_CUR) == 0);
 
+    table_address[NODE_FACTOR_TABLE] = tell_db ();
+    if (hd.pub.major_rev < 2)
+      size = ((hd.pub.constituents * hd.pub.number_of_years *
+        hd.node_bits) / 8) + 1;
+    else
+      size = bits2bytes (hd.pub.constituents * hd.pub.number_of_years *
+        hd.node_bits);
+    require (seek_db (size, SEEK_CUR) == 0);
 
-    if ((buf = (NV_U_BYTE *) calloc (size, sizeof (NV_U_BYTE))) == NULL)
-    {
-        perror ("Allocating equilibrium read buffer");
-        exit (-1);
-    }
 
-    chk_fread (buf, size, 1, fp);
-
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        for (j = 0 ; j < hd.pub.number_of_years ; ++j)
-        {
-            temp_int = bit_unpack (buf, pos, hd.equilibrium_bits);
-            hd.equilibrium[i][j] = (NV_FLOAT32) (temp_int +
-                hd.equilibrium_offset) / hd.equilibrium_scale;
-            pos += hd.equilibrium_bits;
-        }
-    }
-    free (buf);
-
-
-
-    /*  Read node factors.  */
-
-    hd.node_factor = (NV_FLOAT32 **) calloc (hd.pub.constituents,
-        sizeof (NV_FLOAT32 *));
-
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        hd.node_factor[i] =
-            (NV_FLOAT32 *) calloc (hd.pub.number_of_years,
-            sizeof (NV_FLOAT32));
-    }
-
-
-    pos = 0;
-    /* wasted byte bug in V1 */
-    if (hd.pub.major_rev < 2)
-      size = ((hd.pub.constituents * hd.pub.number_of_years *
-        hd.node_bits) / 8) + 1;
-    else
-      size = bits2bytes (hd.pub.constituents * hd.pub.number_of_years *
-        hd.node_bits);
-
-
-    if ((buf = (NV_U_BYTE *) calloc (size, sizeof (NV_U_BYTE))) == NULL)
-    {
-        perror ("Allocating node read buffer");
-        exit (-1);
-    }
-
-    chk_fread (buf, size, 1, fp);
-
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        for (j = 0 ; j < hd.pub.number_of_years ; ++j)
-        {
-            temp_int = bit_unpack (buf, pos, hd.node_bits);
-            hd.node_factor[i][j] = (NV_FLOAT32) (temp_int +
-                hd.node_offset) / hd.node_scale;
-            pos += hd.node_bits;
-            assert (hd.node_factor[i][j] > 0.0);
-        }
-    }
-    free (buf);
-
-
-    /*  Read the header portion of all of the records in the file and save
-        the record size, address, and name.  */
+    /*  Read the header portion of all of the records in the file and save
+        the record size, address, and name.  */
 
     /* DWF added test for zero 2003-11-16 -- happens on create new db */
     if (hd.pub.number_of_records) {
@@ -3573,9 +3941,11 @@ database should be rebuilt from the original data if possible.\n");
           exit (-1);
       }
       /*  Set the first address to be immediately after the header  */
-      tindex[0].address = ftell (fp);
+      tindex[0].address = tell_db ();
     } else tindex = NULL; /* May as well be explicit... */
 
+    STATS_START (index_start);
+    max_record_size = 0;
     for (i = 0 ; i < hd.pub.number_of_records ; ++i)
     {
         /*  Set the address for the next record so that
@@ -3590,6 +3960,8 @@ database should be rebuilt from the original data if possible.\n");
         /*  Save the header info in the index.  */
 
         tindex[i].record_size = rec.header.record_size;
+        if (tindex[i].record_size > max_record_size)
+            max_record_size = tindex[i].record_size;
         tindex[i].record_type = rec.header.record_type;
         tindex[i].reference_station = rec.header.reference_station;
         assert (rec.header.tzfile >= 0);
@@ -3597,16 +3969,10 @@ database should be rebuilt from the original data if possible.\n");
         tindex[i].lat = NINT (rec.header.latitude * hd.latitude_scale);
         tindex[i].lon = NINT (rec.header.longitude * hd.longitude_scale);
 
-        if ((tindex[i].name =
-            (NV_CHAR *) calloc (strlen (rec.header.name) + 1,
-            sizeof (NV_CHAR))) == NULL)
-        {
-            perror ("Allocating index name memory");
-            exit (-1);
-        }
-
-        strcpy (tindex[i].name, rec.header.name);
+        tindex[i].name = arena_strdup (rec.header.name);
     }
+    if (stats_enabled && index_start)
+        stats.index_build_ns += stats_clock () - index_start;
 
 
     current_record = -1;
@@ -3617,6 +3983,62 @@ database should be rebuilt from the original data if possible.\n");
 }
 
 
+/*****************************************************************************\
+  2026-10-19
+  Records the identity of the file just opened for tide_db_changed.
+\*****************************************************************************/
+static void remember_file () {
+#ifdef HAVE_SYS_STAT_H
+  if (fstat (fileno (fp), &file_stat))
+    memset (&file_stat, 0, sizeof (file_stat));
+#endif
+}
+
+
+/*****************************************************************************\
+
+    Function        tide_db_changed - checks whether the file of the open
+                    database has been replaced or rewritten
+
+    Synopsis        tide_db_changed ();
+
+    Returns         NV_BOOL                 NVTrue if the file by that name
+                                            is not the one that was opened
+
+    Date            2026-10-19
+
+    The file is different if its device, inode, size, or modification
+    time differs from those recorded by open_tide_db, which covers both
+    a new file renamed into place and one overwritten in place.  Changes
+    made through libtcd itself don't count.  Without sys/stat.h nothing
+    can be checked and the file is always assumed to have changed.
+
+\*****************************************************************************/
+
+NV_BOOL tide_db_changed ()
+{
+#ifdef HAVE_SYS_STAT_H
+    struct stat     st;
+#endif
+
+    if (!fp) {
+      fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+      return NVFalse;
+    }
+    if (modified) return NVFalse;
+
+#ifdef HAVE_SYS_STAT_H
+    if (stat (filename, &st))
+        return NVFalse;     /* Missing for now; keep what we have. */
+    return (st.st_dev != file_stat.st_dev || st.st_ino != file_stat.st_ino ||
+            st.st_size != file_stat.st_size ||
+            st.st_mtime != file_stat.st_mtime);
+#else
+    return NVTrue;
+#endif
+}
+
+
 /*****************************************************************************\
 
     Function        open_tide_db - opens the tide database
@@ -3636,150 +4058,161 @@ database should be rebuilt from the original data if possible.\n");
 
 NV_BOOL open_tide_db (const NV_CHAR *file)
 {
+    NV_U_INT64      start;
+    NV_BOOL         ret;
+    const NV_CHAR   *env;
+
     assert (file);
+
+    if (!stats_env_checked) {
+        stats_env_checked = NVTrue;
+        env = getenv ("LIBTCD_STATS");
+        if (env && *env && strcmp (env, "0"))
+            stats_enabled = stats_dump = NVTrue;
+    }
+    STATS_START (start);
+
     current_record = -1;
     current_index = -1;
     current_search_index = 0;
     if (fp) {
-        if (!strcmp(file,filename) && !modified) return NVTrue;
-        else close_tide_db();
+        if (!strcmp(file,filename) && !modified && !tide_db_changed ())
+            return NVTrue;
+        if (staging) {
+            commit_tide_db_update ();
+            staging = NVFalse;
+        }
+        close_db (NVTrue);
     }
     if ((fp = fopen (file, "rb+")) == NULL) {
-        if ((fp = fopen (file, "rb")) == NULL) return (NVFalse);
+        if ((fp = fopen (file, "rb")) == NULL) {
+            arena_release (NVFalse);
+            return (NVFalse);
+        }
     }
     boundscheck_monologue (file);
-    strcpy (filename, file);
-    return (read_tide_db_header());
+    /* reopen_tide_db passes filename itself. */
+    if (file != filename) strcpy (filename, file);
+    ret = read_tide_db_header();
+    if (ret) remember_file ();
+    if (stats_enabled && start) {
+        ++stats.opens;
+        stats.open_ns += stats_clock () - start;
+    }
+    return (ret);
 }
 
 
 /*****************************************************************************\
+  2026-10-19
+  Frees the tables that read_tide_db_header allocates in h, leaving the
+  pointers null.  Extracted from close_db so that release_tide_db_snapshot
+  can free a header that is no longer the open one.
+\*****************************************************************************/
+static void free_header (TIDE_HEADER_DATA *h) {
+  NV_U_INT32 i;
 
-    Function        close_tide_db - closes the tide database
+  assert (h->constituent);
+  free (h->constituent);
+  h->constituent = NULL;
 
-    Synopsis        close_tide_db ();
+  if (h->speed != NULL) free (h->speed);
+  h->speed = NULL;
 
-    Returns         void
+  assert (h->equilibrium);
+  for (i = 0 ; i < h->pub.constituents ; ++i)
+    if (h->equilibrium[i] != NULL) free (h->equilibrium[i]);
+  free (h->equilibrium);
+  h->equilibrium = NULL;
 
-    Author          Jan C. Depner
-    Date            08/01/02
+  assert (h->node_factor);
+  for (i = 0 ; i < h->pub.constituents ; ++i)
+    if (h->node_factor[i] != NULL) free (h->node_factor[i]);
+  free (h->node_factor);
+  h->node_factor = NULL;
 
-    See libtcd.html for changelog.
+  assert (h->level_unit);
+  free (h->level_unit);
+  h->level_unit = NULL;
 
-    If the global modified flag is true, the database header is rewritten
-    before the database is closed.  The modified flag is then cleared.
+  assert (h->dir_unit);
+  free (h->dir_unit);
+  h->dir_unit = NULL;
 
-\*****************************************************************************/
+  assert (h->restriction);
+  free (h->restriction);
+  h->restriction = NULL;
 
-void close_tide_db ()
-{
-    NV_U_INT32 i;
+  assert (h->legalese);
+  free (h->legalese);
+  h->legalese = NULL;
 
-    if (!fp) {
-      fprintf (stderr, "libtcd warning: close_tide_db called when no database open\n");
-      return;
-    }
+  assert (h->tzfile);
+  free (h->tzfile);
+  h->tzfile = NULL;
 
-    /*  If we've changed something in the file, write the header to reset
-        the last modified time.  */
+  assert (h->country);
+  free (h->country);
+  h->country = NULL;
 
-    if (modified) write_tide_db_header ();
+  assert (h->datum);
+  free (h->datum);
+  h->datum = NULL;
+}
 
 
-    /*  Free all of the temporary memory.  */
+/*****************************************************************************\
 
-    assert (hd.constituent);
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        if (hd.constituent[i] != NULL) free (hd.constituent[i]);
-    }
-    free (hd.constituent);
-    hd.constituent = NULL;
+    Function        close_db - closes the tide database, optionally keeping
+                    the string arena for the next open
 
-    if (hd.speed != NULL) free (hd.speed);
+    Synopsis        close_db (keep_arena);
 
-    assert (hd.equilibrium);
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        if (hd.equilibrium[i] != NULL) free (hd.equilibrium[i]);
-    }
-    free (hd.equilibrium);
-    hd.equilibrium = NULL;
+                    NV_BOOL keep_arena      NVTrue to keep the arena memory
 
-    assert (hd.node_factor);
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        if (hd.node_factor[i] != NULL) free (hd.node_factor[i]);
-    }
-    free (hd.node_factor);
-    hd.node_factor = NULL;
+    Returns         void
 
-    assert (hd.level_unit);
-    for (i = 0 ; i < hd.pub.level_unit_types ; ++i)
-    {
-        if (hd.level_unit[i] != NULL) free (hd.level_unit[i]);
-    }
-    free (hd.level_unit);
-    hd.level_unit = NULL;
+    Extracted from close_tide_db, 2026-10-19.
 
-    assert (hd.dir_unit);
-    for (i = 0 ; i < hd.pub.dir_unit_types ; ++i)
-    {
-        if (hd.dir_unit[i] != NULL) free (hd.dir_unit[i]);
-    }
-    free (hd.dir_unit);
-    hd.dir_unit = NULL;
+    If the global modified flag is true, the database header is rewritten
+    before the database is closed.  The modified flag is then cleared.
 
-    assert (hd.restriction);
-    for (i = 0 ; i < hd.max_restriction_types ; ++i)
-    {
-        if (hd.restriction[i] != NULL) free (hd.restriction[i]);
-    }
-    free (hd.restriction);
-    hd.restriction = NULL;
+\*****************************************************************************/
 
-    assert (hd.legalese);
-    for (i = 0 ; i < hd.max_legaleses ; ++i)
-    {
-        if (hd.legalese[i] != NULL) free (hd.legalese[i]);
-    }
-    free (hd.legalese);
-    hd.legalese = NULL;
+static void close_db (NV_BOOL keep_arena)
+{
+    /*  If we've changed something in the file, write the header to reset
+        the last modified time.  */
 
-    assert (hd.tzfile);
-    for (i = 0 ; i < hd.max_tzfiles ; ++i)
-    {
-        if (hd.tzfile[i] != NULL) free (hd.tzfile[i]);
-    }
-    free (hd.tzfile);
-    hd.tzfile = NULL;
+    if (modified) write_tide_db_header ();
 
-    assert (hd.country);
-    for (i = 0 ; i < hd.max_countries ; ++i)
-    {
-        if (hd.country[i] != NULL) free (hd.country[i]);
-    }
-    free (hd.country);
-    hd.country = NULL;
 
-    assert (hd.datum);
-    for (i = 0 ; i < hd.max_datum_types ; ++i)
-    {
-        if (hd.datum[i] != NULL) free (hd.datum[i]);
-    }
-    free (hd.datum);
-    hd.datum = NULL;
+    /*  Free all of the temporary memory.  The strings themselves all
+        live in the arena.  */
+
+    free_header (&hd);
+
+    table_address[EQUILIBRIUM_TABLE] = table_address[NODE_FACTOR_TABLE] = 0;
+    table_dirty[EQUILIBRIUM_TABLE] = table_dirty[NODE_FACTOR_TABLE] = NVFalse;
+    clear_table_cache ();
+    free (table_buf);
+    table_buf = NULL;
+    table_buf_size = 0;
 
     /* tindex will still be null on create_tide_db */
     if (tindex) {
-      for (i = 0 ; i < hd.pub.number_of_records ; ++i)
-      {
-          if (tindex[i].name) free (tindex[i].name);
-      }
       free (tindex);
       tindex = NULL;
     }
 
+    arena_release (keep_arena);
+
+    if (!keep_arena) {
+      free (read_buf);
+      read_buf = NULL;
+      read_buf_size = 0;
+    }
+
     fclose (fp);
     fp = NULL;
     modified = NVFalse;
@@ -3793,1342 +4226,2630 @@ void close_tide_db ()
 
 /*****************************************************************************\
 
-    Function        create_tide_db - creates the tide database
-
-    Synopsis        create_tide_db (file, constituents, constituent, speed,
-                        start_year, num_years, equilibrium, node_factor);
+    Function        close_tide_db - closes the tide database
 
-                    NV_CHAR *file              database file name
-                    NV_U_INT32 constituents    number of constituents
-                    NV_CHAR *constituent[]     constituent names
-                    NV_FLOAT64 *speed          speed values
-                    NV_INT32 start_year        start year
-                    NV_U_INT32 num_years       number of years
-                    NV_FLOAT32 *equilibrium[]  equilibrium arguments
-                    NV_FLOAT32 *node_factor[]  node factors
+    Synopsis        close_tide_db ();
 
-    Returns         NV_BOOL                 NVTrue if file created
+    Returns         void
 
     Author          Jan C. Depner
     Date            08/01/02
 
     See libtcd.html for changelog.
 
+    If the global modified flag is true, the database header is rewritten
+    before the database is closed.  The modified flag is then cleared.
+    If LIBTCD_STATS is set in the environment the performance statistics
+    are then printed to stderr.
+
 \*****************************************************************************/
 
-NV_BOOL create_tide_db (const NV_CHAR *file, NV_U_INT32 constituents, NV_CHAR
-const * const constituent[], const NV_FLOAT64 *speed, NV_INT32 start_year,
-NV_U_INT32 num_years, NV_FLOAT32 const * const equilibrium[], NV_FLOAT32
-const * const node_factor[])
+void close_tide_db ()
 {
-    NV_U_INT32            i, j;
-    NV_FLOAT64            min_value, max_value;
-    NV_INT32              temp_int;
-
-    /* Validate input */
-    assert (file);
-    assert (constituent);
-    assert (speed);
-    assert (equilibrium);
-    assert (node_factor);
-    for (i = 0 ; i < constituents ; ++i) {
-      if (speed[i] < 0.0) {
-        fprintf (stderr, "libtcd create_tide_db: somebody tried to set a negative speed (%f)\n", speed[i]);
-        return NVFalse;
-      }
-      for (j = 0 ; j < num_years ; ++j) {
-        if (node_factor[i][j] <= 0.0) {
-          fprintf (stderr, "libtcd create_tide_db: somebody tried to set a negative or zero node factor (%f)\n", node_factor[i][j]);
-          return NVFalse;
-        }
-      }
+    if (!fp) {
+      fprintf (stderr, "libtcd warning: close_tide_db called when no database open\n");
+      return;
     }
-
-    if (fp)
-      close_tide_db();
-
-    if ((fp = fopen (file, "wb+")) == NULL) {
-      perror (file);
-      return (NVFalse);
+    if (staging) {
+        commit_tide_db_update ();
+        staging = NVFalse;
     }
+    close_db (NVFalse);
+    if (stats_dump) dump_tide_db_stats ();
+}
 
-    /*  Zero out the header structure.  */
 
-    memset (&hd, 0, sizeof (hd));
+/*****************************************************************************\
 
-    hd.pub.major_rev = LIBTCD_MAJOR_REV;
-    hd.pub.minor_rev = LIBTCD_MINOR_REV;
+    Function        reopen_tide_db - rereads the header and index of the
+                    open database from the file
 
-    hd.header_size = DEFAULT_HEADER_SIZE;
-    hd.pub.number_of_records = DEFAULT_NUMBER_OF_RECORDS;
+    Synopsis        reopen_tide_db ();
 
-    hd.pub.start_year = start_year;
-    hd.pub.number_of_years = num_years;
+    Returns         NV_BOOL                 NVTrue if the file was reread
 
-    hd.pub.constituents = constituents;
+    Date            2026-10-19
 
+    Pending changes are written out first, as by close_tide_db.  The
+    string arena is kept and reused, so this is considerably cheaper
+    than close_tide_db followed by open_tide_db.
 
-    /*  Constituent names.  */
+\*****************************************************************************/
 
-    hd.constituent =
-        (NV_CHAR **) calloc (hd.pub.constituents, sizeof (NV_CHAR *));
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        hd.constituent[i] = (NV_CHAR *) calloc (strlen (constituent[i]) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.constituent[i], constituent[i]);
+NV_BOOL reopen_tide_db ()
+{
+    if (!fp) {
+      fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+      return NVFalse;
     }
+    close_db (NVTrue);
+    if (staging) return open_stage ();
+    return open_tide_db (filename);
+}
 
 
-    /* A constituent count is stored with each reference station record,
-       and it uses constituent_bits, so we need to be able to store
-       the count itself (not just the values 0..count-1). */
-    hd.constituent_bits = calculate_bits (hd.pub.constituents);
+/*****************************************************************************\
+  Reloading a replaced database
+  2026-10-19
+
+  reload_tide_db reads a new version of the open file into fresh memory
+  and installs it in place of the old one, which is handed back to the
+  caller intact as a TIDE_DB_SNAPSHOT:  the open FILE, the header and its
+  tables, the index, and the string arena.  Every pointer a reader
+  already holds -- station and table names from get_station and
+  friends, rows from get_equilibriums and get_node_factors -- stays
+  valid until the caller passes the snapshot to release_tide_db_snapshot,
+  which it does once those readers are done.  If the new file can't be
+  read the old database stays open and nothing changes.
+
+  The scratch buffers (read_buf, table_buf) are not per-database and
+  are kept.  The table cache is emptied since it holds decoded values.
+\*****************************************************************************/
 
+struct TIDE_DB_SNAPSHOT
+{
+    FILE                    *fp;
+    TIDE_HEADER_DATA        hd;
+    TIDE_INDEX              *tindex;
+    STRING_BLOCK            *arena;
+    NV_U_BYTE               degrees_true;
+    NV_U_INT32              max_record_size;
+    NV_INT64                table_address[2];
+#ifdef HAVE_SYS_STAT_H
+    struct stat             file_stat;
+#endif
+};
+
+
+/*  Moves the open database into snap, leaving nothing open.  */
+static void save_snapshot (TIDE_DB_SNAPSHOT *snap) {
+  snap->fp = fp;
+  snap->hd = hd;
+  snap->tindex = tindex;
+  snap->arena = arena;
+  snap->degrees_true = degrees_true;
+  snap->max_record_size = max_record_size;
+  snap->table_address[EQUILIBRIUM_TABLE] = table_address[EQUILIBRIUM_TABLE];
+  snap->table_address[NODE_FACTOR_TABLE] = table_address[NODE_FACTOR_TABLE];
+#ifdef HAVE_SYS_STAT_H
+  snap->file_stat = file_stat;
+#endif
 
-    /*  Set all of the speed attributes.  */
+  fp = NULL;
+  memset (&hd, 0, sizeof (hd));
+  tindex = NULL;
+  arena = NULL;
+  table_address[EQUILIBRIUM_TABLE] = table_address[NODE_FACTOR_TABLE] = 0;
+  clear_table_cache ();
+}
 
-    hd.speed =  (NV_FLOAT64 *) calloc (hd.pub.constituents,
-        sizeof (NV_FLOAT64));
 
-    hd.speed_scale = DEFAULT_SPEED_SCALE;
-    min_value = 99999999.0;
-    max_value = -99999999.0;
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        if (speed[i] < min_value) min_value = speed[i];
-        if (speed[i] > max_value) max_value = speed[i];
+/*  Reinstates a database moved out by save_snapshot.  */
+static void restore_snapshot (const TIDE_DB_SNAPSHOT *snap) {
+  fp = snap->fp;
+  hd = snap->hd;
+  tindex = snap->tindex;
+  arena = snap->arena;
+  degrees_true = snap->degrees_true;
+  max_record_size = snap->max_record_size;
+  table_address[EQUILIBRIUM_TABLE] = snap->table_address[EQUILIBRIUM_TABLE];
+  table_address[NODE_FACTOR_TABLE] = snap->table_address[NODE_FACTOR_TABLE];
+#ifdef HAVE_SYS_STAT_H
+  file_stat = snap->file_stat;
+#endif
+  clear_table_cache ();
+  current_record = -1;
+  current_index = -1;
+  current_search_index = 0;
+}
 
-        hd.speed[i] = speed[i];
-    }
 
-    /* DWF fixed sign reversal 2003-11-16 */
-    /* DWF harmonized rounding with the way it is done in write_tide_db_header
-       2007-01-22 */
-    hd.speed_offset = (NINT (min_value * hd.speed_scale));
-    temp_int = NINT (max_value * hd.speed_scale) - hd.speed_offset;
-    assert (temp_int >= 0);
-    hd.speed_bits = calculate_bits ((NV_U_INT32)temp_int);
-    /* Generally 31.  With signed ints we don't have any bits to spare. */
-    assert (hd.speed_bits < 32);
-
-    /*  Set all of the equilibrium attributes.  */
-
-    hd.equilibrium = (NV_FLOAT32 **) calloc (hd.pub.constituents,
-        sizeof (NV_FLOAT32 *));
+/*****************************************************************************\
 
-    hd.equilibrium_scale = DEFAULT_EQUILIBRIUM_SCALE;
-    min_value = 99999999.0;
-    max_value = -99999999.0;
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        hd.equilibrium[i] = (NV_FLOAT32 *) calloc (hd.pub.number_of_years,
-            sizeof (NV_FLOAT32));
-        for (j = 0 ; j < hd.pub.number_of_years ; ++j)
-        {
-            if (equilibrium[i][j] < min_value) min_value = equilibrium[i][j];
-            if (equilibrium[i][j] > max_value) max_value = equilibrium[i][j];
+    Function        reload_tide_db - replaces the open database with the
+                    current version of its file if that has changed
 
-            hd.equilibrium[i][j] = equilibrium[i][j];
-        }
-    }
+    Synopsis        reload_tide_db ();
 
-    /* DWF fixed sign reversal 2003-11-16 */
-    /* DWF harmonized rounding with the way it is done in write_tide_db_header
-       2007-01-22 */
-    hd.equilibrium_offset = (NINT (min_value * hd.equilibrium_scale));
-    temp_int = NINT (max_value * hd.equilibrium_scale) - hd.equilibrium_offset;
-    assert (temp_int >= 0);
-    hd.equilibrium_bits = calculate_bits ((NV_U_INT32)temp_int);
+    Returns         TIDE_DB_SNAPSHOT *      the database that was replaced,
+                                            or NULL if the file has not
+                                            changed or could not be read
 
+    Date            2026-10-19
 
-    /*  Set all of the node factor attributes.  */
+    Nothing is freed; the caller must pass the result to
+    release_tide_db_snapshot.  Fails if there are unwritten changes.
+    Must not be called from an iterate_tide_records visitor.
 
-    hd.node_factor = (NV_FLOAT32 **) calloc (hd.pub.constituents,
-        sizeof (NV_FLOAT32 *));
+\*****************************************************************************/
 
-    hd.node_scale = DEFAULT_NODE_SCALE;
-    min_value = 99999999.0;
-    max_value = -99999999.0;
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
-    {
-        hd.node_factor[i] = (NV_FLOAT32 *) calloc (hd.pub.number_of_years,
-            sizeof (NV_FLOAT32));
-        for (j = 0 ; j < hd.pub.number_of_years ; ++j)
-        {
-            if (node_factor[i][j] < min_value) min_value =
-                node_factor[i][j];
-            if (node_factor[i][j] > max_value) max_value =
-                node_factor[i][j];
+TIDE_DB_SNAPSHOT *reload_tide_db ()
+{
+    TIDE_DB_SNAPSHOT    *old;
+    NV_U_INT64          start;
 
-            hd.node_factor[i][j] = node_factor[i][j];
-        }
+    if (!fp) {
+      fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+      return NULL;
     }
+    if (modified || staging) {
+      fprintf (stderr, "libtcd error: reload_tide_db called with unwritten changes\n");
+      return NULL;
+    }
+    if (!tide_db_changed ()) return NULL;
+    STATS_START (start);
 
-    /* DWF fixed sign reversal 2003-11-16 */
-    /* DWF harmonized rounding with the way it is done in write_tide_db_header
-       2007-01-22 */
-    hd.node_offset = (NINT (min_value * hd.node_scale));
-    temp_int = NINT (max_value * hd.node_scale) - hd.node_offset;
-    assert (temp_int >= 0);
-    hd.node_bits = calculate_bits ((NV_U_INT32)temp_int);
+    if ((old = (TIDE_DB_SNAPSHOT *) malloc (sizeof (TIDE_DB_SNAPSHOT)))
+        == NULL) {
+        perror ("Allocating tide db snapshot");
+        exit (-1);
+    }
+    save_snapshot (old);
 
+    if ((fp = fopen (filename, "rb+")) == NULL)
+        fp = fopen (filename, "rb");
+    if (fp == NULL || !read_tide_db_header ()) {
+        /* read_tide_db_header closes the file when it fails. */
+        fp = NULL;
+        arena_release (NVFalse);
+        restore_snapshot (old);
+        free (old);
+        return NULL;
+    }
+    remember_file ();
 
-    /*  Default city.  */
+    if (stats_enabled && start) {
+        ++stats.opens;
+        stats.open_ns += stats_clock () - start;
+    }
+    return old;
+}
 
-    hd.amplitude_bits = DEFAULT_AMPLITUDE_BITS;
-    hd.amplitude_scale = DEFAULT_AMPLITUDE_SCALE;
-    hd.epoch_bits = DEFAULT_EPOCH_BITS;
-    hd.epoch_scale = DEFAULT_EPOCH_SCALE;
 
-    hd.record_type_bits = DEFAULT_RECORD_TYPE_BITS;
-    hd.latitude_bits = DEFAULT_LATITUDE_BITS;
-    hd.latitude_scale = DEFAULT_LATITUDE_SCALE;
-    hd.longitude_bits = DEFAULT_LONGITUDE_BITS;
-    hd.longitude_scale = DEFAULT_LONGITUDE_SCALE;
-    hd.record_size_bits = DEFAULT_RECORD_SIZE_BITS;
+/*****************************************************************************\
 
-    hd.station_bits = DEFAULT_STATION_BITS;
+    Function        release_tide_db_snapshot - frees a database replaced by
+                    reload_tide_db
 
-    hd.datum_offset_bits = DEFAULT_DATUM_OFFSET_BITS;
-    hd.datum_offset_scale = DEFAULT_DATUM_OFFSET_SCALE;
-    hd.date_bits = DEFAULT_DATE_BITS;
-    hd.months_on_station_bits = DEFAULT_MONTHS_ON_STATION_BITS;
-    hd.confidence_value_bits = DEFAULT_CONFIDENCE_VALUE_BITS;
+    Synopsis        release_tide_db_snapshot (snap);
 
-    hd.time_bits = DEFAULT_TIME_BITS;
-    hd.level_add_bits = DEFAULT_LEVEL_ADD_BITS;
-    hd.level_add_scale = DEFAULT_LEVEL_ADD_SCALE;
-    hd.level_multiply_bits = DEFAULT_LEVEL_MULTIPLY_BITS;
-    hd.level_multiply_scale = DEFAULT_LEVEL_MULTIPLY_SCALE;
-    hd.direction_bits = DEFAULT_DIRECTION_BITS;
+                    TIDE_DB_SNAPSHOT *snap  from reload_tide_db; may be
+                                            NULL
 
-    hd.constituent_size = DEFAULT_CONSTITUENT_SIZE;
-    hd.level_unit_size = DEFAULT_LEVEL_UNIT_SIZE;
-    hd.dir_unit_size = DEFAULT_DIR_UNIT_SIZE;
-    hd.restriction_size = DEFAULT_RESTRICTION_SIZE;
-    hd.tzfile_size = DEFAULT_TZFILE_SIZE;
-    hd.country_size = DEFAULT_COUNTRY_SIZE;
-    hd.datum_size = DEFAULT_DATUM_SIZE;
-    hd.legalese_size = DEFAULT_LEGALESE_SIZE;
+    Returns         void
 
+    Date            2026-10-19
 
+\*****************************************************************************/
 
-    /*  Level units.  */
+void release_tide_db_snapshot (TIDE_DB_SNAPSHOT *snap)
+{
+    STRING_BLOCK    *block, *next;
 
-    hd.pub.level_unit_types = DEFAULT_LEVEL_UNIT_TYPES;
-    hd.level_unit_bits = calculate_bits (hd.pub.level_unit_types - 1);
+    if (!snap) return;
 
-    hd.level_unit = (NV_CHAR **) calloc (hd.pub.level_unit_types,
-        sizeof (NV_CHAR *));
-    for (i = 0 ; i < hd.pub.level_unit_types ; ++i)
+    free_header (&snap->hd);
+    free (snap->tindex);
+    for (block = snap->arena ; block ; block = next)
     {
-        hd.level_unit[i] = (NV_CHAR *) calloc (strlen (level_unit[i]) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.level_unit[i], level_unit[i]);
+        next = block->next;
+        free (block);
     }
+    fclose (snap->fp);
+    free (snap);
+}
 
 
-    /*  Direction units.  */
+/*****************************************************************************\
+  Staged updates
+  2026-10-19
+
+  Normally every change is written straight into the open file, so a
+  process reading it at the same time can see a half-written file and a
+  crash can leave it corrupt.  Between begin_tide_db_update and
+  commit_tide_db_update, fp is instead a copy of the file named
+  filename.new, and all of the usual functions (update_tide_record,
+  delete_tide_record, the header rewrite, ...) work on that.  The copy
+  is made with large block reads and writes, so unchanged records cost
+  one sequential pass.  Committing writes the header, fsyncs the copy,
+  renames it over the original, and fsyncs the directory; readers keep
+  the old file until they reopen it (see reload_tide_db).  A crash at
+  any point leaves either the old file or the new one, plus perhaps a
+  stale filename.new that the next begin_tide_db_update overwrites.
+
+  reopen_tide_db, which several of the writers use to rebuild the
+  index, reopens the copy while staging.  close_tide_db and
+  open_tide_db commit, in keeping with their writing out pending
+  changes.
+\*****************************************************************************/
 
-    hd.pub.dir_unit_types = DEFAULT_DIR_UNIT_TYPES;
-    hd.dir_unit_bits = calculate_bits (hd.pub.dir_unit_types - 1);
+#define STAGE_COPY_SIZE         (1 << 20)
 
-    hd.dir_unit = (NV_CHAR **) calloc (hd.pub.dir_unit_types,
-        sizeof (NV_CHAR *));
-    for (i = 0 ; i < hd.pub.dir_unit_types ; ++i)
-    {
-        hd.dir_unit[i] = (NV_CHAR *) calloc (strlen (dir_unit[i]) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.dir_unit[i], dir_unit[i]);
-    }
 
+/*  Reopens the staged copy after close_db, for reopen_tide_db.  */
+static NV_BOOL open_stage () {
+  if ((fp = fopen (stage_name, "rb+")) == NULL) {
+    perror (stage_name);
+    staging = NVFalse;
+    arena_release (NVFalse);
+    return NVFalse;
+  }
+  return read_tide_db_header ();
+}
 
-    /*  Restrictions.  */
 
-    hd.restriction_bits = DEFAULT_RESTRICTION_BITS;
-    hd.max_restriction_types = NINT (pow (2.0,
-        (NV_FLOAT64) hd.restriction_bits));
-    hd.pub.restriction_types = DEFAULT_RESTRICTION_TYPES;
+/*  Makes everything written to fp durable before it is renamed.  */
+static void sync_db () {
+  require (fflush (fp) == 0);
+#ifdef HAVE_FSYNC
+  if (fsync (fileno (fp)))
+    perror ("libtcd: fsync");
+#endif
+}
 
-    hd.restriction = (NV_CHAR **) calloc (hd.max_restriction_types,
-        sizeof (NV_CHAR *));
-    for (i = 0 ; i < hd.max_restriction_types ; ++i)
-    {
-        if (i == hd.pub.restriction_types) break;
 
-        hd.restriction[i] = (NV_CHAR *) calloc (strlen (restriction[i]) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.restriction[i], restriction[i]);
-    }
+/*  Makes the rename of stage_name to filename durable.  */
+static void sync_dir () {
+#if defined(HAVE_FSYNC) && defined(HAVE_FCNTL_H)
+  NV_CHAR dir[MONOLOGUE_LENGTH], *slash;
+  int fd;
+
+  strcpy (dir, filename);
+  if ((slash = strrchr (dir, '/')) == NULL)
+    strcpy (dir, ".");
+  else if (slash == dir)
+    dir[1] = '\0';
+  else
+    *slash = '\0';
+  if ((fd = open (dir, O_RDONLY)) >= 0) {
+    fsync (fd);
+    close (fd);
+  }
+#endif
+}
 
 
-    /*  Legaleses.  */
+/*****************************************************************************\
 
-    hd.legalese_bits = DEFAULT_LEGALESE_BITS;
-    hd.max_legaleses = NINT (pow (2.0, (NV_FLOAT64) hd.legalese_bits));
-    hd.pub.legaleses = DEFAULT_LEGALESES;
+    Function        begin_tide_db_update - starts staging changes to the
+                    open database in a copy of the file
 
-    hd.legalese = (NV_CHAR **) calloc (hd.max_legaleses,
-        sizeof (NV_CHAR *));
-    for (i = 0 ; i < hd.max_legaleses ; ++i)
-    {
-        if (i == hd.pub.legaleses) break;
+    Synopsis        begin_tide_db_update ();
 
-        hd.legalese[i] = (NV_CHAR *) calloc (strlen (legalese[i]) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.legalese[i], legalese[i]);
-    }
+    Returns         NV_BOOL                 NVTrue if the copy was made
 
+    Date            2026-10-19
 
-    /*  Tzfiles.  */
+\*****************************************************************************/
 
-    hd.tzfile_bits = DEFAULT_TZFILE_BITS;
-    hd.max_tzfiles = NINT (pow (2.0, (NV_FLOAT64) hd.tzfile_bits));
-    hd.pub.tzfiles = DEFAULT_TZFILES;
+NV_BOOL begin_tide_db_update ()
+{
+    FILE            *out;
+    NV_U_BYTE       *buf;
+    size_t          n;
 
-    hd.tzfile = (NV_CHAR **) calloc (hd.max_tzfiles, sizeof (NV_CHAR *));
-    for (i = 0 ; i < hd.max_tzfiles ; ++i)
-    {
-        if (i == hd.pub.tzfiles) break;
+    if (!fp) {
+      fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+      return NVFalse;
+    }
+    if (staging) {
+      fprintf (stderr, "libtcd error: begin_tide_db_update called during a staged update\n");
+      return NVFalse;
+    }
+    write_protect ();
 
-        hd.tzfile[i] = (NV_CHAR *) calloc (strlen (tzfile[i]) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.tzfile[i], tzfile[i]);
+    sprintf (stage_name, "%s.new", filename);
+    if ((out = fopen (stage_name, "wb+")) == NULL) {
+        perror (stage_name);
+        return NVFalse;
+    }
+    if ((buf = (NV_U_BYTE *) malloc (STAGE_COPY_SIZE)) == NULL) {
+        perror ("libtcd: begin_tide_db_update: can't malloc");
+        fclose (out);
+        remove (stage_name);
+        return NVFalse;
+    }
+    require (seek_db (0, SEEK_SET) == 0);
+    while ((n = fread (buf, 1, STAGE_COPY_SIZE, fp)) > 0)
+        chk_fwrite (buf, n, 1, out);
+    free (buf);
+    if (ferror (fp)) {
+        perror (filename);
+        fclose (out);
+        remove (stage_name);
+        return NVFalse;
     }
+#if defined(HAVE_SYS_STAT_H) && defined(HAVE_FCHMOD)
+    fchmod (fileno (out), file_stat.st_mode & 07777);
+#endif
 
+    fclose (fp);
+    fp = out;
+    staging = NVTrue;
+    current_record = -1;
+    return NVTrue;
+}
 
-    /*  Countries.  */
 
-    hd.country_bits = DEFAULT_COUNTRY_BITS;
-    hd.max_countries = NINT (pow (2.0, (NV_FLOAT64) hd.country_bits));
-    hd.pub.countries = DEFAULT_COUNTRIES;
+/*****************************************************************************\
 
-    hd.country = (NV_CHAR **) calloc (hd.max_countries, sizeof (NV_CHAR *));
-    for (i = 0 ; i < hd.max_countries ; ++i)
-    {
-        if (i == hd.pub.countries) break;
+    Function        commit_tide_db_update - publishes the staged copy in
+                    place of the original file
 
-        hd.country[i] = (NV_CHAR *) calloc (strlen (country[i]) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.country[i], country[i]);
-    }
+    Synopsis        commit_tide_db_update ();
 
+    Returns         NV_BOOL                 NVTrue if the copy was renamed
+                                            over the original
 
-    /*  Datums.  */
+    Date            2026-10-19
 
-    hd.datum_bits = DEFAULT_DATUM_BITS;
-    hd.max_datum_types = NINT (pow (2.0, (NV_FLOAT64) hd.datum_bits));
-    hd.pub.datum_types = DEFAULT_DATUM_TYPES;
+    The database stays open on the newly published file.  If the rename
+    fails the update is still staged and can be retried or aborted.
 
-    hd.datum = (NV_CHAR **) calloc (hd.max_datum_types, sizeof (NV_CHAR *));
-    for (i = 0 ; i < hd.max_datum_types ; ++i)
-    {
-        if (i == hd.pub.datum_types) break;
+\*****************************************************************************/
 
-        hd.datum[i] = (NV_CHAR *) calloc (strlen (datum[i]) + 1,
-            sizeof (NV_CHAR));
-        strcpy (hd.datum[i], datum[i]);
+NV_BOOL commit_tide_db_update ()
+{
+    if (!fp) {
+      fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+      return NVFalse;
+    }
+    if (!staging) {
+      fprintf (stderr, "libtcd error: commit_tide_db_update called without begin_tide_db_update\n");
+      return NVFalse;
     }
 
+    if (modified) {
+        write_tide_db_header ();
+        modified = NVFalse;
+    }
+    sync_db ();
+    if (rename (stage_name, filename)) {
+        fprintf (stderr, "libtcd error: can't rename %s to %s: %s\n",
+                 stage_name, filename, strerror (errno));
+        return NVFalse;
+    }
+    sync_dir ();
 
-    /*  Write the header to the file and close. */
+    staging = NVFalse;
+    remember_file ();
+    return NVTrue;
+}
 
-    modified = NVTrue;
-    close_tide_db ();
 
+/*****************************************************************************\
 
-    /*  Re-open it and read the header from the file.  */
+    Function        abort_tide_db_update - discards the staged copy and
+                    reopens the original file
 
-    i = (open_tide_db (file));
+    Synopsis        abort_tide_db_update ();
 
+    Returns         NV_BOOL                 NVTrue if the original was
+                                            reopened
 
-    /*  Set the correct end of file position since the one in the header is
-        set to 0.  */
-    hd.end_of_file = ftell(fp);
-    /* DWF 2004-08-15: if the original program exits without adding any
-       records, that doesn't help!  Rewrite the header with correct
-       end_of_file. */
-    write_tide_db_header ();
+    Date            2026-10-19
 
-    return (i);
+\*****************************************************************************/
+
+NV_BOOL abort_tide_db_update ()
+{
+    if (!fp) {
+      fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+      return NVFalse;
+    }
+    if (!staging) {
+      fprintf (stderr, "libtcd error: abort_tide_db_update called without begin_tide_db_update\n");
+      return NVFalse;
+    }
+
+    modified = NVFalse;
+    staging = NVFalse;
+    close_db (NVTrue);
+    remove (stage_name);
+    return open_tide_db (filename);
 }
 
 
 /*****************************************************************************\
-  DWF 2004-10-13
-  Used in check_tide_record.
+  2026-10-19
+  Replaces table t (EQUILIBRIUM_TABLE or NODE_FACTOR_TABLE) with a copy
+  of values, which has hd.pub.constituents rows of
+  hd.pub.number_of_years, and works out the offset and bits to encode
+  it with at the table's scale.  Any rows already loaded are freed.  The
+  table is marked dirty.
 \*****************************************************************************/
-static NV_BOOL check_date (NV_U_INT32 date) {
-  if (date) {
-    unsigned m, d;
-    date %= 10000;
-    m = date / 100;
-    d = date % 100;
-    if (m < 1 || m > 12 || d < 1 || d > 31)
-      return NVFalse;
+static void load_table (NV_U_INT32 t, NV_FLOAT32 const * const values[]) {
+  NV_FLOAT32 ***rows;
+  NV_U_INT32 i, j, scale, *bits;
+  NV_INT32 *offset, temp_int;
+  NV_FLOAT64 min_value, max_value;
+
+  if (t == EQUILIBRIUM_TABLE) {
+    rows = &hd.equilibrium;
+    scale = hd.equilibrium_scale;
+    offset = &hd.equilibrium_offset;
+    bits = &hd.equilibrium_bits;
+  } else {
+    rows = &hd.node_factor;
+    scale = hd.node_scale;
+    offset = &hd.node_offset;
+    bits = &hd.node_bits;
   }
-  return NVTrue;
-}
 
+  if (*rows) {
+    for (i = 0 ; i < hd.pub.constituents ; ++i)
+      free ((*rows)[i]);
+    free (*rows);
+  }
+  if ((*rows = (NV_FLOAT32 **) calloc (hd.pub.constituents,
+       sizeof (NV_FLOAT32 *))) == NULL) {
+    perror ("Allocating table rows");
+    exit (-1);
+  }
 
-/*****************************************************************************\
-  DWF 2004-10-13
-  Returns true iff a record is valid enough to write.  Reports all problems
-  to stderr.  The checks are not designed to be airtight (e.g., if you
-  use 360 degrees instead of 0 we'll let it slide).
+  min_value = 99999999.0;
+  max_value = -99999999.0;
+  for (i = 0 ; i < hd.pub.constituents ; ++i) {
+    if (((*rows)[i] = (NV_FLOAT32 *) calloc (hd.pub.number_of_years,
+         sizeof (NV_FLOAT32))) == NULL) {
+      perror ("Allocating table row");
+      exit (-1);
+    }
+    for (j = 0 ; j < hd.pub.number_of_years ; ++j) {
+      if (values[i][j] < min_value) min_value = values[i][j];
+      if (values[i][j] > max_value) max_value = values[i][j];
+      (*rows)[i][j] = values[i][j];
+    }
+  }
 
-  Mild side effects may occur:
-  Note that the units-to-level-units COMPAT114 trick is wedged in here.
-\*****************************************************************************/
-static NV_BOOL check_tide_record (TIDE_RECORD *rec) {
-  NV_U_INT32 i;
-  NV_BOOL ret = NVTrue;
+  /* DWF fixed sign reversal 2003-11-16 */
+  /* DWF harmonized rounding with the way it is done in write_tide_db_header
+     2007-01-22 */
+  *offset = (NINT (min_value * scale));
+  temp_int = NINT (max_value * scale) - *offset;
+  assert (temp_int >= 0);
+  *bits = calculate_bits ((NV_U_INT32)temp_int);
 
-  if (!rec) {
-    fprintf (stderr, "libtcd error: null pointer passed to check_tide_record\n");
-    return NVFalse;
-  }
+  table_dirty[t] = NVTrue;
+  clear_table_cache ();
+}
 
-  /* These are all static fields--if a buffer overflow has occurred on one
-     of these, other fields might be invalid, but the problem started here. */
-  boundscheck_oneliner (rec->header.name);
-  boundscheck_oneliner (rec->source);
-  boundscheck_monologue (rec->comments);
-  boundscheck_monologue (rec->notes);
-  boundscheck_oneliner (rec->station_id_context);
-  boundscheck_oneliner (rec->station_id);
-  boundscheck_monologue (rec->xfields);
 
-#ifdef COMPAT114
-  if (rec->header.record_type == REFERENCE_STATION && rec->units > 0)
-    rec->level_units = rec->units;
-#endif
+/*****************************************************************************\
 
-  if (rec->header.latitude < -90.0 || rec->header.latitude > 90.0 ||
-      rec->header.longitude < -180.0 || rec->header.longitude > 180.0) {
-    fprintf (stderr, "libtcd error: bad coordinates in tide record\n");
-    ret = NVFalse;
-  }
-
-  if (rec->header.tzfile < 0 || rec->header.tzfile >= (NV_INT32)hd.pub.tzfiles) {
-    fprintf (stderr, "libtcd error: bad tzfile in tide record\n");
-    ret = NVFalse;
-  }
-
-  if (rec->header.name[0] == '\0') {
-    fprintf (stderr, "libtcd error: null name in tide record\n");
-    ret = NVFalse;
-  }
-
-  if (rec->country < 0 || rec->country >= (NV_INT32)hd.pub.countries) {
-    fprintf (stderr, "libtcd error: bad country in tide record\n");
-    ret = NVFalse;
-  }
+    Function        create_tide_db - creates the tide database
 
-  if (rec->restriction >= hd.pub.restriction_types) {
-    fprintf (stderr, "libtcd error: bad restriction in tide record\n");
-    ret = NVFalse;
-  }
+    Synopsis        create_tide_db (file, constituents, constituent, speed,
+                        start_year, num_years, equilibrium, node_factor);
 
-  if (rec->legalese >= hd.pub.legaleses) {
-    fprintf (stderr, "libtcd error: bad legalese in tide record\n");
-    ret = NVFalse;
-  }
+                    NV_CHAR *file              database file name
+                    NV_U_INT32 constituents    number of constituents
+                    NV_CHAR *constituent[]     constituent names
+                    NV_FLOAT64 *speed          speed values
+                    NV_INT32 start_year        start year
+                    NV_U_INT32 num_years       number of years
+                    NV_FLOAT32 *equilibrium[]  equilibrium arguments
+                    NV_FLOAT32 *node_factor[]  node factors
 
-  if (!check_date (rec->date_imported)) {
-    fprintf (stderr, "libtcd error: bad date_imported in tide record\n");
-    ret = NVFalse;
-  }
+    Returns         NV_BOOL                 NVTrue if file created
 
-  if (rec->direction_units >= hd.pub.dir_unit_types) {
-    fprintf (stderr, "libtcd error: bad direction_units in tide record\n");
-    ret = NVFalse;
-  }
+    Author          Jan C. Depner
+    Date            08/01/02
 
-  if (rec->min_direction < 0 || rec->min_direction > 361) {
-    fprintf (stderr, "libtcd error: min_direction out of range in tide record\n");
-    ret = NVFalse;
-  }
+    See libtcd.html for changelog.
 
-  if (rec->max_direction < 0 || rec->max_direction > 361) {
-    fprintf (stderr, "libtcd error: max_direction out of range in tide record\n");
-    ret = NVFalse;
-  }
+\*****************************************************************************/
 
-  if (rec->level_units >= hd.pub.level_unit_types) {
-    fprintf (stderr, "libtcd error: bad units in tide record\n");
-    ret = NVFalse;
-  }
+static NV_BOOL create_db (const NV_CHAR *file, NV_U_INT32 constituents,
+NV_CHAR const * const constituent[], const NV_FLOAT64 *speed, NV_INT32
+start_year, NV_U_INT32 num_years, NV_FLOAT32 const * const equilibrium[],
+NV_FLOAT32 const * const node_factor[], NV_BOOL large)
+{
+    NV_U_INT32            i, j;
+    NV_FLOAT64            min_value, max_value;
+    NV_INT32              temp_int;
 
-  switch (rec->header.record_type) {
-  case REFERENCE_STATION:
-    if (rec->header.reference_station != -1) {
-      fprintf (stderr, "libtcd error: type 1 record, reference_station != -1\n");
-      ret = NVFalse;
+    /* Validate input */
+    assert (file);
+    assert (constituent);
+    assert (speed);
+    assert (equilibrium);
+    assert (node_factor);
+    for (i = 0 ; i < constituents ; ++i) {
+      if (speed[i] < 0.0) {
+        fprintf (stderr, "libtcd create_tide_db: somebody tried to set a negative speed (%f)\n", speed[i]);
+        return NVFalse;
+      }
+      for (j = 0 ; j < num_years ; ++j) {
+        if (node_factor[i][j] <= 0.0) {
+          fprintf (stderr, "libtcd create_tide_db: somebody tried to set a negative or zero node factor (%f)\n", node_factor[i][j]);
+          return NVFalse;
+        }
+      }
     }
 
-    if (rec->datum_offset < -13421.7728 || rec->datum_offset > 13421.7727) {
-      fprintf (stderr, "libtcd error: datum_offset out of range in tide record\n");
-      ret = NVFalse;
-    }
+    if (fp)
+      close_tide_db();
 
-    if (rec->datum < 0 || rec->datum >= (NV_INT32)hd.pub.datum_types) {
-      fprintf (stderr, "libtcd error: bad datum in tide record\n");
-      ret = NVFalse;
+    if ((fp = fopen (file, "wb+")) == NULL) {
+      perror (file);
+      return (NVFalse);
     }
 
-    if (rec->zone_offset < -4096 || rec->zone_offset > 4095 ||
-        rec->zone_offset % 100 >= 60) {
-      fprintf (stderr, "libtcd error: bad zone_offset in tide record\n");
-      ret = NVFalse;
-    }
+    /*  Zero out the header structure.  */
 
-    if (!check_date (rec->expiration_date)) {
-      fprintf (stderr, "libtcd error: bad expiration_date in tide record\n");
-      ret = NVFalse;
-    }
+    memset (&hd, 0, sizeof (hd));
 
-    if (rec->months_on_station > 1023) {
-      fprintf (stderr, "libtcd error: months_on_station out of range in tide record\n");
-      ret = NVFalse;
-    }
+    hd.pub.major_rev = large ? LIBTCD_LARGE_MAJOR_REV : LIBTCD_MAJOR_REV;
+    hd.pub.minor_rev = LIBTCD_MINOR_REV;
 
-    if (!check_date (rec->last_date_on_station)) {
-      fprintf (stderr, "libtcd error: bad last_date_on_station in tide record\n");
-      ret = NVFalse;
-    }
+    hd.header_size = DEFAULT_HEADER_SIZE;
+    hd.pub.number_of_records = DEFAULT_NUMBER_OF_RECORDS;
 
-    if (rec->confidence > 15) {
-      fprintf (stderr, "libtcd error: confidence out of range in tide record\n");
-      ret = NVFalse;
-    }
+    hd.pub.start_year = start_year;
+    hd.pub.number_of_years = num_years;
 
-    /* Only issue each error once. */
-    for (i=0; i < hd.pub.constituents; ++i) {
-      if (rec->amplitude[i] < 0.0 || rec->amplitude[i] > 52.4287) {
-        fprintf (stderr, "libtcd error: constituent amplitude out of range in tide record\n");
-        ret = NVFalse;
-        break;
-      }
-    }
-    for (i=0; i < hd.pub.constituents; ++i) {
-      if (rec->epoch[i] < 0.0 || rec->epoch[i] > 360.0) {
-        fprintf (stderr, "libtcd error: constituent epoch out of range in tide record\n");
-        ret = NVFalse;
-        break;
-      }
-    }
+    hd.pub.constituents = constituents;
 
-    break;
 
-  case SUBORDINATE_STATION:
-    if (rec->header.reference_station < 0 || rec->header.reference_station
-    >= (NV_INT32)hd.pub.number_of_records) {
-      fprintf (stderr, "libtcd error: bad reference_station in tide record\n");
-      ret = NVFalse;
-    }
+    /*  Constituent names.  */
 
-    if (rec->min_time_add < -4096 || rec->min_time_add > 4095 ||
-        rec->min_time_add % 100 >= 60) {
-      fprintf (stderr, "libtcd error: bad min_time_add in tide record\n");
-      ret = NVFalse;
+    hd.constituent =
+        (NV_CHAR **) calloc (hd.pub.constituents, sizeof (NV_CHAR *));
+    for (i = 0 ; i < hd.pub.constituents ; ++i)
+    {
+        hd.constituent[i] = arena_strdup (constituent[i]);
     }
 
-    if (rec->min_level_add < -65.536 || rec->min_level_add > 65.535) {
-      fprintf (stderr, "libtcd error: min_level_add out of range in tide record\n");
-      ret = NVFalse;
-    }
 
-    if (rec->min_level_multiply < 0.0 || rec->min_level_multiply > 65.535) {
-      fprintf (stderr, "libtcd error: min_level_multiply out of range in tide record\n");
-      ret = NVFalse;
-    }
+    /* A constituent count is stored with each reference station record,
+       and it uses constituent_bits, so we need to be able to store
+       the count itself (not just the values 0..count-1). */
+    hd.constituent_bits = calculate_bits (hd.pub.constituents);
 
-    if (rec->max_time_add < -4096 || rec->max_time_add > 4095 ||
-        rec->max_time_add % 100 >= 60) {
-      fprintf (stderr, "libtcd error: bad max_time_add in tide record\n");
-      ret = NVFalse;
-    }
 
-    if (rec->max_level_add < -65.536 || rec->max_level_add > 65.535) {
-      fprintf (stderr, "libtcd error: max_level_add out of range in tide record\n");
-      ret = NVFalse;
-    }
+    /*  Set all of the speed attributes.  */
 
-    if (rec->max_level_multiply < 0.0 || rec->max_level_multiply > 65.535) {
-      fprintf (stderr, "libtcd error: max_level_multiply out of range in tide record\n");
-      ret = NVFalse;
-    }
+    hd.speed =  (NV_FLOAT64 *) calloc (hd.pub.constituents,
+        sizeof (NV_FLOAT64));
 
-    if (rec->flood_begins != NULLSLACKOFFSET && (rec->flood_begins < -4096 ||
-    rec->flood_begins > 4095 || rec->flood_begins % 100 >= 60)) {
-      fprintf (stderr, "libtcd error: bad flood_begins in tide record\n");
-      ret = NVFalse;
-    }
+    hd.speed_scale = DEFAULT_SPEED_SCALE;
+    min_value = 99999999.0;
+    max_value = -99999999.0;
+    for (i = 0 ; i < hd.pub.constituents ; ++i)
+    {
+        if (speed[i] < min_value) min_value = speed[i];
+        if (speed[i] > max_value) max_value = speed[i];
 
-    if (rec->ebb_begins != NULLSLACKOFFSET && (rec->ebb_begins < -4096 ||
-    rec->ebb_begins > 4095 || rec->ebb_begins % 100 >= 60)) {
-      fprintf (stderr, "libtcd error: bad ebb_begins in tide record\n");
-      ret = NVFalse;
+        hd.speed[i] = speed[i];
     }
 
-    break;
+    /* DWF fixed sign reversal 2003-11-16 */
+    /* DWF harmonized rounding with the way it is done in write_tide_db_header
+       2007-01-22 */
+    hd.speed_offset = (NINT (min_value * hd.speed_scale));
+    temp_int = NINT (max_value * hd.speed_scale) - hd.speed_offset;
+    assert (temp_int >= 0);
+    hd.speed_bits = calculate_bits ((NV_U_INT32)temp_int);
+    /* Generally 31.  With signed ints we don't have any bits to spare. */
+    assert (hd.speed_bits < 32);
 
-  default:
-    fprintf (stderr, "libtcd error: invalid record_type in tide record\n");
-    ret = NVFalse;
-  }
+    /*  Set all of the equilibrium and node factor attributes.  */
 
-  if (ret == NVFalse)
-    dump_tide_record (rec);
-  return ret;
-}
+    hd.equilibrium_scale = DEFAULT_EQUILIBRIUM_SCALE;
+    hd.node_scale = DEFAULT_NODE_SCALE;
+    load_table (EQUILIBRIUM_TABLE, equilibrium);
+    load_table (NODE_FACTOR_TABLE, node_factor);
 
+    /*  Both tables are only in memory so far.  */
 
-/*****************************************************************************\
-  DWF 2004-10-13
-  Calculate size of a tide record as it would be encoded in the TCD file.
-  Size is stored in record_size field.  Return is number of constituents
-  that will be encoded.
-\*****************************************************************************/
-static NV_U_INT32 figure_size (TIDE_RECORD *rec) {
-  NV_U_INT32 i, count=0, name_size, source_size, comments_size,
-    notes_size, station_id_context_size, station_id_size, xfields_size;
+    table_address[EQUILIBRIUM_TABLE] = table_address[NODE_FACTOR_TABLE] = 0;
 
-  assert (rec);
 
-  /*  Figure out how many bits we'll need for this record. */
+    /*  Default city.  */
 
-  name_size = strlen(clip_string(rec->header.name))+1;
-  source_size = strlen(clip_string(rec->source))+1;
-  comments_size = strlen(clip_string(rec->comments))+1;
-  notes_size = strlen(clip_string(rec->notes))+1;
-  station_id_context_size = strlen(clip_string(rec->station_id_context))+1;
-  station_id_size = strlen(clip_string(rec->station_id))+1;
-  /* No clipping on xfields -- trailing \n required by syntax */
-  xfields_size = strlen(rec->xfields)+1;
+    hd.amplitude_bits = DEFAULT_AMPLITUDE_BITS;
+    hd.amplitude_scale = DEFAULT_AMPLITUDE_SCALE;
+    hd.epoch_bits = DEFAULT_EPOCH_BITS;
+    hd.epoch_scale = DEFAULT_EPOCH_SCALE;
 
-  rec->header.record_size =
-      hd.record_size_bits +
-      hd.record_type_bits +
-      hd.latitude_bits +
-      hd.longitude_bits +
-      hd.station_bits +
-      hd.tzfile_bits +
-      (name_size * 8) +
+    hd.record_type_bits = DEFAULT_RECORD_TYPE_BITS;
+    hd.latitude_bits = DEFAULT_LATITUDE_BITS;
+    hd.latitude_scale = DEFAULT_LATITUDE_SCALE;
+    hd.longitude_bits = DEFAULT_LONGITUDE_BITS;
+    hd.longitude_scale = DEFAULT_LONGITUDE_SCALE;
+    hd.record_size_bits = large ? DEFAULT_LARGE_RECORD_SIZE_BITS :
+        DEFAULT_RECORD_SIZE_BITS;
 
-      hd.country_bits +
-      (source_size  * 8) +
-      hd.restriction_bits +
-      (comments_size * 8) +
-      (notes_size * 8) +
-      hd.legalese_bits +
-      (station_id_context_size * 8) +
-      (station_id_size * 8) +
-      hd.date_bits + 
-      (xfields_size * 8) +
-      hd.dir_unit_bits +
-      hd.direction_bits +
-      hd.direction_bits +
-      hd.level_unit_bits;
+    hd.station_bits = large ? DEFAULT_LARGE_STATION_BITS :
+        DEFAULT_STATION_BITS;
 
-  switch (rec->header.record_type) {
-  case REFERENCE_STATION:
-    rec->header.record_size +=
-        hd.datum_offset_bits +
-        hd.datum_bits +
-        hd.time_bits +
-        hd.date_bits +
-        hd.months_on_station_bits +
-        hd.date_bits +
-        hd.confidence_value_bits +
-        hd.constituent_bits;
+    hd.datum_offset_bits = DEFAULT_DATUM_OFFSET_BITS;
+    hd.datum_offset_scale = DEFAULT_DATUM_OFFSET_SCALE;
+    hd.date_bits = DEFAULT_DATE_BITS;
+    hd.months_on_station_bits = DEFAULT_MONTHS_ON_STATION_BITS;
+    hd.confidence_value_bits = DEFAULT_CONFIDENCE_VALUE_BITS;
 
-    for (i = 0 ; i < hd.pub.constituents ; ++i)
+    hd.time_bits = DEFAULT_TIME_BITS;
+    hd.level_add_bits = DEFAULT_LEVEL_ADD_BITS;
+    hd.level_add_scale = DEFAULT_LEVEL_ADD_SCALE;
+    hd.level_multiply_bits = DEFAULT_LEVEL_MULTIPLY_BITS;
+    hd.level_multiply_scale = DEFAULT_LEVEL_MULTIPLY_SCALE;
+    hd.direction_bits = DEFAULT_DIRECTION_BITS;
+
+    hd.constituent_size = DEFAULT_CONSTITUENT_SIZE;
+    hd.level_unit_size = DEFAULT_LEVEL_UNIT_SIZE;
+    hd.dir_unit_size = DEFAULT_DIR_UNIT_SIZE;
+    hd.restriction_size = DEFAULT_RESTRICTION_SIZE;
+    hd.tzfile_size = DEFAULT_TZFILE_SIZE;
+    hd.country_size = DEFAULT_COUNTRY_SIZE;
+    hd.datum_size = DEFAULT_DATUM_SIZE;
+    hd.legalese_size = DEFAULT_LEGALESE_SIZE;
+
+
+
+    /*  Level units.  */
+
+    hd.pub.level_unit_types = DEFAULT_LEVEL_UNIT_TYPES;
+    hd.level_unit_bits = calculate_bits (hd.pub.level_unit_types - 1);
+
+    hd.level_unit = (NV_CHAR **) calloc (hd.pub.level_unit_types,
+        sizeof (NV_CHAR *));
+    for (i = 0 ; i < hd.pub.level_unit_types ; ++i)
     {
-        assert (rec->amplitude[i] >= 0.0);
-        if (rec->amplitude[i] >= AMPLITUDE_EPSILON) ++count;
+        hd.level_unit[i] = arena_strdup (level_unit[i]);
+    }
+
+
+    /*  Direction units.  */
+
+    hd.pub.dir_unit_types = DEFAULT_DIR_UNIT_TYPES;
+    hd.dir_unit_bits = calculate_bits (hd.pub.dir_unit_types - 1);
+
+    hd.dir_unit = (NV_CHAR **) calloc (hd.pub.dir_unit_types,
+        sizeof (NV_CHAR *));
+    for (i = 0 ; i < hd.pub.dir_unit_types ; ++i)
+    {
+        hd.dir_unit[i] = arena_strdup (dir_unit[i]);
+    }
+
+
+    /*  Restrictions.  */
+
+    hd.restriction_bits = DEFAULT_RESTRICTION_BITS;
+    hd.max_restriction_types = NINT (pow (2.0,
+        (NV_FLOAT64) hd.restriction_bits));
+    hd.pub.restriction_types = DEFAULT_RESTRICTION_TYPES;
+
+    hd.restriction = (NV_CHAR **) calloc (hd.max_restriction_types,
+        sizeof (NV_CHAR *));
+    for (i = 0 ; i < hd.max_restriction_types ; ++i)
+    {
+        if (i == hd.pub.restriction_types) break;
+
+        hd.restriction[i] = arena_strdup (restriction[i]);
+    }
+
+
+    /*  Legaleses.  */
+
+    hd.legalese_bits = DEFAULT_LEGALESE_BITS;
+    hd.max_legaleses = NINT (pow (2.0, (NV_FLOAT64) hd.legalese_bits));
+    hd.pub.legaleses = DEFAULT_LEGALESES;
+
+    hd.legalese = (NV_CHAR **) calloc (hd.max_legaleses,
+        sizeof (NV_CHAR *));
+    for (i = 0 ; i < hd.max_legaleses ; ++i)
+    {
+        if (i == hd.pub.legaleses) break;
+
+        hd.legalese[i] = arena_strdup (legalese[i]);
+    }
+
+
+    /*  Tzfiles.  */
+
+    hd.tzfile_bits = DEFAULT_TZFILE_BITS;
+    hd.max_tzfiles = NINT (pow (2.0, (NV_FLOAT64) hd.tzfile_bits));
+    hd.pub.tzfiles = DEFAULT_TZFILES;
+
+    hd.tzfile = (NV_CHAR **) calloc (hd.max_tzfiles, sizeof (NV_CHAR *));
+    for (i = 0 ; i < hd.max_tzfiles ; ++i)
+    {
+        if (i == hd.pub.tzfiles) break;
+
+        hd.tzfile[i] = arena_strdup (tzfile[i]);
+    }
+
+
+    /*  Countries.  */
+
+    hd.country_bits = DEFAULT_COUNTRY_BITS;
+    hd.max_countries = NINT (pow (2.0, (NV_FLOAT64) hd.country_bits));
+    hd.pub.countries = DEFAULT_COUNTRIES;
+
+    hd.country = (NV_CHAR **) calloc (hd.max_countries, sizeof (NV_CHAR *));
+    for (i = 0 ; i < hd.max_countries ; ++i)
+    {
+        if (i == hd.pub.countries) break;
+
+        hd.country[i] = arena_strdup (country[i]);
+    }
+
+
+    /*  Datums.  */
+
+    hd.datum_bits = DEFAULT_DATUM_BITS;
+    hd.max_datum_types = NINT (pow (2.0, (NV_FLOAT64) hd.datum_bits));
+    hd.pub.datum_types = DEFAULT_DATUM_TYPES;
+
+    hd.datum = (NV_CHAR **) calloc (hd.max_datum_types, sizeof (NV_CHAR *));
+    for (i = 0 ; i < hd.max_datum_types ; ++i)
+    {
+        if (i == hd.pub.datum_types) break;
+
+        hd.datum[i] = arena_strdup (datum[i]);
     }
 
-    rec->header.record_size +=
-        (count * hd.constituent_bits +
-        count * hd.amplitude_bits +
-        count * hd.epoch_bits);
 
-    break;
+    /*  Write the header to the file and close. */
+
+    modified = NVTrue;
+    close_db (NVTrue);
+
+
+    /*  Re-open it and read the header from the file.  */
+
+    i = (open_tide_db (file));
+
+
+    /*  Set the correct end of file position since the one in the header is
+        set to 0.  */
+    hd.end_of_file = tell_db ();
+    /* DWF 2004-08-15: if the original program exits without adding any
+       records, that doesn't help!  Rewrite the header with correct
+       end_of_file. */
+    write_tide_db_header ();
+
+    return (i);
+}
+
+NV_BOOL create_tide_db (const NV_CHAR *file, NV_U_INT32 constituents, NV_CHAR
+const * const constituent[], const NV_FLOAT64 *speed, NV_INT32 start_year,
+NV_U_INT32 num_years, NV_FLOAT32 const * const equilibrium[], NV_FLOAT32
+const * const node_factor[])
+{
+    return create_db (file, constituents, constituent, speed, start_year,
+        num_years, equilibrium, node_factor, NVFalse);
+}
+
+
+/*****************************************************************************\
+
+    Function        create_large_tide_db - creates a tide database in the
+                    large format
+
+    Synopsis        Same as create_tide_db.
+
+    Returns         NV_BOOL                 NVTrue if file created
+
+    The file gets major revision LIBTCD_LARGE_MAJOR_REV, 64-bit record
+    offsets, DEFAULT_LARGE_STATION_BITS station fields, and
+    DEFAULT_LARGE_RECORD_SIZE_BITS record size fields.  The record
+    encoding is otherwise that of V2.
+
+    Date            2026-10-19
+
+\*****************************************************************************/
+
+NV_BOOL create_large_tide_db (const NV_CHAR *file, NV_U_INT32 constituents,
+NV_CHAR const * const constituent[], const NV_FLOAT64 *speed, NV_INT32
+start_year, NV_U_INT32 num_years, NV_FLOAT32 const * const equilibrium[],
+NV_FLOAT32 const * const node_factor[])
+{
+    return create_db (file, constituents, constituent, speed, start_year,
+        num_years, equilibrium, node_factor, NVTrue);
+}
+
+
+/*****************************************************************************\
+  DWF 2004-10-13
+  Used in check_tide_record.
+\*****************************************************************************/
+static NV_BOOL check_date (NV_U_INT32 date) {
+  if (date) {
+    unsigned m, d;
+    date %= 10000;
+    m = date / 100;
+    d = date % 100;
+    if (m < 1 || m > 12 || d < 1 || d > 31)
+      return NVFalse;
+  }
+  return NVTrue;
+}
+
+
+/*****************************************************************************\
+  DWF 2004-10-13
+  Returns true iff a record is valid enough to write.  Reports all problems
+  to stderr.  The checks are not designed to be airtight (e.g., if you
+  use 360 degrees instead of 0 we'll let it slide).
+
+  Mild side effects may occur:
+  Note that the units-to-level-units COMPAT114 trick is wedged in here.
+\*****************************************************************************/
+static NV_BOOL check_tide_record (TIDE_RECORD *rec) {
+  NV_U_INT32 i;
+  NV_BOOL ret = NVTrue;
+
+  if (!rec) {
+    fprintf (stderr, "libtcd error: null pointer passed to check_tide_record\n");
+    return NVFalse;
+  }
+
+  /* These are all static fields--if a buffer overflow has occurred on one
+     of these, other fields might be invalid, but the problem started here. */
+  boundscheck_oneliner (rec->header.name);
+  boundscheck_oneliner (rec->source);
+  boundscheck_monologue (rec->comments);
+  boundscheck_monologue (rec->notes);
+  boundscheck_oneliner (rec->station_id_context);
+  boundscheck_oneliner (rec->station_id);
+  boundscheck_monologue (rec->xfields);
+
+#ifdef COMPAT114
+  if (rec->header.record_type == REFERENCE_STATION && rec->units > 0)
+    rec->level_units = rec->units;
+#endif
+
+  if (rec->header.latitude < -90.0 || rec->header.latitude > 90.0 ||
+      rec->header.longitude < -180.0 || rec->header.longitude > 180.0) {
+    fprintf (stderr, "libtcd error: bad coordinates in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (rec->header.tzfile < 0 || rec->header.tzfile >= (NV_INT32)hd.pub.tzfiles) {
+    fprintf (stderr, "libtcd error: bad tzfile in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (rec->header.name[0] == '\0') {
+    fprintf (stderr, "libtcd error: null name in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (rec->country < 0 || rec->country >= (NV_INT32)hd.pub.countries) {
+    fprintf (stderr, "libtcd error: bad country in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (rec->restriction >= hd.pub.restriction_types) {
+    fprintf (stderr, "libtcd error: bad restriction in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (rec->legalese >= hd.pub.legaleses) {
+    fprintf (stderr, "libtcd error: bad legalese in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (!check_date (rec->date_imported)) {
+    fprintf (stderr, "libtcd error: bad date_imported in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (rec->direction_units >= hd.pub.dir_unit_types) {
+    fprintf (stderr, "libtcd error: bad direction_units in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (rec->min_direction < 0 || rec->min_direction > 361) {
+    fprintf (stderr, "libtcd error: min_direction out of range in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (rec->max_direction < 0 || rec->max_direction > 361) {
+    fprintf (stderr, "libtcd error: max_direction out of range in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (rec->level_units >= hd.pub.level_unit_types) {
+    fprintf (stderr, "libtcd error: bad units in tide record\n");
+    ret = NVFalse;
+  }
+
+  switch (rec->header.record_type) {
+  case REFERENCE_STATION:
+    if (rec->header.reference_station != -1) {
+      fprintf (stderr, "libtcd error: type 1 record, reference_station != -1\n");
+      ret = NVFalse;
+    }
+
+    if (rec->datum_offset < -13421.7728 || rec->datum_offset > 13421.7727) {
+      fprintf (stderr, "libtcd error: datum_offset out of range in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->datum < 0 || rec->datum >= (NV_INT32)hd.pub.datum_types) {
+      fprintf (stderr, "libtcd error: bad datum in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->zone_offset < -4096 || rec->zone_offset > 4095 ||
+        rec->zone_offset % 100 >= 60) {
+      fprintf (stderr, "libtcd error: bad zone_offset in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (!check_date (rec->expiration_date)) {
+      fprintf (stderr, "libtcd error: bad expiration_date in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->months_on_station > 1023) {
+      fprintf (stderr, "libtcd error: months_on_station out of range in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (!check_date (rec->last_date_on_station)) {
+      fprintf (stderr, "libtcd error: bad last_date_on_station in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->confidence > 15) {
+      fprintf (stderr, "libtcd error: confidence out of range in tide record\n");
+      ret = NVFalse;
+    }
+
+    /* Only issue each error once. */
+    for (i=0; i < hd.pub.constituents; ++i) {
+      if (rec->amplitude[i] < 0.0 || rec->amplitude[i] > 52.4287) {
+        fprintf (stderr, "libtcd error: constituent amplitude out of range in tide record\n");
+        ret = NVFalse;
+        break;
+      }
+    }
+    for (i=0; i < hd.pub.constituents; ++i) {
+      if (rec->epoch[i] < 0.0 || rec->epoch[i] > 360.0) {
+        fprintf (stderr, "libtcd error: constituent epoch out of range in tide record\n");
+        ret = NVFalse;
+        break;
+      }
+    }
+
+    break;
+
+  case SUBORDINATE_STATION:
+    if (rec->header.reference_station < 0 || rec->header.reference_station
+    >= (NV_INT32)hd.pub.number_of_records) {
+      fprintf (stderr, "libtcd error: bad reference_station in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->min_time_add < -4096 || rec->min_time_add > 4095 ||
+        rec->min_time_add % 100 >= 60) {
+      fprintf (stderr, "libtcd error: bad min_time_add in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->min_level_add < -65.536 || rec->min_level_add > 65.535) {
+      fprintf (stderr, "libtcd error: min_level_add out of range in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->min_level_multiply < 0.0 || rec->min_level_multiply > 65.535) {
+      fprintf (stderr, "libtcd error: min_level_multiply out of range in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->max_time_add < -4096 || rec->max_time_add > 4095 ||
+        rec->max_time_add % 100 >= 60) {
+      fprintf (stderr, "libtcd error: bad max_time_add in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->max_level_add < -65.536 || rec->max_level_add > 65.535) {
+      fprintf (stderr, "libtcd error: max_level_add out of range in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->max_level_multiply < 0.0 || rec->max_level_multiply > 65.535) {
+      fprintf (stderr, "libtcd error: max_level_multiply out of range in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->flood_begins != NULLSLACKOFFSET && (rec->flood_begins < -4096 ||
+    rec->flood_begins > 4095 || rec->flood_begins % 100 >= 60)) {
+      fprintf (stderr, "libtcd error: bad flood_begins in tide record\n");
+      ret = NVFalse;
+    }
+
+    if (rec->ebb_begins != NULLSLACKOFFSET && (rec->ebb_begins < -4096 ||
+    rec->ebb_begins > 4095 || rec->ebb_begins % 100 >= 60)) {
+      fprintf (stderr, "libtcd error: bad ebb_begins in tide record\n");
+      ret = NVFalse;
+    }
+
+    break;
+
+  default:
+    fprintf (stderr, "libtcd error: invalid record_type in tide record\n");
+    ret = NVFalse;
+  }
+
+  if (ret == NVFalse)
+    dump_tide_record (rec);
+  return ret;
+}
+
+
+/*****************************************************************************\
+  DWF 2004-10-13
+  Calculate size of a tide record as it would be encoded in the TCD file.
+  Size is stored in record_size field.  Return is number of constituents
+  that will be encoded.
+\*****************************************************************************/
+static NV_U_INT32 figure_size (TIDE_RECORD *rec) {
+  NV_U_INT32 i, count=0, name_size, source_size, comments_size,
+    notes_size, station_id_context_size, station_id_size, xfields_size;
+
+  assert (rec);
+
+  /*  Figure out how many bits we'll need for this record. */
+
+  name_size = strlen(clip_string(rec->header.name))+1;
+  source_size = strlen(clip_string(rec->source))+1;
+  comments_size = strlen(clip_string(rec->comments))+1;
+  notes_size = strlen(clip_string(rec->notes))+1;
+  station_id_context_size = strlen(clip_string(rec->station_id_context))+1;
+  station_id_size = strlen(clip_string(rec->station_id))+1;
+  /* No clipping on xfields -- trailing \n required by syntax */
+  xfields_size = strlen(rec->xfields)+1;
+
+  rec->header.record_size =
+      hd.record_size_bits +
+      hd.record_type_bits +
+      hd.latitude_bits +
+      hd.longitude_bits +
+      hd.station_bits +
+      hd.tzfile_bits +
+      (name_size * 8) +
+
+      hd.country_bits +
+      (source_size  * 8) +
+      hd.restriction_bits +
+      (comments_size * 8) +
+      (notes_size * 8) +
+      hd.legalese_bits +
+      (station_id_context_size * 8) +
+      (station_id_size * 8) +
+      hd.date_bits + 
+      (xfields_size * 8) +
+      hd.dir_unit_bits +
+      hd.direction_bits +
+      hd.direction_bits +
+      hd.level_unit_bits;
+
+  switch (rec->header.record_type) {
+  case REFERENCE_STATION:
+    rec->header.record_size +=
+        hd.datum_offset_bits +
+        hd.datum_bits +
+        hd.time_bits +
+        hd.date_bits +
+        hd.months_on_station_bits +
+        hd.date_bits +
+        hd.confidence_value_bits +
+        hd.constituent_bits;
+
+    for (i = 0 ; i < hd.pub.constituents ; ++i)
+    {
+        assert (rec->amplitude[i] >= 0.0);
+        if (rec->amplitude[i] >= AMPLITUDE_EPSILON) ++count;
+    }
+
+    rec->header.record_size +=
+        (count * hd.constituent_bits +
+        count * hd.amplitude_bits +
+        count * hd.epoch_bits);
+
+    break;
+
+  case SUBORDINATE_STATION:
+    rec->header.record_size +=
+        hd.time_bits +
+        hd.level_add_bits +
+        hd.level_multiply_bits +
+        hd.time_bits +
+        hd.level_add_bits +
+        hd.level_multiply_bits +
+        hd.time_bits +
+        hd.time_bits;
+    break;
+
+  default:
+    assert (0);
+  }
+
+  rec->header.record_size = bits2bytes (rec->header.record_size);
+  return count;
+}
+
+
+/*****************************************************************************\
+  2026-10-19
+  Returns true iff rec, already sized by figure_size, fits the field widths
+  of the open database, and growing the file by grow bytes keeps it within
+  what the format can address.  V2 files stop short of 2 GB so that the
+  32-bit offsets of older readers still work.
+\*****************************************************************************/
+static NV_BOOL check_format_limits (const TIDE_RECORD *rec, NV_INT64 grow) {
+  NV_BOOL ret = NVTrue;
+
+  if (rec->header.reference_station >=
+      ((NV_INT32) 1 << (hd.station_bits - 1))) {
+    fprintf (stderr, "libtcd error: reference_station %d does not fit in %u station bits\n", rec->header.reference_station, hd.station_bits);
+    ret = NVFalse;
+  }
+
+  if (hd.record_size_bits < 32 &&
+      rec->header.record_size >= ((NV_U_INT32) 1 << hd.record_size_bits)) {
+    fprintf (stderr, "libtcd error: record size %u does not fit in %u record size bits\n", rec->header.record_size, hd.record_size_bits);
+    ret = NVFalse;
+  }
+
+  if (hd.pub.major_rev < LIBTCD_LARGE_MAJOR_REV &&
+      (NV_INT64) hd.end_of_file + grow > NV_INT32_MAX) {
+    fprintf (stderr, "libtcd error: TCD file would exceed 2 GB\n");
+    ret = NVFalse;
+  }
+
+  if (ret == NVFalse)
+    fprintf (stderr, "Use create_large_tide_db for databases of this size.\n");
+  return ret;
+}
+
+
+/*****************************************************************************\
+DWF 2004-10-14
+\*****************************************************************************/
+static void pack_string (NV_U_BYTE *buf, NV_U_INT32 *pos, NV_CHAR *s) {
+  NV_U_INT32 i, temp_size;
+  assert (buf);
+  assert (pos);
+  assert (s);
+  temp_size = strlen(s)+1;
+  for (i=0; i<temp_size; ++i) {
+    bit_pack (buf, *pos, 8, s[i]);
+    *pos += 8;
+  }
+}
+
+
+/*****************************************************************************\
+
+    Function        pack_tide_record - convert TIDE_RECORD to packed form
+
+    Synopsis        pack_tide_record (rec, bufptr, bufsize);
+
+                    TIDE_RECORD *rec        tide record (in)
+                    NV_U_BYTE **bufptr      packed record (out)
+                    NV_U_INT32 *bufsize     size of buf in bytes (out)
+
+                    buf is allocated by pack_tide_record and should be
+                    freed by the caller.
+
+    Returns         void
+
+    Author          Extracted from write_tide_record by David Flater
+    Date            2006-05-26
+
+\*****************************************************************************/
+
+static void pack_tide_record (TIDE_RECORD *rec, NV_U_BYTE **bufptr,
+NV_U_INT32 *bufsize) {
+  NV_U_INT32              i, pos, constituent_count;
+  NV_INT32                temp_int;
+  NV_U_BYTE               *buf;
+
+  /* Validate input */
+  assert (rec);
+  /* Cursory check for buffer overflows.  Should not happen here --
+     check_tide_record does a more thorough job when called by add_tide_record
+     and update_tide_record. */
+  boundscheck_oneliner (rec->header.name);
+  boundscheck_oneliner (rec->source);
+  boundscheck_monologue (rec->comments);
+  boundscheck_monologue (rec->notes);
+  boundscheck_oneliner (rec->station_id_context);
+  boundscheck_oneliner (rec->station_id);
+  boundscheck_monologue (rec->xfields);
+
+  constituent_count = figure_size (rec);
+
+  if (!(*bufptr = (NV_U_BYTE *) calloc (rec->header.record_size,
+				    sizeof (NV_U_BYTE)))) {
+    perror ("libtcd can't allocate memory in pack_tide_record");
+    exit (-1);
+  }
+  buf = *bufptr; /* To conserve asterisks */
+
+  /*  Bit pack the common section.  "pos" is the bit position within the
+      buffer "buf".  */
+
+  pos = 0;
+
+  bit_pack (buf, pos, hd.record_size_bits, rec->header.record_size);
+  pos += hd.record_size_bits;
+
+  bit_pack (buf, pos, hd.record_type_bits, rec->header.record_type);
+  pos += hd.record_type_bits;
+
+  temp_int = NINT (rec->header.latitude * hd.latitude_scale);
+  bit_pack (buf, pos, hd.latitude_bits, temp_int);
+  pos += hd.latitude_bits;
+
+  temp_int = NINT (rec->header.longitude * hd.longitude_scale);
+  bit_pack (buf, pos, hd.longitude_bits, temp_int);
+  pos += hd.longitude_bits;
+
+  /* This ordering doesn't match everywhere else but there's no technical
+     reason to change it from its V1 ordering.  To do so would force
+     another conditional in unpack_partial_tide_record. */
+
+  bit_pack (buf, pos, hd.tzfile_bits, rec->header.tzfile);
+  pos += hd.tzfile_bits;
+
+  pack_string (buf, &pos, clip_string(rec->header.name));
+
+  bit_pack (buf, pos, hd.station_bits, rec->header.reference_station);
+  pos += hd.station_bits;
+
+  bit_pack (buf, pos, hd.country_bits, rec->country);
+  pos += hd.country_bits;
+
+  pack_string (buf, &pos, clip_string(rec->source));
+
+  bit_pack (buf, pos, hd.restriction_bits, rec->restriction);
+  pos += hd.restriction_bits;
+
+  pack_string (buf, &pos, clip_string(rec->comments));
+  pack_string (buf, &pos, clip_string(rec->notes));
+
+  bit_pack (buf, pos, hd.legalese_bits, rec->legalese);
+  pos += hd.legalese_bits;
+
+  pack_string (buf, &pos, clip_string(rec->station_id_context));
+  pack_string (buf, &pos, clip_string(rec->station_id));
+
+  bit_pack (buf, pos, hd.date_bits, rec->date_imported);
+  pos += hd.date_bits;
+
+  /* No clipping on xfields -- trailing \n required by syntax */
+  pack_string (buf, &pos, rec->xfields);
+
+  bit_pack (buf, pos, hd.dir_unit_bits, rec->direction_units);
+  pos += hd.dir_unit_bits;
+
+  bit_pack (buf, pos, hd.direction_bits, rec->min_direction);
+  pos += hd.direction_bits;
+
+  bit_pack (buf, pos, hd.direction_bits, rec->max_direction);
+  pos += hd.direction_bits;
+
+  /* The units-to-level-units compatibility hack is in check_tide_record */
+  bit_pack (buf, pos, hd.level_unit_bits, rec->level_units);
+  pos += hd.level_unit_bits;
+
+  /*  Bit pack record type 1 records.  */
+
+  if (rec->header.record_type == REFERENCE_STATION) {
+      temp_int = NINT (rec->datum_offset * hd.datum_offset_scale);
+      bit_pack (buf, pos, hd.datum_offset_bits, temp_int);
+      pos += hd.datum_offset_bits;
+
+      bit_pack (buf, pos, hd.datum_bits, rec->datum);
+      pos += hd.datum_bits;
+
+      bit_pack (buf, pos, hd.time_bits, rec->zone_offset);
+      pos += hd.time_bits;
+
+      bit_pack (buf, pos, hd.date_bits, rec->expiration_date);
+      pos += hd.date_bits;
+
+      bit_pack (buf, pos, hd.months_on_station_bits,
+	  rec->months_on_station);
+      pos += hd.months_on_station_bits;
+
+      bit_pack (buf, pos, hd.date_bits, rec->last_date_on_station);
+      pos += hd.date_bits;
+
+      bit_pack (buf, pos, hd.confidence_value_bits, rec->confidence);
+      pos += hd.confidence_value_bits;
+
+      bit_pack (buf, pos, hd.constituent_bits, constituent_count);
+      pos += hd.constituent_bits;
+
+      for (i = 0 ; i < hd.pub.constituents ; ++i)
+      {
+	  if (rec->amplitude[i] >= AMPLITUDE_EPSILON)
+	  {
+	      bit_pack (buf, pos, hd.constituent_bits, i);
+	      pos += hd.constituent_bits;
+
+	      temp_int = NINT (rec->amplitude[i] * hd.amplitude_scale);
+	      assert (temp_int);
+	      bit_pack (buf, pos, hd.amplitude_bits, temp_int);
+	      pos += hd.amplitude_bits;
+
+	      temp_int = NINT (rec->epoch[i] * hd.epoch_scale);
+	      bit_pack (buf, pos, hd.epoch_bits, temp_int);
+	      pos += hd.epoch_bits;
+	  }
+      }
+  }
+
+  /*  Bit pack record type 2 records.  */
+  else if (rec->header.record_type == SUBORDINATE_STATION) {
+      bit_pack (buf, pos, hd.time_bits, rec->min_time_add);
+      pos += hd.time_bits;
+
+      temp_int = NINT (rec->min_level_add * hd.level_add_scale);
+      bit_pack (buf, pos, hd.level_add_bits, temp_int);
+      pos += hd.level_add_bits;
+
+      temp_int = NINT (rec->min_level_multiply * hd.level_multiply_scale);
+      bit_pack (buf, pos, hd.level_multiply_bits, temp_int);
+      pos += hd.level_multiply_bits;
+
+      bit_pack (buf, pos, hd.time_bits, rec->max_time_add);
+      pos += hd.time_bits;
+
+      temp_int = NINT (rec->max_level_add * hd.level_add_scale);
+      bit_pack (buf, pos, hd.level_add_bits, temp_int);
+      pos += hd.level_add_bits;
+
+      temp_int = NINT (rec->max_level_multiply * hd.level_multiply_scale);
+      bit_pack (buf, pos, hd.level_multiply_bits, temp_int);
+      pos += hd.level_multiply_bits;
+
+      bit_pack (buf, pos, hd.time_bits, rec->flood_begins);
+      pos += hd.time_bits;
+
+      bit_pack (buf, pos, hd.time_bits, rec->ebb_begins);
+      pos += hd.time_bits;
+  }
+
+  else {
+    fprintf (stderr, "libtcd error:  Record type %d is undefined\n",
+	     rec->header.record_type);
+    exit (-1);
+  }
+
+  *bufsize = rec->header.record_size;
+  assert (*bufsize == bits2bytes (pos));
+}
+
+
+/*****************************************************************************\
+
+    Function        write_tide_record - writes a tide record to the database
+
+    Synopsis        write_tide_record (num, rec);
+
+                    NV_INT32 num            record number:
+                                            >= 0 overwrite record num
+                                              -1 write at current file position
+                    TIDE_RECORD *rec        tide record
+
+    Returns         NV_BOOL                 NVTrue if successful
+
+    Author          Jan C. Depner
+    Date            08/01/02
+
+    See libtcd.html for changelog.
+
+    hd.end_of_file is not updated by this function in any event.
+
+\*****************************************************************************/
+
+static NV_BOOL write_tide_record (NV_INT32 num, TIDE_RECORD *rec)
+{
+    NV_U_BYTE               *buf = NULL;
+    NV_U_INT32              bufsize = 0;
+
+    if (!fp) {
+      fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+      return NVFalse;
+    }
+    write_protect();
+
+    pack_tide_record (rec, &buf, &bufsize);
+
+    if (num == -1)
+      ;
+    else if (num >= 0)
+      seek_db (tindex[num].address, SEEK_SET);
+    else
+      assert (0);
+
+    chk_fwrite (buf, bufsize, 1, fp);
+    free (buf);
+    modified = NVTrue;
+    return NVTrue;
+}
+
+
+/*****************************************************************************\
+
+    Function        read_next_tide_record - reads the next tide record from
+                    the database
+
+    Synopsis        read_next_tide_record (rec);
+
+                    TIDE_RECORD *rec        tide record
 
-  case SUBORDINATE_STATION:
-    rec->header.record_size +=
-        hd.time_bits +
-        hd.level_add_bits +
-        hd.level_multiply_bits +
-        hd.time_bits +
-        hd.level_add_bits +
-        hd.level_multiply_bits +
-        hd.time_bits +
-        hd.time_bits;
-    break;
+    Returns         NV_INT32                record number of the tide record
 
-  default:
-    assert (0);
-  }
+    Author          Jan C. Depner
+    Date            08/01/02
 
-  rec->header.record_size = bits2bytes (rec->header.record_size);
-  return count;
+    See libtcd.html for changelog.
+
+\*****************************************************************************/
+
+NV_INT32 read_next_tide_record (TIDE_RECORD *rec)
+{
+  return (read_tide_record (current_record + 1, rec));
 }
 
 
 /*****************************************************************************\
-DWF 2004-10-14
+
+    Function        init_tide_record - sets every field that unpacking
+                    might not write to its default
+
+    Synopsis        init_tide_record (rec);
+
+                    TIDE_RECORD *rec        tide record (out)
+
+    Returns         void
+
+    Date            2026-10-19
+
+    This replaces a memset of the whole 33 KB record.  The character
+    arrays are only terminated, and the amplitudes and epochs are only
+    cleared for the constituents that the database has; everything past
+    those is left as the caller had it.
+
 \*****************************************************************************/
-static void pack_string (NV_U_BYTE *buf, NV_U_INT32 *pos, NV_CHAR *s) {
-  NV_U_INT32 i, temp_size;
-  assert (buf);
-  assert (pos);
-  assert (s);
-  temp_size = strlen(s)+1;
-  for (i=0; i<temp_size; ++i) {
-    bit_pack (buf, *pos, 8, s[i]);
-    *pos += 8;
-  }
+
+static void init_tide_record (TIDE_RECORD *rec)
+{
+  assert (rec);
+
+  rec->country = 0;
+  rec->source[0] = '\0';
+  rec->restriction = 0;
+  rec->comments[0] = '\0';
+  rec->notes[0] = '\0';
+  rec->legalese = 0;
+  rec->station_id_context[0] = '\0';
+  rec->station_id[0] = '\0';
+  rec->date_imported = 0;
+  rec->xfields[0] = '\0';
+  rec->direction_units = degrees_true;
+  rec->min_direction = rec->max_direction = 361;
+  rec->level_units = 0;
+
+  rec->datum_offset = 0.0;
+  rec->datum = 0;
+  rec->zone_offset = 0;
+  rec->expiration_date = 0;
+  rec->months_on_station = 0;
+  rec->last_date_on_station = 0;
+  rec->confidence = 0;
+  memset (rec->amplitude, 0, hd.pub.constituents * sizeof (NV_FLOAT32));
+  memset (rec->epoch, 0, hd.pub.constituents * sizeof (NV_FLOAT32));
+
+  rec->min_time_add = rec->max_time_add = 0;
+  rec->min_level_add = rec->max_level_add = 0.0;
+  rec->min_level_multiply = rec->max_level_multiply = 0.0;
+  rec->flood_begins = rec->ebb_begins = NULLSLACKOFFSET;
+
+#ifdef COMPAT114
+  rec->pedigree = 0;
+  rec->units = 0;
+  rec->avg_level_units = 0;
+  rec->min_avg_level = rec->max_avg_level = 0.0;
+#endif
 }
 
 
 /*****************************************************************************\
 
-    Function        pack_tide_record - convert TIDE_RECORD to packed form
+    Function        unpack_tide_record - convert TIDE_RECORD from packed form
 
-    Synopsis        pack_tide_record (rec, bufptr, bufsize);
+    Synopsis        unpack_tide_record (buf, bufsize, rec, num, fields);
 
-                    TIDE_RECORD *rec        tide record (in)
-                    NV_U_BYTE **bufptr      packed record (out)
-                    NV_U_INT32 *bufsize     size of buf in bytes (out)
+                    NV_U_BYTE *buf          packed record (in)
+                    NV_U_INT32 bufsize      size of buf in bytes (in)
+                    TIDE_RECORD *rec        tide record (in-out)
+                    NV_INT32 num            record number (in)
+                    NV_U_INT32 fields       TIDE_FIELDS_* mask (in)
 
-                    buf is allocated by pack_tide_record and should be
-                    freed by the caller.
+                    rec must be allocated by the caller.
 
     Returns         void
 
-    Author          Extracted from write_tide_record by David Flater
+    Author          Extracted from read_tide_record by David Flater
     Date            2006-05-26
 
+    rec->header.record_number is initialized from num.  Text fields not
+    selected by fields are left empty and constituents not selected are
+    left zero.  Nothing here touches the global cursor, so this may be
+    called from the iterate_tide_records worker threads.
+
 \*****************************************************************************/
 
-static void pack_tide_record (TIDE_RECORD *rec, NV_U_BYTE **bufptr,
-NV_U_INT32 *bufsize) {
-  NV_U_INT32              i, pos, constituent_count;
+static void unpack_tide_record (NV_U_BYTE *buf, NV_U_INT32 bufsize,
+TIDE_RECORD *rec, NV_INT32 num, NV_U_INT32 fields) {
   NV_INT32                temp_int;
-  NV_U_BYTE               *buf;
+  NV_U_INT32              i, j, pos, count;
+  NV_BOOL                 text = (fields & TIDE_FIELDS_TEXT) != 0;
 
-  /* Validate input */
   assert (rec);
-  /* Cursory check for buffer overflows.  Should not happen here --
-     check_tide_record does a more thorough job when called by add_tide_record
-     and update_tide_record. */
-  boundscheck_oneliner (rec->header.name);
-  boundscheck_oneliner (rec->source);
-  boundscheck_monologue (rec->comments);
-  boundscheck_monologue (rec->notes);
-  boundscheck_oneliner (rec->station_id_context);
-  boundscheck_oneliner (rec->station_id);
-  boundscheck_monologue (rec->xfields);
 
-  constituent_count = figure_size (rec);
+  init_tide_record (rec);
+  rec->header.record_number = num;
 
-  if (!(*bufptr = (NV_U_BYTE *) calloc (rec->header.record_size,
-				    sizeof (NV_U_BYTE)))) {
-    perror ("libtcd can't allocate memory in pack_tide_record");
+  unpack_partial_tide_record (buf, bufsize, rec, &pos);
+
+  switch (rec->header.record_type) {
+  case REFERENCE_STATION:
+  case SUBORDINATE_STATION:
+    break;
+  default:
+    fprintf (stderr, "libtcd fatal error: tried to read type %d tide record.\n", rec->header.record_type);
+    fprintf (stderr, "This version of libtcd only supports types 1 and 2.  Perhaps you should\nupgrade.\n");
     exit (-1);
   }
-  buf = *bufptr; /* To conserve asterisks */
 
-  /*  Bit pack the common section.  "pos" is the bit position within the
-      buffer "buf".  */
+  switch (hd.pub.major_rev) {
 
-  pos = 0;
+    /************************* TCD V1 *****************************/
+  case 0:
+  case 1:
 
-  bit_pack (buf, pos, hd.record_size_bits, rec->header.record_size);
-  pos += hd.record_size_bits;
+    /*  "pos" is the bit position within the buffer "buf".  */
 
-  bit_pack (buf, pos, hd.record_type_bits, rec->header.record_type);
-  pos += hd.record_type_bits;
+    rec->country = bit_unpack (buf, pos, hd.country_bits);
+    pos += hd.country_bits;
 
-  temp_int = NINT (rec->header.latitude * hd.latitude_scale);
-  bit_pack (buf, pos, hd.latitude_bits, temp_int);
-  pos += hd.latitude_bits;
+    /* pedigree */
+    pos += hd.pedigree_bits;
 
-  temp_int = NINT (rec->header.longitude * hd.longitude_scale);
-  bit_pack (buf, pos, hd.longitude_bits, temp_int);
-  pos += hd.longitude_bits;
+    unpack_string (buf, bufsize, &pos, text ? rec->source : NULL, ONELINER_LENGTH, "source field");
 
-  /* This ordering doesn't match everywhere else but there's no technical
-     reason to change it from its V1 ordering.  To do so would force
-     another conditional in unpack_partial_tide_record. */
+    rec->restriction = bit_unpack (buf, pos, hd.restriction_bits);
+    pos += hd.restriction_bits;
 
-  bit_pack (buf, pos, hd.tzfile_bits, rec->header.tzfile);
-  pos += hd.tzfile_bits;
+    unpack_string (buf, bufsize, &pos, text ? rec->comments : NULL, MONOLOGUE_LENGTH, "comments field");
 
-  pack_string (buf, &pos, clip_string(rec->header.name));
+    if (rec->header.record_type == REFERENCE_STATION) {
+      rec->level_units = bit_unpack (buf, pos, hd.level_unit_bits);
+#ifdef COMPAT114
+      rec->units = rec->level_units;
+#endif
+      pos += hd.level_unit_bits;
 
-  bit_pack (buf, pos, hd.station_bits, rec->header.reference_station);
-  pos += hd.station_bits;
+      temp_int = signed_bit_unpack (buf, pos, hd.datum_offset_bits);
+      rec->datum_offset = (NV_FLOAT32) temp_int / hd.datum_offset_scale;
+      pos += hd.datum_offset_bits;
 
-  bit_pack (buf, pos, hd.country_bits, rec->country);
-  pos += hd.country_bits;
+      rec->datum = bit_unpack (buf, pos, hd.datum_bits);
+      pos += hd.datum_bits;
 
-  pack_string (buf, &pos, clip_string(rec->source));
+      rec->zone_offset = signed_bit_unpack (buf, pos, hd.time_bits);
+      pos += hd.time_bits;
 
-  bit_pack (buf, pos, hd.restriction_bits, rec->restriction);
-  pos += hd.restriction_bits;
+      rec->expiration_date = bit_unpack (buf, pos, hd.date_bits);
+      pos += hd.date_bits;
 
-  pack_string (buf, &pos, clip_string(rec->comments));
-  pack_string (buf, &pos, clip_string(rec->notes));
+      rec->months_on_station = bit_unpack (buf, pos,
+          hd.months_on_station_bits);
+      pos += hd.months_on_station_bits;
 
-  bit_pack (buf, pos, hd.legalese_bits, rec->legalese);
-  pos += hd.legalese_bits;
+      rec->last_date_on_station = bit_unpack (buf, pos, hd.date_bits);
+      pos += hd.date_bits;
 
-  pack_string (buf, &pos, clip_string(rec->station_id_context));
-  pack_string (buf, &pos, clip_string(rec->station_id));
+      rec->confidence = bit_unpack (buf, pos, hd.confidence_value_bits);
+      pos += hd.confidence_value_bits;
+
+      count = bit_unpack (buf, pos, hd.constituent_bits);
+      pos += hd.constituent_bits;
+
+      for (i = 0 ; i < count ; ++i) {
+        j = bit_unpack (buf, pos, hd.constituent_bits);
+        pos += hd.constituent_bits;
+
+        rec->amplitude[j] = (NV_FLOAT32) bit_unpack (buf, pos,
+            hd.amplitude_bits) / hd.amplitude_scale;
+        pos += hd.amplitude_bits;
+
+        rec->epoch[j] = (NV_FLOAT32) bit_unpack (buf, pos, hd.epoch_bits) /
+            hd.epoch_scale;
+        pos += hd.epoch_bits;
+      }
+    } else if (rec->header.record_type == SUBORDINATE_STATION) {
+      rec->level_units = bit_unpack (buf, pos, hd.level_unit_bits);
+      pos += hd.level_unit_bits;
+
+      rec->direction_units = bit_unpack (buf, pos, hd.dir_unit_bits);
+      pos += hd.dir_unit_bits;
+
+      /* avg_level_units */
+      pos += hd.level_unit_bits;
+
+      rec->min_time_add = signed_bit_unpack (buf, pos, hd.time_bits);
+      pos += hd.time_bits;
+
+      temp_int = signed_bit_unpack (buf, pos, hd.level_add_bits);
+      rec->min_level_add = (NV_FLOAT32) temp_int / hd.level_add_scale;
+      pos += hd.level_add_bits;
+
+      /* Signed in V1 */
+      temp_int = signed_bit_unpack (buf, pos, hd.level_multiply_bits);
+      rec->min_level_multiply = (NV_FLOAT32) temp_int /
+          hd.level_multiply_scale;
+      pos += hd.level_multiply_bits;
+
+      /* min_avg_level */
+      pos += hd.level_add_bits;
+
+      rec->min_direction = bit_unpack (buf, pos, hd.direction_bits);
+      pos += hd.direction_bits;
+
+      rec->max_time_add = signed_bit_unpack (buf, pos, hd.time_bits);
+      pos += hd.time_bits;
+
+      temp_int = signed_bit_unpack (buf, pos, hd.level_add_bits);
+      rec->max_level_add = (NV_FLOAT32) temp_int / hd.level_add_scale;
+      pos += hd.level_add_bits;
+
+      /* Signed in V1 */
+      temp_int = signed_bit_unpack (buf, pos, hd.level_multiply_bits);
+      rec->max_level_multiply = (NV_FLOAT32) temp_int /
+          hd.level_multiply_scale;
+      pos += hd.level_multiply_bits;
+
+      /* max_avg_level */
+      pos += hd.level_add_bits;
+
+      rec->max_direction = bit_unpack (buf, pos, hd.direction_bits);
+      pos += hd.direction_bits;
+
+      rec->flood_begins = signed_bit_unpack (buf, pos, hd.time_bits);
+      pos += hd.time_bits;
+
+      rec->ebb_begins = signed_bit_unpack (buf, pos, hd.time_bits);
+      pos += hd.time_bits;
+    } else {
+      assert (0);
+    }
+    break;
+
+    /********************* TCD V2 and large V3 *********************/
+    /* V3 differs only in header widths, which unpack_partial_tide_record
+       takes from hd. */
+  case 2:
+  case 3:
+    rec->country = bit_unpack (buf, pos, hd.country_bits);
+    pos += hd.country_bits;
+
+    unpack_string (buf, bufsize, &pos, text ? rec->source : NULL, ONELINER_LENGTH, "source field");
+
+    rec->restriction = bit_unpack (buf, pos, hd.restriction_bits);
+    pos += hd.restriction_bits;
+
+    unpack_string (buf, bufsize, &pos, text ? rec->comments : NULL, MONOLOGUE_LENGTH, "comments field");
+    unpack_string (buf, bufsize, &pos, text ? rec->notes : NULL, MONOLOGUE_LENGTH, "notes field");
 
-  bit_pack (buf, pos, hd.date_bits, rec->date_imported);
-  pos += hd.date_bits;
+    rec->legalese = bit_unpack (buf, pos, hd.legalese_bits);
+    pos += hd.legalese_bits;
 
-  /* No clipping on xfields -- trailing \n required by syntax */
-  pack_string (buf, &pos, rec->xfields);
+    unpack_string (buf, bufsize, &pos, text ? rec->station_id_context : NULL, ONELINER_LENGTH, "station_id_context field");
+    unpack_string (buf, bufsize, &pos, text ? rec->station_id : NULL, ONELINER_LENGTH, "station_id field");
 
-  bit_pack (buf, pos, hd.dir_unit_bits, rec->direction_units);
-  pos += hd.dir_unit_bits;
+    rec->date_imported = bit_unpack (buf, pos, hd.date_bits);
+    pos += hd.date_bits;
 
-  bit_pack (buf, pos, hd.direction_bits, rec->min_direction);
-  pos += hd.direction_bits;
+    unpack_string (buf, bufsize, &pos, text ? rec->xfields : NULL, MONOLOGUE_LENGTH, "xfields field");
 
-  bit_pack (buf, pos, hd.direction_bits, rec->max_direction);
-  pos += hd.direction_bits;
+    rec->direction_units = bit_unpack (buf, pos, hd.dir_unit_bits);
+    pos += hd.dir_unit_bits;
 
-  /* The units-to-level-units compatibility hack is in check_tide_record */
-  bit_pack (buf, pos, hd.level_unit_bits, rec->level_units);
-  pos += hd.level_unit_bits;
+    rec->min_direction = bit_unpack (buf, pos, hd.direction_bits);
+    pos += hd.direction_bits;
 
-  /*  Bit pack record type 1 records.  */
+    rec->max_direction = bit_unpack (buf, pos, hd.direction_bits);
+    pos += hd.direction_bits;
 
-  if (rec->header.record_type == REFERENCE_STATION) {
-      temp_int = NINT (rec->datum_offset * hd.datum_offset_scale);
-      bit_pack (buf, pos, hd.datum_offset_bits, temp_int);
+    rec->level_units = bit_unpack (buf, pos, hd.level_unit_bits);
+#ifdef COMPAT114
+    rec->units = rec->level_units;
+#endif
+    pos += hd.level_unit_bits;
+
+    if (rec->header.record_type == REFERENCE_STATION) {
+      temp_int = signed_bit_unpack (buf, pos, hd.datum_offset_bits);
+      rec->datum_offset = (NV_FLOAT32) temp_int / hd.datum_offset_scale;
       pos += hd.datum_offset_bits;
 
-      bit_pack (buf, pos, hd.datum_bits, rec->datum);
+      rec->datum = bit_unpack (buf, pos, hd.datum_bits);
       pos += hd.datum_bits;
 
-      bit_pack (buf, pos, hd.time_bits, rec->zone_offset);
+      rec->zone_offset = signed_bit_unpack (buf, pos, hd.time_bits);
       pos += hd.time_bits;
 
-      bit_pack (buf, pos, hd.date_bits, rec->expiration_date);
+      rec->expiration_date = bit_unpack (buf, pos, hd.date_bits);
       pos += hd.date_bits;
 
-      bit_pack (buf, pos, hd.months_on_station_bits,
-	  rec->months_on_station);
+      rec->months_on_station = bit_unpack (buf, pos,
+          hd.months_on_station_bits);
       pos += hd.months_on_station_bits;
 
-      bit_pack (buf, pos, hd.date_bits, rec->last_date_on_station);
+      rec->last_date_on_station = bit_unpack (buf, pos, hd.date_bits);
       pos += hd.date_bits;
 
-      bit_pack (buf, pos, hd.confidence_value_bits, rec->confidence);
+      rec->confidence = bit_unpack (buf, pos, hd.confidence_value_bits);
       pos += hd.confidence_value_bits;
 
-      bit_pack (buf, pos, hd.constituent_bits, constituent_count);
+      /* Constituents are the last thing in a V2 type 1 record. */
+      if (!(fields & TIDE_FIELDS_CONSTITUENTS))
+        break;
+
+      count = bit_unpack (buf, pos, hd.constituent_bits);
       pos += hd.constituent_bits;
 
-      for (i = 0 ; i < hd.pub.constituents ; ++i)
-      {
-	  if (rec->amplitude[i] >= AMPLITUDE_EPSILON)
-	  {
-	      bit_pack (buf, pos, hd.constituent_bits, i);
-	      pos += hd.constituent_bits;
+      for (i = 0 ; i < count ; ++i) {
+        j = bit_unpack (buf, pos, hd.constituent_bits);
+        pos += hd.constituent_bits;
 
-	      temp_int = NINT (rec->amplitude[i] * hd.amplitude_scale);
-	      assert (temp_int);
-	      bit_pack (buf, pos, hd.amplitude_bits, temp_int);
-	      pos += hd.amplitude_bits;
+        rec->amplitude[j] = (NV_FLOAT32) bit_unpack (buf, pos,
+            hd.amplitude_bits) / hd.amplitude_scale;
+        pos += hd.amplitude_bits;
 
-	      temp_int = NINT (rec->epoch[i] * hd.epoch_scale);
-	      bit_pack (buf, pos, hd.epoch_bits, temp_int);
-	      pos += hd.epoch_bits;
-	  }
+        rec->epoch[j] = (NV_FLOAT32) bit_unpack (buf, pos, hd.epoch_bits) /
+            hd.epoch_scale;
+        pos += hd.epoch_bits;
       }
-  }
-
-  /*  Bit pack record type 2 records.  */
-  else if (rec->header.record_type == SUBORDINATE_STATION) {
-      bit_pack (buf, pos, hd.time_bits, rec->min_time_add);
+    } else if (rec->header.record_type == SUBORDINATE_STATION) {
+      rec->min_time_add = signed_bit_unpack (buf, pos, hd.time_bits);
       pos += hd.time_bits;
 
-      temp_int = NINT (rec->min_level_add * hd.level_add_scale);
-      bit_pack (buf, pos, hd.level_add_bits, temp_int);
+      temp_int = signed_bit_unpack (buf, pos, hd.level_add_bits);
+      rec->min_level_add = (NV_FLOAT32) temp_int / hd.level_add_scale;
       pos += hd.level_add_bits;
 
-      temp_int = NINT (rec->min_level_multiply * hd.level_multiply_scale);
-      bit_pack (buf, pos, hd.level_multiply_bits, temp_int);
+      /* Made unsigned in V2 */
+      temp_int = bit_unpack (buf, pos, hd.level_multiply_bits);
+      rec->min_level_multiply = (NV_FLOAT32) temp_int /
+          hd.level_multiply_scale;
       pos += hd.level_multiply_bits;
 
-      bit_pack (buf, pos, hd.time_bits, rec->max_time_add);
+      rec->max_time_add = signed_bit_unpack (buf, pos, hd.time_bits);
       pos += hd.time_bits;
 
-      temp_int = NINT (rec->max_level_add * hd.level_add_scale);
-      bit_pack (buf, pos, hd.level_add_bits, temp_int);
+      temp_int = signed_bit_unpack (buf, pos, hd.level_add_bits);
+      rec->max_level_add = (NV_FLOAT32) temp_int / hd.level_add_scale;
       pos += hd.level_add_bits;
 
-      temp_int = NINT (rec->max_level_multiply * hd.level_multiply_scale);
-      bit_pack (buf, pos, hd.level_multiply_bits, temp_int);
+      /* Made unsigned in V2 */
+      temp_int = bit_unpack (buf, pos, hd.level_multiply_bits);
+      rec->max_level_multiply = (NV_FLOAT32) temp_int /
+          hd.level_multiply_scale;
       pos += hd.level_multiply_bits;
 
-      bit_pack (buf, pos, hd.time_bits, rec->flood_begins);
+      rec->flood_begins = signed_bit_unpack (buf, pos, hd.time_bits);
       pos += hd.time_bits;
 
-      bit_pack (buf, pos, hd.time_bits, rec->ebb_begins);
+      rec->ebb_begins = signed_bit_unpack (buf, pos, hd.time_bits);
       pos += hd.time_bits;
-  }
+    } else {
+      assert (0);
+    }
+    break;
 
-  else {
-    fprintf (stderr, "libtcd error:  Record type %d is undefined\n",
-	     rec->header.record_type);
-    exit (-1);
+  default:
+    assert (0);
   }
 
-  *bufsize = rec->header.record_size;
-  assert (*bufsize == bits2bytes (pos));
+  assert (pos <= bufsize*8);
 }
 
 
 /*****************************************************************************\
 
-    Function        write_tide_record - writes a tide record to the database
+    Function        read_tide_record - reads tide record "num" from the
+                    database
 
-    Synopsis        write_tide_record (num, rec);
+    Synopsis        read_tide_record (num, rec);
 
-                    NV_INT32 num            record number:
-                                            >= 0 overwrite record num
-                                              -1 write at current file position
-                    TIDE_RECORD *rec        tide record
+                    NV_INT32 num            record number (in)
+                    TIDE_RECORD *rec        tide record (in-out)
 
-    Returns         NV_BOOL                 NVTrue if successful
+                    rec must be allocated by the caller.
+
+    Returns         NV_INT32                num if success, -1 if failure
 
     Author          Jan C. Depner
     Date            08/01/02
 
     See libtcd.html for changelog.
 
-    hd.end_of_file is not updated by this function in any event.
-
 \*****************************************************************************/
 
-static NV_BOOL write_tide_record (NV_INT32 num, TIDE_RECORD *rec)
+NV_INT32 read_tide_record (NV_INT32 num, TIDE_RECORD *rec)
 {
-    NV_U_BYTE               *buf = NULL;
-    NV_U_INT32              bufsize = 0;
+  NV_U_INT64 start;
+  NV_INT32 ret;
 
-    if (!fp) {
-      fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
-      return NVFalse;
-    }
-    write_protect();
+  if (!fp) {
+    fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+    return -1;
+  }
 
-    pack_tide_record (rec, &buf, &bufsize);
+  if (num < 0 || num >= (NV_INT32)hd.pub.number_of_records)
+    return -1;
+  assert (rec);
 
-    if (num == -1)
-      ;
-    else if (num >= 0)
-      fseek (fp, tindex[num].address, SEEK_SET);
-    else
-      assert (0);
+  STATS_START (start);
 
-    chk_fwrite (buf, bufsize, 1, fp);
-    free (buf);
-    modified = NVTrue;
-    return NVTrue;
+  /* The buffer only grows, so once it has seen the largest record in
+     the file no further allocation happens here. */
+  if (tindex[num].record_size > read_buf_size)
+  {
+      STATS_ADD (cache_misses, 1);
+      free (read_buf);
+      if ((read_buf = (NV_U_BYTE *) malloc (max_record_size)) == NULL)
+      {
+          perror ("Allocating read_tide_record buffer");
+          exit (-1);
+      }
+      read_buf_size = max_record_size;
+  }
+  else STATS_ADD (cache_hits, 1);
+
+  ret = read_tide_record_into (num, rec, TIDE_FIELDS_ALL, read_buf,
+                               read_buf_size);
+  STATS_END (TIDE_STATS_READ_TIDE_RECORD, start);
+  return ret;
 }
 
 
 /*****************************************************************************\
 
-    Function        read_next_tide_record - reads the next tide record from
-                    the database
+    Function        read_tide_record_into - reads tide record "num" from
+                    the database using a caller-supplied buffer
 
-    Synopsis        read_next_tide_record (rec);
+    Synopsis        read_tide_record_into (num, rec, fields, scratch,
+                                           scratch_size);
 
-                    TIDE_RECORD *rec        tide record
+                    NV_INT32 num            record number (in)
+                    TIDE_RECORD *rec        tide record (in-out)
+                    NV_U_INT32 fields       TIDE_FIELDS_* mask (in)
+                    NV_U_BYTE *scratch      packed record buffer (in-out)
+                    NV_U_INT32 scratch_size size of scratch in bytes (in)
 
-    Returns         NV_INT32                record number of the tide record
+                    rec and scratch must be allocated by the caller.
+                    A scratch_size of get_max_record_size () is always
+                    enough.
 
-    Author          Jan C. Depner
-    Date            08/01/02
+    Returns         NV_INT32                num if success, -1 if failure
 
-    See libtcd.html for changelog.
+    Date            2026-10-19
+
+    Makes no heap allocations.  Like read_tide_record, num is preserved
+    in current_record.
 
 \*****************************************************************************/
 
-NV_INT32 read_next_tide_record (TIDE_RECORD *rec)
+NV_INT32 read_tide_record_into (NV_INT32 num, TIDE_RECORD *rec,
+NV_U_INT32 fields, NV_U_BYTE *scratch, NV_U_INT32 scratch_size)
 {
-  return (read_tide_record (current_record + 1, rec));
+  if (!fp) {
+    fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+    return -1;
+  }
+
+  if (num < 0 || num >= (NV_INT32)hd.pub.number_of_records)
+    return -1;
+  assert (rec);
+  assert (scratch);
+
+  if (tindex[num].record_size > scratch_size)
+    return -1;
+
+  current_record = num;
+  require (seek_db (tindex[num].address, SEEK_SET) == 0);
+  STATS_ADD (seeks, 1);
+  chk_fread (scratch, tindex[num].record_size, 1, fp);
+  unpack_tide_record (scratch, tindex[num].record_size, rec, num, fields);
+  STATS_ADD (records_decoded, 1);
+  return num;
 }
 
 
 /*****************************************************************************\
 
-    Function        unpack_tide_record - convert TIDE_RECORD from packed form
+    Function        get_max_record_size - size of the largest packed record
+                    in the database
 
-    Synopsis        unpack_tide_record (buf, bufsize, rec);
+    Synopsis        get_max_record_size ();
 
-                    NV_U_BYTE *buf          packed record (in)
-                    NV_U_INT32 bufsize      size of buf in bytes (in)
-                    TIDE_RECORD *rec        tide record (in-out)
+    Returns         NV_U_INT32              size in bytes
 
-                    rec must be allocated by the caller.
+    Date            2026-10-19
 
-    Returns         void
+\*****************************************************************************/
 
-    Author          Extracted from read_tide_record by David Flater
-    Date            2006-05-26
+NV_U_INT32 get_max_record_size ()
+{
+  if (!fp) {
+    fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+    return 0;
+  }
+  return max_record_size;
+}
 
-    rec->header.record_number is initialized from the global current_record.
 
+/*****************************************************************************\
+  State shared by the iterate_tide_records workers.
+
+  The matching record numbers are split into work units of contiguous
+  records.  Each unit is fetched with a single read (records are stored
+  back to back) and decoded by whichever worker claimed it.  The file
+  pointer is shared, so the reads themselves are serialized on io_lock;
+  everything after the read runs in parallel.
 \*****************************************************************************/
 
-static void unpack_tide_record (NV_U_BYTE *buf, NV_U_INT32 bufsize,
-TIDE_RECORD *rec) {
-  NV_INT32                temp_int;
-  NV_U_INT32              i, j, pos, count;
+typedef struct
+{
+    const TIDE_RECORD_FILTER  *filter;
+    NV_U_INT32              fields;
+    NV_BOOL                 ordered;
+    TIDE_RECORD_VISITOR     visitor;
+    void                    *user_data;
+
+    NV_INT32                *match;         /* matching record numbers */
+    NV_U_INT32              *unit_start;    /* units+1 offsets into match */
+    NV_U_INT32              units;
+    NV_U_INT32              max_unit;       /* most records in any unit */
+
+    NV_U_INT32              next_unit;      /* next unit to be claimed */
+    NV_U_INT32              next_delivery;  /* ordered: next unit to hand over */
+    NV_BOOL                 stop;           /* visitor asked to stop */
+
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t         claim_lock;     /* next_unit, stop */
+    pthread_mutex_t         io_lock;        /* fp */
+    pthread_mutex_t         delivery_lock;  /* next_delivery, visitor calls */
+    pthread_cond_t          delivery_turn;
+#endif
+} ITERATE_STATE;
 
-  assert (rec);
+typedef struct
+{
+    ITERATE_STATE           *state;
+    NV_INT32                delivered;
+    NV_INT32                decoded;
+} ITERATE_WORKER;
 
-  /* Initialize record */
-  memset (rec, 0, sizeof (TIDE_RECORD));
-  {
-    int r = find_dir_units ("degrees true");
-    assert (r > 0);
-    rec->direction_units = (NV_U_BYTE)r;
-  }
-  rec->min_direction = rec->max_direction = 361;
-  rec->flood_begins = rec->ebb_begins = NULLSLACKOFFSET;
-  rec->header.record_number = current_record;
 
-  unpack_partial_tide_record (buf, bufsize, rec, &pos);
+/* Work units are capped so that an ordered worker's decoded records
+   (about 33 KB apiece) stay within a couple of megabytes, and are split
+   wherever the filter leaves a gap big enough that reading through it
+   would cost more than a second read. */
+#define ITERATE_MAX_UNIT_RECORDS 64
+#define ITERATE_MAX_GAP_BYTES    65536
 
-  switch (rec->header.record_type) {
-  case REFERENCE_STATION:
-  case SUBORDINATE_STATION:
-    break;
-  default:
-    fprintf (stderr, "libtcd fatal error: tried to read type %d tide record.\n", rec->header.record_type);
-    fprintf (stderr, "This version of libtcd only supports types 1 and 2.  Perhaps you should\nupgrade.\n");
-    exit (-1);
-  }
 
-  switch (hd.pub.major_rev) {
+/*****************************************************************************\
 
-    /************************* TCD V1 *****************************/
-  case 0:
-  case 1:
+    Function        filter_index - applies the index part of a
+                    TIDE_RECORD_FILTER to tindex[num]
+
+    Synopsis        filter_index (filter, num);
+
+                    const TIDE_RECORD_FILTER *filter   filter (may be NULL)
+                    NV_INT32 num            record number
+
+    Returns         NV_BOOL                 NVTrue if the record passes
+
+    The country test needs the record body and is applied by the worker.
+
+\*****************************************************************************/
+
+static NV_BOOL filter_index (const TIDE_RECORD_FILTER *filter, NV_INT32 num)
+{
+    NV_FLOAT64              lat, lon;
+
+    if (!filter) return NVTrue;
 
-    /*  "pos" is the bit position within the buffer "buf".  */
+    if (filter->record_type && filter->record_type != tindex[num].record_type)
+        return NVFalse;
+    if (filter->tzfile >= 0 && filter->tzfile != tindex[num].tzfile)
+        return NVFalse;
+    if (filter->bbox)
+    {
+        lat = (NV_FLOAT64) tindex[num].lat / hd.latitude_scale;
+        lon = (NV_FLOAT64) tindex[num].lon / hd.longitude_scale;
+        if (lat < filter->min_lat || lat > filter->max_lat) return NVFalse;
 
-    rec->country = bit_unpack (buf, pos, hd.country_bits);
-    pos += hd.country_bits;
+        /*  A box with min_lon > max_lon crosses the 180th meridian.  */
 
-    /* pedigree */
-    pos += hd.pedigree_bits;
+        if (filter->min_lon <= filter->max_lon)
+        {
+            if (lon < filter->min_lon || lon > filter->max_lon)
+                return NVFalse;
+        }
+        else if (lon < filter->min_lon && lon > filter->max_lon)
+            return NVFalse;
+    }
+    return NVTrue;
+}
 
-    unpack_string (buf, bufsize, &pos, rec->source, ONELINER_LENGTH, "source field");
 
-    rec->restriction = bit_unpack (buf, pos, hd.restriction_bits);
-    pos += hd.restriction_bits;
+/*****************************************************************************\
 
-    unpack_string (buf, bufsize, &pos, rec->comments, MONOLOGUE_LENGTH, "comments field");
+    Function        iterate_worker - claims work units, reads and decodes
+                    them, and hands the records to the visitor
 
-    if (rec->header.record_type == REFERENCE_STATION) {
-      rec->level_units = bit_unpack (buf, pos, hd.level_unit_bits);
-#ifdef COMPAT114
-      rec->units = rec->level_units;
-#endif
-      pos += hd.level_unit_bits;
+    Synopsis        iterate_worker (arg);
 
-      temp_int = signed_bit_unpack (buf, pos, hd.datum_offset_bits);
-      rec->datum_offset = (NV_FLOAT32) temp_int / hd.datum_offset_scale;
-      pos += hd.datum_offset_bits;
+                    void *arg               ITERATE_WORKER
 
-      rec->datum = bit_unpack (buf, pos, hd.datum_bits);
-      pos += hd.datum_bits;
+    Returns         void *                  NULL
 
-      rec->zone_offset = signed_bit_unpack (buf, pos, hd.time_bits);
-      pos += hd.time_bits;
+\*****************************************************************************/
 
-      rec->expiration_date = bit_unpack (buf, pos, hd.date_bits);
-      pos += hd.date_bits;
+static void *iterate_worker (void *arg)
+{
+    ITERATE_WORKER          *worker = (ITERATE_WORKER *) arg;
+    ITERATE_STATE           *st = worker->state;
+    const TIDE_RECORD_FILTER *filter = st->filter;
+    NV_U_BYTE               *buf = NULL, *p;
+    NV_U_INT32              bufsize = 0, size, unit, first, last, i, n, pos;
+    NV_U_INT32              slots;
+    NV_INT32                num;
+    NV_INT64                lo, hi;
+    NV_BOOL                 stop;
+    TIDE_RECORD             *recs;
+
+    /*  Ordered delivery holds a whole unit until its turn comes round;
+        unordered delivery hands each record over as soon as it is
+        decoded.  */
+
+    slots = st->ordered ? st->max_unit : 1;
+    if ((recs = (TIDE_RECORD *) malloc (slots * sizeof (TIDE_RECORD))) ==
+        NULL)
+    {
+        perror ("Allocating iterate_tide_records workspace");
+        exit (-1);
+    }
 
-      rec->months_on_station = bit_unpack (buf, pos,
-          hd.months_on_station_bits);
-      pos += hd.months_on_station_bits;
+    for (;;)
+    {
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_lock (&st->claim_lock);
+#endif
+        stop = st->stop;
+        unit = st->next_unit;
+        if (!stop && unit < st->units) ++st->next_unit;
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_unlock (&st->claim_lock);
+#endif
+        if (stop || unit >= st->units) break;
 
-      rec->last_date_on_station = bit_unpack (buf, pos, hd.date_bits);
-      pos += hd.date_bits;
+        first = st->unit_start[unit];
+        last = st->unit_start[unit + 1] - 1;
+        lo = tindex[st->match[first]].address;
+        hi = tindex[st->match[last]].address +
+            tindex[st->match[last]].record_size;
+        size = hi - lo;
 
-      rec->confidence = bit_unpack (buf, pos, hd.confidence_value_bits);
-      pos += hd.confidence_value_bits;
+        if (size > bufsize)
+        {
+            free (buf);
+            if ((buf = (NV_U_BYTE *) malloc (size)) == NULL)
+            {
+                perror ("Allocating iterate_tide_records buffer");
+                exit (-1);
+            }
+            bufsize = size;
+        }
 
-      for (i = 0 ; i < hd.pub.constituents ; ++i) {
-        rec->amplitude[i] = 0.0;
-        rec->epoch[i] = 0.0;
-      }
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_lock (&st->io_lock);
+#endif
+        require (seek_db (lo, SEEK_SET) == 0);
+        STATS_ADD (seeks, 1);
+        chk_fread (buf, size, 1, fp);
+#ifdef HAVE_PTHREAD_H
+        pthread_mutex_unlock (&st->io_lock);
+#endif
 
-      count = bit_unpack (buf, pos, hd.constituent_bits);
-      pos += hd.constituent_bits;
+        n = 0;
+        for (i = first ; i <= last ; ++i)
+        {
+            num = st->match[i];
+            p = buf + (tindex[num].address - lo);
 
-      for (i = 0 ; i < count ; ++i) {
-        j = bit_unpack (buf, pos, hd.constituent_bits);
-        pos += hd.constituent_bits;
+            /*  The country index immediately follows the station header
+                in every version of the record, so it can be checked
+                before committing to a full decode.  */
 
-        rec->amplitude[j] = (NV_FLOAT32) bit_unpack (buf, pos,
-            hd.amplitude_bits) / hd.amplitude_scale;
-        pos += hd.amplitude_bits;
+            if (filter && filter->country >= 0)
+            {
+                unpack_partial_tide_record (p, tindex[num].record_size,
+                    &recs[n], &pos);
+                if ((NV_INT32) bit_unpack (p, pos, hd.country_bits) !=
+                    filter->country) continue;
+            }
 
-        rec->epoch[j] = (NV_FLOAT32) bit_unpack (buf, pos, hd.epoch_bits) /
-            hd.epoch_scale;
-        pos += hd.epoch_bits;
-      }
-    } else if (rec->header.record_type == SUBORDINATE_STATION) {
-      rec->level_units = bit_unpack (buf, pos, hd.level_unit_bits);
-      pos += hd.level_unit_bits;
+            unpack_tide_record (p, tindex[num].record_size, &recs[n], num,
+                st->fields);
+            ++worker->decoded;
 
-      rec->direction_units = bit_unpack (buf, pos, hd.dir_unit_bits);
-      pos += hd.dir_unit_bits;
+            if (st->ordered)
+            {
+                ++n;
+            }
+            else
+            {
+                ++worker->delivered;
+                if (!(*st->visitor) (&recs[0], st->user_data))
+                {
+#ifdef HAVE_PTHREAD_H
+                    pthread_mutex_lock (&st->claim_lock);
+#endif
+                    st->stop = NVTrue;
+#ifdef HAVE_PTHREAD_H
+                    pthread_mutex_unlock (&st->claim_lock);
+#endif
+                    break;
+                }
+            }
+        }
 
-      /* avg_level_units */
-      pos += hd.level_unit_bits;
+        if (st->ordered)
+        {
+            /*  Every claimed unit must advance next_delivery, even after
+                a stop, or the workers holding later units would wait
+                forever.  */
+
+#ifdef HAVE_PTHREAD_H
+            pthread_mutex_lock (&st->delivery_lock);
+            while (st->next_delivery != unit)
+                pthread_cond_wait (&st->delivery_turn, &st->delivery_lock);
+            pthread_mutex_lock (&st->claim_lock);
+#endif
+            stop = st->stop;
+#ifdef HAVE_PTHREAD_H
+            pthread_mutex_unlock (&st->claim_lock);
+#endif
+            for (i = 0 ; i < n && !stop ; ++i)
+            {
+                ++worker->delivered;
+                if (!(*st->visitor) (&recs[i], st->user_data))
+                {
+#ifdef HAVE_PTHREAD_H
+                    pthread_mutex_lock (&st->claim_lock);
+#endif
+                    stop = st->stop = NVTrue;
+#ifdef HAVE_PTHREAD_H
+                    pthread_mutex_unlock (&st->claim_lock);
+#endif
+                }
+            }
+            ++st->next_delivery;
+#ifdef HAVE_PTHREAD_H
+            pthread_cond_broadcast (&st->delivery_turn);
+            pthread_mutex_unlock (&st->delivery_lock);
+#endif
+        }
+    }
 
-      rec->min_time_add = signed_bit_unpack (buf, pos, hd.time_bits);
-      pos += hd.time_bits;
+    free (buf);
+    free (recs);
+    return NULL;
+}
 
-      temp_int = signed_bit_unpack (buf, pos, hd.level_add_bits);
-      rec->min_level_add = (NV_FLOAT32) temp_int / hd.level_add_scale;
-      pos += hd.level_add_bits;
 
-      /* Signed in V1 */
-      temp_int = signed_bit_unpack (buf, pos, hd.level_multiply_bits);
-      rec->min_level_multiply = (NV_FLOAT32) temp_int /
-          hd.level_multiply_scale;
-      pos += hd.level_multiply_bits;
+/*****************************************************************************\
 
-      /* min_avg_level */
-      pos += hd.level_add_bits;
+    Function        iterate_tide_records - decodes every record that passes
+                    a filter and hands it to a visitor, spreading the work
+                    over a pool of threads
+
+    Synopsis        iterate_tide_records (filter, fields, threads, ordered,
+                                          visitor, user_data);
+
+                    const TIDE_RECORD_FILTER *filter
+                                            records to visit, NULL for all
+                    NV_U_INT32 fields       TIDE_FIELDS_* mask of the parts
+                                            of the record to decode
+                    NV_U_INT32 threads      number of worker threads, 0 for
+                                            one per online processor
+                    NV_BOOL ordered         NVTrue to visit in record order
+                    TIDE_RECORD_VISITOR visitor
+                                            called once per record; return
+                                            NVFalse to stop early
+                    void *user_data         passed through to visitor
+
+    Returns         NV_INT32                number of records visited, or -1
+                                            if no database is open
+
+    Date            2026-10-19
+
+    With ordered set the visitor calls are serialized and made in
+    increasing record number.  Without it the visitor is called from
+    all of the workers concurrently, as soon as each record is decoded,
+    and must do its own locking.  Either way the record passed to the
+    visitor is only valid for the duration of the call, and the visitor
+    must not call back into libtcd functions that touch the file.
+
+    The global cursors (current_record, current_index) are not used or
+    changed.  Without pthreads, or with threads == 1, the scan is done
+    serially in the calling thread.
 
-      rec->min_direction = bit_unpack (buf, pos, hd.direction_bits);
-      pos += hd.direction_bits;
+\*****************************************************************************/
 
-      rec->max_time_add = signed_bit_unpack (buf, pos, hd.time_bits);
-      pos += hd.time_bits;
+NV_INT32 iterate_tide_records (const TIDE_RECORD_FILTER *filter,
+NV_U_INT32 fields, NV_U_INT32 threads, NV_BOOL ordered,
+TIDE_RECORD_VISITOR visitor, void *user_data)
+{
+    ITERATE_STATE           st;
+    ITERATE_WORKER          *workers;
+    NV_U_INT32              i, count, run;
+    NV_INT32                num, delivered;
+    NV_INT64                gap;
+#ifdef HAVE_PTHREAD_H
+    pthread_t               *tids;
+#endif
 
-      temp_int = signed_bit_unpack (buf, pos, hd.level_add_bits);
-      rec->max_level_add = (NV_FLOAT32) temp_int / hd.level_add_scale;
-      pos += hd.level_add_bits;
+    if (!fp) {
+      fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+      return -1;
+    }
+    assert (visitor);
 
-      /* Signed in V1 */
-      temp_int = signed_bit_unpack (buf, pos, hd.level_multiply_bits);
-      rec->max_level_multiply = (NV_FLOAT32) temp_int /
-          hd.level_multiply_scale;
-      pos += hd.level_multiply_bits;
+    memset (&st, 0, sizeof (st));
+    st.filter = filter;
+    st.fields = fields;
+    st.ordered = ordered;
+    st.visitor = visitor;
+    st.user_data = user_data;
 
-      /* max_avg_level */
-      pos += hd.level_add_bits;
+    if (!hd.pub.number_of_records) return 0;
 
-      rec->max_direction = bit_unpack (buf, pos, hd.direction_bits);
-      pos += hd.direction_bits;
 
-      rec->flood_begins = signed_bit_unpack (buf, pos, hd.time_bits);
-      pos += hd.time_bits;
+    /*  Select on the index, then cut the survivors into work units of
+        records that can be fetched with one read.  */
 
-      rec->ebb_begins = signed_bit_unpack (buf, pos, hd.time_bits);
-      pos += hd.time_bits;
-    } else {
-      assert (0);
+    if ((st.match = (NV_INT32 *) malloc (hd.pub.number_of_records *
+        sizeof (NV_INT32))) == NULL ||
+        (st.unit_start = (NV_U_INT32 *) malloc ((hd.pub.number_of_records +
+        1) * sizeof (NV_U_INT32))) == NULL)
+    {
+        perror ("Allocating iterate_tide_records index");
+        exit (-1);
     }
-    break;
 
-    /************************* TCD V2 *****************************/
-  case 2:
-    rec->country = bit_unpack (buf, pos, hd.country_bits);
-    pos += hd.country_bits;
+    count = 0;
+    for (num = 0 ; num < (NV_INT32) hd.pub.number_of_records ; ++num)
+        if (filter_index (filter, num)) st.match[count++] = num;
 
-    unpack_string (buf, bufsize, &pos, rec->source, ONELINER_LENGTH, "source field");
+    if (!count)
+    {
+        free (st.match);
+        free (st.unit_start);
+        return 0;
+    }
 
-    rec->restriction = bit_unpack (buf, pos, hd.restriction_bits);
-    pos += hd.restriction_bits;
+#ifdef HAVE_PTHREAD_H
+    if (!threads)
+    {
+#ifdef _SC_NPROCESSORS_ONLN
+        long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+        threads = ncpu > 0 ? (NV_U_INT32) ncpu : 1;
+#else
+        threads = 1;
+#endif
+    }
+#else
+    threads = 1;
+#endif
 
-    unpack_string (buf, bufsize, &pos, rec->comments, MONOLOGUE_LENGTH, "comments field");
-    unpack_string (buf, bufsize, &pos, rec->notes, MONOLOGUE_LENGTH, "notes field");
+    /*  Aim for several units per worker so that a slow unit doesn't
+        leave the others idle.  */
 
-    rec->legalese = bit_unpack (buf, pos, hd.legalese_bits);
-    pos += hd.legalese_bits;
+    run = count / (threads * 8);
+    if (run < 1) run = 1;
+    if (run > ITERATE_MAX_UNIT_RECORDS) run = ITERATE_MAX_UNIT_RECORDS;
 
-    unpack_string (buf, bufsize, &pos, rec->station_id_context, ONELINER_LENGTH, "station_id_context field");
-    unpack_string (buf, bufsize, &pos, rec->station_id, ONELINER_LENGTH, "station_id field");
+    st.units = 0;
+    st.unit_start[0] = 0;
+    for (i = 1 ; i < count ; ++i)
+    {
+        gap = tindex[st.match[i]].address -
+            (tindex[st.match[i - 1]].address +
+            tindex[st.match[i - 1]].record_size);
+        if (i - st.unit_start[st.units] >= run || gap > ITERATE_MAX_GAP_BYTES)
+            st.unit_start[++st.units] = i;
+    }
+    st.unit_start[++st.units] = count;
 
-    rec->date_imported = bit_unpack (buf, pos, hd.date_bits);
-    pos += hd.date_bits;
+    st.max_unit = 0;
+    for (i = 0 ; i < st.units ; ++i)
+        if (st.unit_start[i + 1] - st.unit_start[i] > st.max_unit)
+            st.max_unit = st.unit_start[i + 1] - st.unit_start[i];
 
-    unpack_string (buf, bufsize, &pos, rec->xfields, MONOLOGUE_LENGTH, "xfields field");
+    if (threads > st.units) threads = st.units;
 
-    rec->direction_units = bit_unpack (buf, pos, hd.dir_unit_bits);
-    pos += hd.dir_unit_bits;
+    if ((workers = (ITERATE_WORKER *) calloc (threads,
+        sizeof (ITERATE_WORKER))) == NULL)
+    {
+        perror ("Allocating iterate_tide_records workers");
+        exit (-1);
+    }
+    for (i = 0 ; i < threads ; ++i) workers[i].state = &st;
 
-    rec->min_direction = bit_unpack (buf, pos, hd.direction_bits);
-    pos += hd.direction_bits;
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_init (&st.claim_lock, NULL);
+    pthread_mutex_init (&st.io_lock, NULL);
+    pthread_mutex_init (&st.delivery_lock, NULL);
+    pthread_cond_init (&st.delivery_turn, NULL);
 
-    rec->max_direction = bit_unpack (buf, pos, hd.direction_bits);
-    pos += hd.direction_bits;
+    if ((tids = (pthread_t *) malloc (threads * sizeof (pthread_t))) == NULL)
+    {
+        perror ("Allocating iterate_tide_records threads");
+        exit (-1);
+    }
 
-    rec->level_units = bit_unpack (buf, pos, hd.level_unit_bits);
-#ifdef COMPAT114
-    rec->units = rec->level_units;
+    /*  The calling thread does its share as worker 0.  */
+
+    for (i = 1 ; i < threads ; ++i)
+    {
+        if (pthread_create (&tids[i], NULL, iterate_worker, &workers[i]))
+        {
+            perror ("Starting iterate_tide_records thread");
+            exit (-1);
+        }
+    }
 #endif
-    pos += hd.level_unit_bits;
 
-    if (rec->header.record_type == REFERENCE_STATION) {
-      temp_int = signed_bit_unpack (buf, pos, hd.datum_offset_bits);
-      rec->datum_offset = (NV_FLOAT32) temp_int / hd.datum_offset_scale;
-      pos += hd.datum_offset_bits;
+    iterate_worker (&workers[0]);
 
-      rec->datum = bit_unpack (buf, pos, hd.datum_bits);
-      pos += hd.datum_bits;
+#ifdef HAVE_PTHREAD_H
+    for (i = 1 ; i < threads ; ++i) pthread_join (tids[i], NULL);
+    free (tids);
 
-      rec->zone_offset = signed_bit_unpack (buf, pos, hd.time_bits);
-      pos += hd.time_bits;
+    pthread_cond_destroy (&st.delivery_turn);
+    pthread_mutex_destroy (&st.delivery_lock);
+    pthread_mutex_destroy (&st.io_lock);
+    pthread_mutex_destroy (&st.claim_lock);
+#endif
 
-      rec->expiration_date = bit_unpack (buf, pos, hd.date_bits);
-      pos += hd.date_bits;
+    delivered = 0;
+    for (i = 0 ; i < threads ; ++i)
+    {
+        delivered += workers[i].delivered;
+        STATS_ADD (records_decoded, workers[i].decoded);
+    }
 
-      rec->months_on_station = bit_unpack (buf, pos,
-          hd.months_on_station_bits);
-      pos += hd.months_on_station_bits;
+    free (workers);
+    free (st.match);
+    free (st.unit_start);
+    return delivered;
+}
 
-      rec->last_date_on_station = bit_unpack (buf, pos, hd.date_bits);
-      pos += hd.date_bits;
 
-      rec->confidence = bit_unpack (buf, pos, hd.confidence_value_bits);
-      pos += hd.confidence_value_bits;
+/*  read_tide_records merges the requested records into one read
+    wherever the gap between them is no bigger than ITERATE_MAX_GAP_BYTES,
+    up to this many bytes per read.  */
 
-      for (i = 0 ; i < hd.pub.constituents ; ++i) {
-        rec->amplitude[i] = 0.0;
-        rec->epoch[i] = 0.0;
-      }
+#define FETCH_MAX_RUN_BYTES      1048576
 
-      count = bit_unpack (buf, pos, hd.constituent_bits);
-      pos += hd.constituent_bits;
+typedef struct
+{
+    NV_INT64                address;
+    NV_U_INT32              record_size;
+    NV_U_INT32              slot;           /* index into nums and recs */
+} FETCH_SLOT;
 
-      for (i = 0 ; i < count ; ++i) {
-        j = bit_unpack (buf, pos, hd.constituent_bits);
-        pos += hd.constituent_bits;
 
-        rec->amplitude[j] = (NV_FLOAT32) bit_unpack (buf, pos,
-            hd.amplitude_bits) / hd.amplitude_scale;
-        pos += hd.amplitude_bits;
+static int compare_fetch_slots (const void *a, const void *b)
+{
+    const FETCH_SLOT        *sa = (const FETCH_SLOT *) a;
+    const FETCH_SLOT        *sb = (const FETCH_SLOT *) b;
 
-        rec->epoch[j] = (NV_FLOAT32) bit_unpack (buf, pos, hd.epoch_bits) /
-            hd.epoch_scale;
-        pos += hd.epoch_bits;
-      }
-    } else if (rec->header.record_type == SUBORDINATE_STATION) {
-      rec->min_time_add = signed_bit_unpack (buf, pos, hd.time_bits);
-      pos += hd.time_bits;
+    if (sa->address != sb->address) return sa->address < sb->address ? -1 : 1;
+    return (sa->slot > sb->slot) - (sa->slot < sb->slot);
+}
 
-      temp_int = signed_bit_unpack (buf, pos, hd.level_add_bits);
-      rec->min_level_add = (NV_FLOAT32) temp_int / hd.level_add_scale;
-      pos += hd.level_add_bits;
 
-      /* Made unsigned in V2 */
-      temp_int = bit_unpack (buf, pos, hd.level_multiply_bits);
-      rec->min_level_multiply = (NV_FLOAT32) temp_int /
-          hd.level_multiply_scale;
-      pos += hd.level_multiply_bits;
+/*****************************************************************************\
 
-      rec->max_time_add = signed_bit_unpack (buf, pos, hd.time_bits);
-      pos += hd.time_bits;
+    Function        fetch_run_end - finds the extent of the read that
+                    starts at slots[first]
 
-      temp_int = signed_bit_unpack (buf, pos, hd.level_add_bits);
-      rec->max_level_add = (NV_FLOAT32) temp_int / hd.level_add_scale;
-      pos += hd.level_add_bits;
+    Synopsis        fetch_run_end (slots, count, first, &lo, &hi);
 
-      /* Made unsigned in V2 */
-      temp_int = bit_unpack (buf, pos, hd.level_multiply_bits);
-      rec->max_level_multiply = (NV_FLOAT32) temp_int /
-          hd.level_multiply_scale;
-      pos += hd.level_multiply_bits;
+                    const FETCH_SLOT *slots slots sorted by address
+                    NV_U_INT32 count        number of slots
+                    NV_U_INT32 first        first slot of the run
+                    NV_INT64 *lo            file offset of the run (out)
+                    NV_INT64 *hi            file offset past the run (out)
 
-      rec->flood_begins = signed_bit_unpack (buf, pos, hd.time_bits);
-      pos += hd.time_bits;
+    Returns         NV_U_INT32              index of the first slot after
+                                            the run
 
-      rec->ebb_begins = signed_bit_unpack (buf, pos, hd.time_bits);
-      pos += hd.time_bits;
-    } else {
-      assert (0);
-    }
-    break;
+\*****************************************************************************/
 
-  default:
-    assert (0);
-  }
+static NV_U_INT32 fetch_run_end (const FETCH_SLOT *slots, NV_U_INT32 count,
+NV_U_INT32 first, NV_INT64 *lo, NV_INT64 *hi)
+{
+    NV_U_INT32              i;
+    NV_INT64                end;
 
-  assert (pos <= bufsize*8);
+    *lo = slots[first].address;
+    *hi = *lo + slots[first].record_size;
+
+    for (i = first + 1 ; i < count ; ++i)
+    {
+        end = slots[i].address + slots[i].record_size;
+        if (slots[i].address - *hi > ITERATE_MAX_GAP_BYTES) break;
+        if (end > *hi)
+        {
+            if (end - *lo > FETCH_MAX_RUN_BYTES) break;
+            *hi = end;
+        }
+    }
+    return i;
 }
 
 
 /*****************************************************************************\
 
-    Function        read_tide_record - reads tide record "num" from the
-                    database
+    Function        read_tide_records - reads a batch of tide records from
+                    the database
 
-    Synopsis        read_tide_record (num, rec);
+    Synopsis        read_tide_records (nums, count, recs, fields);
 
-                    NV_INT32 num            record number (in)
-                    TIDE_RECORD *rec        tide record (in-out)
+                    const NV_INT32 *nums    record numbers (in)
+                    NV_U_INT32 count        number of records (in)
+                    TIDE_RECORD *recs       count tide records (out)
+                    NV_U_INT32 fields       TIDE_FIELDS_* mask (in)
 
-                    rec must be allocated by the caller.
+                    recs[i] receives record nums[i].  recs must be
+                    allocated by the caller.  nums need not be sorted and
+                    may repeat.
 
-    Returns         NV_INT32                num if success, -1 if failure
+    Returns         NV_INT32                count if success, -1 if failure
 
-    Author          Jan C. Depner
-    Date            08/01/02
+    Date            2026-10-19
 
-    See libtcd.html for changelog.
+    The records are read in file order and records that lie close
+    together are fetched with a single read, so a batch costs a handful
+    of reads rather than one seek and read per record.  Where
+    posix_fadvise is available every range is announced to the kernel
+    before the first read so that cold-cache fetches overlap.
+
+    If any record number is out of range nothing is read.  Unlike
+    read_tide_record, current_record is not changed.
 
 \*****************************************************************************/
 
-NV_INT32 read_tide_record (NV_INT32 num, TIDE_RECORD *rec)
+NV_INT32 read_tide_records (const NV_INT32 *nums, NV_U_INT32 count,
+TIDE_RECORD *recs, NV_U_INT32 fields)
 {
-  NV_U_BYTE               *buf;
-  NV_U_INT32              bufsize;
+    FETCH_SLOT              *slots;
+    NV_U_INT32              i, j, end;
+    NV_INT64                lo, hi;
+    NV_U_INT64              start;
 
-  if (!fp) {
-    fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
-    return -1;
-  }
+    if (!fp) {
+      fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+      return -1;
+    }
 
-  if (num < 0 || num >= (NV_INT32)hd.pub.number_of_records)
-    return -1;
-  assert (rec);
+    if (!count) return 0;
+    assert (nums);
+    assert (recs);
 
-  bufsize = tindex[num].record_size;
-  if ((buf = (NV_U_BYTE *) calloc (bufsize, sizeof (NV_U_BYTE))) == NULL)
-  {
-      perror ("Allocating read_tide_record buffer");
-      exit (-1);
-  }
+    for (i = 0 ; i < count ; ++i)
+        if (nums[i] < 0 || nums[i] >= (NV_INT32) hd.pub.number_of_records)
+            return -1;
 
-  current_record = num;
-  require (fseek (fp, tindex[num].address, SEEK_SET) == 0);
-  chk_fread (buf, tindex[num].record_size, 1, fp);
-  unpack_tide_record (buf, bufsize, rec);
-  free (buf);
-  return num;
+    STATS_START (start);
+
+    if ((slots = (FETCH_SLOT *) malloc (count * sizeof (FETCH_SLOT))) ==
+        NULL)
+    {
+        perror ("Allocating read_tide_records slots");
+        exit (-1);
+    }
+    for (i = 0 ; i < count ; ++i)
+    {
+        slots[i].address = tindex[nums[i]].address;
+        slots[i].record_size = tindex[nums[i]].record_size;
+        slots[i].slot = i;
+    }
+    qsort (slots, count, sizeof (FETCH_SLOT), compare_fetch_slots);
+
+#if defined (HAVE_POSIX_FADVISE) && defined (POSIX_FADV_WILLNEED)
+    for (i = 0 ; i < count ; i = end)
+    {
+        end = fetch_run_end (slots, count, i, &lo, &hi);
+        posix_fadvise (fileno (fp), lo, hi - lo, POSIX_FADV_WILLNEED);
+    }
+#endif
+
+    for (i = 0 ; i < count ; i = end)
+    {
+        end = fetch_run_end (slots, count, i, &lo, &hi);
+
+        /*  Shares read_tide_record's grow-only buffer.  */
+
+        if ((NV_U_INT32) (hi - lo) > read_buf_size)
+        {
+            STATS_ADD (cache_misses, 1);
+            free (read_buf);
+            if ((read_buf = (NV_U_BYTE *) malloc (hi - lo)) == NULL)
+            {
+                perror ("Allocating read_tide_records buffer");
+                exit (-1);
+            }
+            read_buf_size = hi - lo;
+        }
+        else STATS_ADD (cache_hits, 1);
+
+        require (seek_db (lo, SEEK_SET) == 0);
+        STATS_ADD (seeks, 1);
+        chk_fread (read_buf, hi - lo, 1, fp);
+
+        for (j = i ; j < end ; ++j)
+            unpack_tide_record (read_buf + (slots[j].address - lo),
+                slots[j].record_size, &recs[slots[j].slot],
+                nums[slots[j].slot], fields);
+    }
+    STATS_ADD (records_decoded, count);
+
+    free (slots);
+    STATS_END (TIDE_STATS_READ_TIDE_RECORDS, start);
+    return (NV_INT32) count;
 }
 
 
@@ -5151,7 +6872,9 @@ NV_INT32 read_tide_record (NV_INT32 num, TIDE_RECORD *rec)
 
 NV_BOOL add_tide_record (TIDE_RECORD *rec, DB_HEADER_PUBLIC *db)
 {
-    NV_INT32                pos;
+    NV_INT64                pos;
+    NV_BOOL                 ret = NVFalse;
+    NV_U_INT64              start;
 
     if (!fp) {
       fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
@@ -5161,9 +6884,13 @@ NV_BOOL add_tide_record (TIDE_RECORD *rec, DB_HEADER_PUBLIC *db)
 
     if (!check_tide_record (rec))
       return NVFalse;
+    figure_size (rec);
+    if (!check_format_limits (rec, rec->header.record_size))
+      return NVFalse;
 
-    fseek (fp, hd.end_of_file, SEEK_SET);
-    pos = ftell (fp);
+    STATS_START (start);
+    seek_db (hd.end_of_file, SEEK_SET);
+    pos = tell_db ();
     assert (pos > 0);
 
     rec->header.record_number = hd.pub.number_of_records++;
@@ -5179,6 +6906,8 @@ NV_BOOL add_tide_record (TIDE_RECORD *rec, DB_HEADER_PUBLIC *db)
 
         tindex[rec->header.record_number].address = pos;
         tindex[rec->header.record_number].record_size = rec->header.record_size;
+        if (rec->header.record_size > max_record_size)
+            max_record_size = rec->header.record_size;
         tindex[rec->header.record_number].record_type = rec->header.record_type;
         tindex[rec->header.record_number].reference_station =
             rec->header.reference_station;
@@ -5190,17 +6919,10 @@ NV_BOOL add_tide_record (TIDE_RECORD *rec, DB_HEADER_PUBLIC *db)
             hd.longitude_scale);
 
 
-        if ((tindex[rec->header.record_number].name =
-            (NV_CHAR *) calloc (strlen (rec->header.name) + 1,
-            sizeof (NV_CHAR))) == NULL)
-        {
-            perror ("Allocating index name memory");
-            exit (-1);
-        }
-
+        tindex[rec->header.record_number].name =
+            arena_strdup (rec->header.name);
 
-        strcpy (tindex[rec->header.record_number].name, rec->header.name);
-        pos = ftell (fp);
+        pos = tell_db ();
         assert (pos > 0);
         hd.end_of_file = pos;
         modified = NVTrue;
@@ -5209,10 +6931,11 @@ NV_BOOL add_tide_record (TIDE_RECORD *rec, DB_HEADER_PUBLIC *db)
         if (db)
           *db = hd.pub;
 
-        return NVTrue;
+        ret = NVTrue;
     }
 
-    return NVFalse;
+    STATS_END (TIDE_STATS_ADD_TIDE_RECORD, start);
+    return ret;
 }
 
 
@@ -5262,13 +6985,13 @@ NV_BOOL delete_tide_record (NV_INT32 num, DB_HEADER_PUBLIC *db)
   /* First pass: read in database, build record number map and mark records
      for deletion */
 
-  require (fseek (fp, tindex[0].address, SEEK_SET) == 0);
+  require (seek_db (tindex[0].address, SEEK_SET) == 0);
   for (newrecnum=0,i=0; i<(NV_INT32)hd.pub.number_of_records; ++i) {
-    assert (ftell(fp) == tindex[i].address);
+    assert (tell_db () == tindex[i].address);
     if (i == num || (tindex[i].record_type == SUBORDINATE_STATION && tindex[i].reference_station == num)) {
       map[i] = -1;
       allrecs_packed[i] = NULL;
-      require (fseek (fp, tindex[i].record_size, SEEK_CUR) == 0);
+      require (seek_db (tindex[i].record_size, SEEK_CUR) == 0);
     } else {
       map[i] = newrecnum++;
       if (!(allrecs_packed[i] = (NV_U_BYTE *) malloc (tindex[i].record_size))) {
@@ -5285,7 +7008,7 @@ NV_BOOL delete_tide_record (NV_INT32 num, DB_HEADER_PUBLIC *db)
 
   /* Second pass: rewrite database and fix substation linkage */
 
-  require (fseek (fp, tindex[0].address, SEEK_SET) == 0);
+  require (seek_db (tindex[0].address, SEEK_SET) == 0);
   require (ftruncate (fileno(fp), tindex[0].address) == 0);
 
   for (i=0; i<(NV_INT32)hd.pub.number_of_records; ++i)
@@ -5296,7 +7019,8 @@ NV_BOOL delete_tide_record (NV_INT32 num, DB_HEADER_PUBLIC *db)
         if (map[tindex[i].reference_station] != tindex[i].reference_station) {
           /* Fix broken reference station linkage */
           TIDE_RECORD rec;
-          unpack_tide_record (allrecs_packed[i], tindex[i].record_size, &rec);
+          unpack_tide_record (allrecs_packed[i], tindex[i].record_size, &rec,
+                              current_record, TIDE_FIELDS_ALL);
           free (allrecs_packed[i]);
           rec.header.reference_station = map[tindex[i].reference_station];
           pack_tide_record (&rec, &(allrecs_packed[i]), &(tindex[i].record_size));
@@ -5314,11 +7038,10 @@ NV_BOOL delete_tide_record (NV_INT32 num, DB_HEADER_PUBLIC *db)
   /* Flush, reopen, renew.  The index is now garbage; close and reopen
      to reindex. */
 
-  hd.end_of_file = ftell(fp);
+  hd.end_of_file = tell_db ();
   hd.pub.number_of_records = newrecnum;
   modified = NVTrue;
-  close_tide_db ();
-  open_tide_db (filename);
+  reopen_tide_db ();
 
   if (db)
     *db = hd.pub;
@@ -5327,6 +7050,313 @@ NV_BOOL delete_tide_record (NV_INT32 num, DB_HEADER_PUBLIC *db)
 }
 
 
+/*****************************************************************************\
+
+    Function        reorder_tide_db - rewrites the records of the database
+                    in a new order
+
+    Synopsis        reorder_tide_db (order);
+
+                    const NV_INT32 *order   order[i] is the current number
+                                            of the record that becomes
+                                            record i
+
+    Returns         NV_BOOL                 NVTrue if successful
+
+    Date            2026-10-19
+
+    Subordinate stations are relinked to the new numbers of their
+    reference stations.  Like delete_tide_record, this holds every record
+    in memory while the file is rewritten in place.  The station field
+    has a fixed width, so relinking patches the packed records rather
+    than repacking them and no record changes size.
+
+\*****************************************************************************/
+
+NV_BOOL reorder_tide_db (const NV_INT32 *order)
+{
+  static TIDE_RECORD  rec;
+  NV_INT32            *map;
+  NV_U_INT32          i, n, pos;
+  NV_INT64            base, len;
+  NV_U_BYTE           *block, *packed;
+
+  if (!fp) {
+    fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+    return NVFalse;
+  }
+  write_protect();
+  assert (order);
+
+  n = hd.pub.number_of_records;
+  if (!n) return NVTrue;
+
+  if (!(map = (NV_INT32 *) malloc (n * sizeof(NV_INT32)))) {
+    perror ("libtcd: reorder_tide_db: can't malloc");
+    return NVFalse;
+  }
+  for (i=0; i<n; ++i)
+    map[i] = -1;
+  for (i=0; i<n; ++i) {
+    if (order[i] < 0 || order[i] >= (NV_INT32)n || map[order[i]] != -1) {
+      fprintf (stderr, "libtcd error: reorder_tide_db: order is not a permutation of the records\n");
+      free (map);
+      return NVFalse;
+    }
+    map[order[i]] = i;
+  }
+
+  base = tindex[0].address;
+  len = hd.end_of_file - base;
+  if (!(block = (NV_U_BYTE *) malloc ((size_t) len))) {
+    perror ("libtcd: reorder_tide_db: can't malloc");
+    free (map);
+    return NVFalse;
+  }
+  require (seek_db (base, SEEK_SET) == 0);
+  chk_fread (block, (size_t) len, 1, fp);
+
+  require (seek_db (base, SEEK_SET) == 0);
+  for (i=0; i<n; ++i) {
+    packed = block + (tindex[order[i]].address - base);
+    if (tindex[order[i]].record_type == SUBORDINATE_STATION) {
+      unpack_partial_tide_record (packed, tindex[order[i]].record_size, &rec,
+                                  &pos);
+      assert (rec.header.reference_station >= 0 &&
+              rec.header.reference_station < (NV_INT32)n);
+      bit_pack (packed, pos - hd.station_bits, hd.station_bits,
+                map[rec.header.reference_station]);
+    }
+    chk_fwrite (packed, tindex[order[i]].record_size, 1, fp);
+  }
+  assert (tell_db () == (NV_INT64) hd.end_of_file);
+
+  free (block);
+  free (map);
+
+  /* The index is now garbage; reopen to reindex. */
+
+  modified = NVTrue;
+  return reopen_tide_db ();
+}
+
+
+/*****************************************************************************\
+  2026-10-19
+  Position of a point along a space-filling curve over a 65536 x 65536
+  grid, for sort_tide_db_by_location.  x and y are the cell coordinates.
+\*****************************************************************************/
+static NV_U_INT32 curve_key (NV_U_INT32 x, NV_U_INT32 y, NV_U_INT32 curve) {
+  NV_U_INT32 s, rx, ry, t, key = 0;
+
+  if (curve == TIDE_ORDER_ZORDER) {
+    for (s=0; s<16; ++s)
+      key |= ((x >> s) & 1) << (2*s) | ((y >> s) & 1) << (2*s+1);
+    return key;
+  }
+
+  /* Hilbert curve, from the usual rotate-and-flip formulation. */
+  for (s=1<<15; s>0; s>>=1) {
+    rx = (x & s) > 0;
+    ry = (y & s) > 0;
+    key += s * s * ((3 * rx) ^ ry);
+    if (!ry) {
+      if (rx) {
+        x = 0xffff - x;
+        y = 0xffff - y;
+      }
+      t = x;
+      x = y;
+      y = t;
+    }
+  }
+  return key;
+}
+
+
+typedef struct
+{
+    NV_U_INT32              key;
+    NV_INT32                num;
+} CURVE_SLOT;
+
+
+static int compare_curve_slots (const void *a, const void *b)
+{
+    const CURVE_SLOT        *sa = (const CURVE_SLOT *) a;
+    const CURVE_SLOT        *sb = (const CURVE_SLOT *) b;
+
+    if (sa->key != sb->key) return sa->key < sb->key ? -1 : 1;
+    return (sa->num > sb->num) - (sa->num < sb->num);
+}
+
+
+/*****************************************************************************\
+
+    Function        sort_tide_db_by_location - orders the records of the
+                    database along a space-filling curve
+
+    Synopsis        sort_tide_db_by_location (curve);
+
+                    NV_U_INT32 curve        TIDE_ORDER_HILBERT or
+                                            TIDE_ORDER_ZORDER
+
+    Returns         NV_BOOL                 NVTrue if successful
+
+    Date            2026-10-19
+
+    Longitude and latitude are scaled onto a 65536 x 65536 grid (cells
+    about 600 m across) and the records are rewritten by reorder_tide_db
+    in curve order, so that stations near each other on the map are near
+    each other in the file.  Records in the same cell keep their
+    relative order.
+
+\*****************************************************************************/
+
+NV_BOOL sort_tide_db_by_location (NV_U_INT32 curve)
+{
+  CURVE_SLOT          *slots;
+  NV_INT32            *order;
+  NV_U_INT32          i, n, x, y;
+  NV_BOOL             ret;
+
+  if (!fp) {
+    fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+    return NVFalse;
+  }
+  if (curve != TIDE_ORDER_HILBERT && curve != TIDE_ORDER_ZORDER) {
+    fprintf (stderr, "libtcd error: sort_tide_db_by_location: unknown curve %u\n", curve);
+    return NVFalse;
+  }
+
+  n = hd.pub.number_of_records;
+  slots = (CURVE_SLOT *) malloc (n * sizeof(CURVE_SLOT) + 1);
+  order = (NV_INT32 *) malloc (n * sizeof(NV_INT32) + 1);
+  if (!slots || !order) {
+    perror ("libtcd: sort_tide_db_by_location: can't malloc");
+    free (slots);
+    free (order);
+    return NVFalse;
+  }
+
+  for (i=0; i<n; ++i) {
+    x = (NV_U_INT32) (((NV_INT64) tindex[i].lon + 180 * (NV_INT64)
+        hd.longitude_scale) * 65535 / (360 * (NV_INT64) hd.longitude_scale));
+    y = (NV_U_INT32) (((NV_INT64) tindex[i].lat + 90 * (NV_INT64)
+        hd.latitude_scale) * 65535 / (180 * (NV_INT64) hd.latitude_scale));
+    slots[i].key = curve_key (x & 0xffff, y & 0xffff, curve);
+    slots[i].num = i;
+  }
+  qsort (slots, n, sizeof(CURVE_SLOT), compare_curve_slots);
+  for (i=0; i<n; ++i)
+    order[i] = slots[i].num;
+  free (slots);
+
+  ret = reorder_tide_db (order);
+  free (order);
+  return ret;
+}
+
+
+/*****************************************************************************\
+
+    Function        set_tide_db_years - replaces the range of years
+                    covered by the equilibrium argument and node factor
+                    tables
+
+    Synopsis        set_tide_db_years (start_year, num_years, equilibrium,
+                        node_factor);
+
+                    NV_INT32 start_year        new start year
+                    NV_U_INT32 num_years       new number of years
+                    NV_FLOAT32 *equilibrium[]  equilibrium arguments
+                    NV_FLOAT32 *node_factor[]  node factors
+
+    Returns         NV_BOOL                 NVTrue if successful
+
+    Date            2026-10-19
+
+    equilibrium and node_factor are laid out as for create_tide_db, one
+    row of num_years values per constituent of the open database.  Only
+    the header is re-encoded; the records are copied unchanged to
+    wherever the end of the new tables puts them.  The record area is
+    held in memory while it is moved.
+
+\*****************************************************************************/
+
+NV_BOOL set_tide_db_years (NV_INT32 start_year, NV_U_INT32 num_years,
+    NV_FLOAT32 const * const equilibrium[],
+    NV_FLOAT32 const * const node_factor[])
+{
+  NV_U_INT32          i, j, cells;
+  NV_INT64            base, len, new_base;
+  NV_U_BYTE           *block = NULL;
+
+  if (!fp) {
+    fprintf (stderr, "libtcd error: attempt to access database when database not open\n");
+    return NVFalse;
+  }
+  write_protect();
+  assert (equilibrium && node_factor);
+
+  if (!num_years) {
+    fprintf (stderr, "libtcd error: set_tide_db_years: number of years is zero\n");
+    return NVFalse;
+  }
+  for (i = 0 ; i < hd.pub.constituents ; ++i)
+    for (j = 0 ; j < num_years ; ++j)
+      if (!(node_factor[i][j] > 0.0)) {
+        fprintf (stderr, "libtcd error: set_tide_db_years: node factor %u,%u is not positive\n",
+          i, j);
+        return NVFalse;
+      }
+
+  /* Everything from the first record to the end of the file is moved
+     as one block.  With no records that is nothing. */
+
+  cells = hd.pub.constituents * hd.pub.number_of_years;
+  base = hd.pub.number_of_records ? tindex[0].address :
+    (NV_INT64) hd.end_of_file;
+  len = hd.end_of_file - base;
+  if (len) {
+    if (!(block = (NV_U_BYTE *) malloc ((size_t) len))) {
+      perror ("libtcd: set_tide_db_years: can't malloc");
+      return NVFalse;
+    }
+    require (seek_db (base, SEEK_SET) == 0);
+    chk_fread (block, (size_t) len, 1, fp);
+  }
+  new_base = base - bits2bytes (cells * hd.equilibrium_bits) -
+    bits2bytes (cells * hd.node_bits);
+
+  hd.pub.start_year = start_year;
+  hd.pub.number_of_years = num_years;
+  load_table (EQUILIBRIUM_TABLE, equilibrium);
+  load_table (NODE_FACTOR_TABLE, node_factor);
+
+  cells = hd.pub.constituents * num_years;
+  new_base += bits2bytes (cells * hd.equilibrium_bits) +
+    bits2bytes (cells * hd.node_bits);
+  hd.end_of_file = new_base + len;
+
+  write_tide_db_header ();
+  assert (tell_db () == new_base);
+  if (len) {
+    chk_fwrite (block, (size_t) len, 1, fp);
+    free (block);
+  }
+  if (new_base < base) {
+    fflush (fp);
+    require (ftruncate (fileno(fp), hd.end_of_file) == 0);
+  }
+
+  /* The index is now garbage; reopen to reindex. */
+
+  modified = NVTrue;
+  return reopen_tide_db ();
+}
+
+
 /*****************************************************************************\
 
     Function        update_tide_record - updates a tide record in the database
@@ -5351,7 +7381,7 @@ NV_BOOL update_tide_record (NV_INT32 num, TIDE_RECORD *rec)
 NV_BOOL update_tide_record (NV_INT32 num, TIDE_RECORD *rec, DB_HEADER_PUBLIC *db)
 #endif
 {
-    NV_INT32                pos, size;
+    NV_INT64                pos, size;
     TIDE_RECORD             tmp_rec;
     NV_U_BYTE               *block = NULL;
 
@@ -5367,13 +7397,16 @@ NV_BOOL update_tide_record (NV_INT32 num, TIDE_RECORD *rec, DB_HEADER_PUBLIC *db
       return NVFalse;
 
     figure_size (rec);
+    if (!check_format_limits (rec, (NV_INT64) rec->header.record_size -
+        tindex[num].record_size))
+      return NVFalse;
     read_tide_record (num, &tmp_rec);
     if (rec->header.record_size != tmp_rec.header.record_size)
     {
         /*  Aaaaaaarrrrrgggggghhhh!!!!  We have to move stuff!  */
 
         /*  Save where we are - end of record being modified.  */
-        pos = ftell (fp);
+        pos = tell_db ();
         assert (pos > 0);
 
         /*  Figure out how big a block we need to move.  */
@@ -5402,11 +7435,10 @@ NV_BOOL update_tide_record (NV_INT32 num, TIDE_RECORD *rec, DB_HEADER_PUBLIC *db
             free (block);
         }
 
-        hd.end_of_file = ftell (fp);
+        hd.end_of_file = tell_db ();
 
         /*  Close the file and reopen it to index the records again.  */
-        close_tide_db ();
-        open_tide_db (filename);
+        reopen_tide_db ();
     }
 
     /*  The easy way.  No change to the record size.  */
@@ -5426,9 +7458,7 @@ NV_BOOL update_tide_record (NV_INT32 num, TIDE_RECORD *rec, DB_HEADER_PUBLIC *db
         /* DWF: agree, same size record does not imply that name length
            is identical. */
 	if (strcmp(tindex[num].name, rec->header.name) != 0) {
-	  free(tindex[num].name);
-	  tindex[num].name = (NV_CHAR *) calloc (strlen (rec->header.name) + 1, sizeof (NV_CHAR));
-	  strcpy(tindex[num].name, rec->header.name);
+	  tindex[num].name = arena_strdup (rec->header.name);
 	}
     }
 
@@ -5550,3 +7580,131 @@ NV_BOOL infer_constituents (TIDE_RECORD *rec)
 
     return (NVTrue);
 }
+
+
+/*****************************************************************************\
+
+    Function        enable_tide_db_stats - turns the performance statistics
+                    on or off
+
+    Synopsis        enable_tide_db_stats (enable);
+
+                    NV_BOOL enable          NVTrue to start counting
+
+    Returns         void
+
+    Date            2026-10-19
+
+    The totals are kept while the statistics are off; use
+    reset_tide_db_stats to clear them.
+
+\*****************************************************************************/
+
+void enable_tide_db_stats (NV_BOOL enable)
+{
+    stats_enabled = enable;
+}
+
+
+/*****************************************************************************\
+
+    Function        get_tide_db_stats - takes a snapshot of the performance
+                    statistics
+
+    Synopsis        get_tide_db_stats (snapshot);
+
+                    TIDE_DB_STATS *snapshot statistics (out)
+
+    Returns         NV_BOOL                 NVTrue if the statistics are on
+
+    Date            2026-10-19
+
+\*****************************************************************************/
+
+NV_BOOL get_tide_db_stats (TIDE_DB_STATS *snapshot)
+{
+    assert (snapshot);
+    *snapshot = stats;
+    return stats_enabled;
+}
+
+
+/*****************************************************************************\
+
+    Function        reset_tide_db_stats - zeroes the performance statistics
+
+    Synopsis        reset_tide_db_stats ();
+
+    Returns         void
+
+    Date            2026-10-19
+
+\*****************************************************************************/
+
+void reset_tide_db_stats ()
+{
+    memset (&stats, 0, sizeof (stats));
+}
+
+
+/*****************************************************************************\
+
+    Function        dump_tide_db_stats - prints the performance statistics
+                    to stderr
+
+    Synopsis        dump_tide_db_stats ();
+
+    Returns         void
+
+    Date            2026-10-19
+
+    Each latency line gives the call count, the mean and maximum in
+    microseconds, and the non-empty histogram buckets as
+    "<upper bound in ns>:<count>".
+
+\*****************************************************************************/
+
+void dump_tide_db_stats ()
+{
+    static const NV_CHAR    *names[TIDE_STATS_ENTRY_POINTS] =
+    {
+        "read_tide_record",
+        "read_tide_records",
+        "search_station",
+        "find_station",
+        "find_<table>",
+        "get_nearest_partial_tide_record",
+        "add_tide_record"
+    };
+    TIDE_DB_LATENCY         *lat;
+    NV_U_INT32              i, j;
+
+    fprintf (stderr, "libtcd stats: %llu bytes read, %llu seeks, "
+        "%llu records decoded, %llu cache hits, %llu cache misses\n",
+        (unsigned long long) stats.bytes_read,
+        (unsigned long long) stats.seeks,
+        (unsigned long long) stats.records_decoded,
+        (unsigned long long) stats.cache_hits,
+        (unsigned long long) stats.cache_misses);
+    fprintf (stderr, "libtcd stats: %llu opens, %.3f ms in open, "
+        "%.3f ms building the index\n",
+        (unsigned long long) stats.opens, stats.open_ns / 1.0e6,
+        stats.index_build_ns / 1.0e6);
+
+    for (i = 0 ; i < TIDE_STATS_ENTRY_POINTS ; ++i)
+    {
+        lat = &stats.latency[i];
+        if (!lat->calls) continue;
+
+        fprintf (stderr, "libtcd stats: %s: %llu calls, mean %.3f us, "
+            "max %.3f us, histogram", names[i],
+            (unsigned long long) lat->calls,
+            (NV_FLOAT64) lat->total_ns / lat->calls / 1.0e3,
+            lat->max_ns / 1.0e3);
+        for (j = 0 ; j < TIDE_STATS_BUCKETS ; ++j)
+            if (lat->histogram[j])
+                fprintf (stderr, " %llu:%llu", 2ULL << j,
+                    (unsigned long long) lat->histogram[j]);
+        fprintf (stderr, "\n");
+    }
+}
@@ -45,6 +45,8 @@
 #define DEFAULT_LONGITUDE_SCALE                     100000
 #define DEFAULT_RECORD_SIZE_BITS                    16
 #define DEFAULT_STATION_BITS                        18
+#define DEFAULT_LARGE_RECORD_SIZE_BITS              24
+#define DEFAULT_LARGE_STATION_BITS                  31
 #define DEFAULT_DATUM_OFFSET_BITS                   28
 #define DEFAULT_DATUM_OFFSET_SCALE                  10000
 #define DEFAULT_DATE_BITS                           27
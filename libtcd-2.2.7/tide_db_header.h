@@ -62,6 +62,7 @@ typedef struct
         NV_CHAR                *cstr;
         NV_INT32               *i32;
         NV_U_INT32             *ui32;
+        NV_U_INT64             *ui64;
     } address;
 } KEY;
 
@@ -133,7 +134,7 @@ typedef struct
     NV_U_INT32        country_size;
     NV_U_INT32        datum_size;
     NV_U_INT32        legalese_size;
-    NV_U_INT32        end_of_file;
+    NV_U_INT64        end_of_file;
 
     /* Need these to read V1 files. */
     NV_U_INT32        pedigree_bits;
@@ -482,7 +483,7 @@ static KEY                     keys[] =
     },
     {
         "[END OF FILE]",
-        "ui32",
+        "ui64",
         {(NV_CHAR *) &hd.end_of_file},
     }
 };
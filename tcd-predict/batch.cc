@@ -0,0 +1,255 @@
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include "TcdPredict"
+
+
+namespace TcdPredict {
+
+
+  static const char magic[8] = {'T','C','D','S','E','R','0','1'};
+  static const uint32_t byteOrderMark = 0x01020304;
+  static const size_t headerSize = 64, entrySize = 32;
+
+  // Series start on a page boundary and are written this many samples
+  // at a time.
+  static const uint64_t seriesAlign = 4096;
+  static const size_t block = 65536;
+
+
+  static void writeAll (int fd, const void *buf, size_t size, uint64_t offset,
+                        const std::string &filename) {
+    const char *p ((const char *)buf);
+    while (size) {
+      const ssize_t n (pwrite (fd, p, size, offset));
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        throw Error ("can't write " + filename + ": " + strerror (errno));
+      }
+      p += n;
+      size -= n;
+      offset += n;
+    }
+  }
+
+
+  template <class T> static void put (std::vector<char> &buf, size_t pos,
+                                      T value) {
+    memcpy (&buf[pos], &value, sizeof value);
+  }
+
+
+  // One worker's share of the stations, the indices [first, last),
+  // packed into one word so that the owner taking from the front and
+  // thieves taking half from the back can each do so with a single
+  // compare-and-swap.  An index is handed out only once, so a range
+  // never recurs and there is no ABA problem.
+  struct alignas(64) Share {
+    std::atomic<uint64_t> range;
+
+    static uint64_t pack (uint32_t first, uint32_t last) {
+      return (uint64_t)first << 32 | last;
+    }
+
+    bool take (uint32_t &index) {
+      uint64_t r (range.load());
+      for (;;) {
+        const uint32_t first (r >> 32), last (r);
+        if (first >= last)
+          return false;
+        if (range.compare_exchange_weak (r, pack (first + 1, last))) {
+          index = first;
+          return true;
+        }
+      }
+    }
+
+    // Moves the back half of victim's range, rounded up, to this
+    // share, which must be empty.
+    bool stealFrom (Share &victim) {
+      uint64_t r (victim.range.load());
+      for (;;) {
+        const uint32_t first (r >> 32), last (r);
+        if (first >= last)
+          return false;
+        const uint32_t split (last - (last - first + 1) / 2);
+        if (victim.range.compare_exchange_weak (r, pack (first, split))) {
+          range.store (pack (split, last));
+          return true;
+        }
+      }
+    }
+  };
+
+
+  std::map<int32_t, std::string>
+  writeSeriesFile (const std::string &filename, const Database &db,
+                   const std::vector<Station> &stations,
+                   const std::vector<Subordinate> &subordinates,
+                   Time start, int64_t step, size_t count,
+                   unsigned threads) {
+    // The subordinates of each reference station, by index.
+    std::map<int32_t, uint32_t> indexOf;
+    for (uint32_t i (0); i < stations.size(); ++i)
+      indexOf[stations[i].record] = i;
+    std::vector<std::vector<uint32_t> > dependents (stations.size());
+    for (uint32_t j (0); j < subordinates.size(); ++j) {
+      const auto found (indexOf.find (subordinates[j].reference));
+      if (found == indexOf.end())
+        throw Error ("the reference station of " + subordinates[j].name +
+                     " is not being written");
+      dependents[found->second].push_back (j);
+    }
+
+    if (!threads)
+      threads = std::max (1U, std::thread::hardware_concurrency());
+    threads = std::min<size_t> (threads, std::max<size_t> (1, stations.size()));
+
+    // Header, station table, and names.
+    const size_t total (stations.size() + subordinates.size());
+    const uint64_t tableOffset (headerSize),
+                   namesOffset (tableOffset + entrySize * total);
+    std::vector<char> head (namesOffset);
+    memcpy (&head[0], magic, sizeof magic);
+    put (head, 8, byteOrderMark);
+    put (head, 12, (uint32_t)total);
+    put (head, 16, (int64_t)start);
+    put (head, 24, (int64_t)step);
+    put (head, 32, (uint64_t)count);
+    put (head, 40, tableOffset);
+    auto addEntry = [&] (size_t i, int32_t record, double datumOffset,
+                         double latitude, double longitude,
+                         const std::string &name, const std::string &units,
+                         int32_t reference) {
+      const size_t entry (tableOffset + entrySize * i);
+      put (head, entry, record);
+      put (head, entry + 4, (float)datumOffset);
+      put (head, entry + 8, latitude);
+      put (head, entry + 16, longitude);
+      put (head, entry + 24, (uint32_t)(head.size() - namesOffset));
+      put (head, entry + 28, reference);
+      head.insert (head.end(), name.begin(), name.end());
+      head.push_back ('\0');
+      head.insert (head.end(), units.begin(), units.end());
+      head.push_back ('\0');
+    };
+    for (size_t i (0); i < stations.size(); ++i) {
+      const Station &s (stations[i]);
+      addEntry (i, s.record, s.datumOffset, s.latitude, s.longitude, s.name,
+                s.units, -1);
+    }
+    for (size_t j (0); j < subordinates.size(); ++j) {
+      const Subordinate &s (subordinates[j]);
+      addEntry (stations.size() + j, s.record, 0.0, s.latitude, s.longitude,
+                s.name, s.units, s.reference);
+    }
+    const uint64_t seriesOffset ((head.size() + seriesAlign - 1) /
+                                 seriesAlign * seriesAlign);
+    put (head, 48, seriesOffset);
+
+    const int fd (open (filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666));
+    if (fd < 0)
+      throw Error ("can't create " + filename + ": " + strerror (errno));
+    std::mutex stationsLock;
+    std::map<int32_t, std::string> failedStations;
+    try {
+      writeAll (fd, head.data(), head.size(), 0, filename);
+
+      std::vector<Share> shares (threads);
+      for (unsigned t (0); t < threads; ++t)
+        shares[t].range.store (Share::pack (
+          stations.size() * t / threads, stations.size() * (t + 1) / threads));
+      std::atomic<bool> failed (false);
+      std::string failure;
+
+      const Time last (start + (Time)(count ? count - 1 : 0) * step);
+      auto work = [&] (unsigned me) {
+        std::vector<double> heights (std::min (block, count));
+        std::vector<float> samples (heights.size());
+        ReferenceCache cache (db, std::min (start, last),
+                              std::max (start, last));
+        // Computes a station's series a block at a time and writes it,
+        // as NaN from the first block that fails to predict.
+        auto write = [&] (size_t index, int32_t record,
+                          const std::function<void (Time, size_t, double *)>
+                            &predict) {
+          uint64_t offset (seriesOffset + (uint64_t)index * count * 4);
+          bool ok (true);
+          for (size_t done (0); done < count; ) {
+            const size_t n (std::min (block, count - done));
+            if (ok)
+              try {
+                predict (start + (Time)done * step, n, heights.data());
+              } catch (const Error &e) {
+                ok = false;
+                std::lock_guard<std::mutex> lock (stationsLock);
+                failedStations[record] = e.what();
+              }
+            if (!ok)
+              std::fill (heights.begin(), heights.begin() + n, NAN);
+            std::copy (heights.begin(), heights.begin() + n, samples.begin());
+            writeAll (fd, samples.data(), n * 4, offset, filename);
+            offset += n * 4;
+            done += n;
+          }
+        };
+        uint32_t index;
+        try {
+          for (;;) {
+            if (!shares[me].take (index)) {
+              bool stole (false);
+              for (unsigned v (1); v < threads && !stole; ++v)
+                stole = shares[me].stealFrom (shares[(me + v) % threads]);
+              if (!stole)
+                return;
+              continue;
+            }
+            if (failed)
+              return;
+            Predictor predictor (db, stations[index]);
+            write (index, stations[index].record,
+                   [&] (Time t, size_t n, double *out) {
+                     predictor.series (t, step, n, out);
+                   });
+            for (uint32_t j: dependents[index])
+              write (stations.size() + j, subordinates[j].record,
+                     [&] (Time t, size_t n, double *out) {
+                       cache.series (subordinates[j], t, step, n, out);
+                     });
+            cache.clear ();
+          }
+        } catch (const Error &e) {
+          if (!failed.exchange (true))
+            failure = e.what();
+        }
+      };
+      std::vector<std::thread> pool;
+      for (unsigned t (1); t < threads; ++t)
+        pool.emplace_back (work, t);
+      work (0);
+      for (std::thread &thread: pool)
+        thread.join ();
+      if (failed)
+        throw Error (failure);
+    } catch (...) {
+      close (fd);
+      throw;
+    }
+    if (close (fd))
+      throw Error ("can't write " + filename + ": " + strerror (errno));
+    return failedStations;
+  }
+
+}
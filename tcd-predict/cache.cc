@@ -0,0 +1,131 @@
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+#include "TcdPredict"
+
+
+namespace TcdPredict {
+
+
+  // What the table and list spend on an entry, roughly.
+  static const size_t entryOverhead = 96;
+
+
+  static size_t stationBytes (const Station &station) {
+    return sizeof station + station.name.capacity() +
+      station.units.capacity() +
+      station.constituent.capacity() * sizeof (uint32_t) +
+      (station.amplitude.capacity() + station.epoch.capacity()) *
+      sizeof (double);
+  }
+
+
+  CoefficientCache::CoefficientCache (const Database &db, size_t capacity):
+    db_ (db),
+    capacity_ (capacity),
+    bytes_ (0),
+    stations_ (0),
+    hits_ (0),
+    misses_ (0),
+    evictions_ (0) {
+  }
+
+
+  // With lock_ held.  Counts the lookup and moves a hit to the front.
+  const CoefficientCache::Entry *CoefficientCache::find (uint64_t k) {
+    const auto found (entries_.find (k));
+    if (found == entries_.end()) {
+      ++misses_;
+      return nullptr;
+    }
+    ++hits_;
+    lru_.splice (lru_.begin(), lru_, found->second.lru);
+    return &found->second;
+  }
+
+
+  // With lock_ held.  Another thread may have built the same entry
+  // meanwhile, in which case that one is kept.  Then evicts from the
+  // back until the rest fits, sparing the new entry.
+  const CoefficientCache::Entry &CoefficientCache::insert (uint64_t k,
+                                                           Entry &&entry) {
+    const auto inserted (entries_.emplace (k, std::move (entry)));
+    Entry &e (inserted.first->second);
+    if (!inserted.second)
+      return e;
+    e.bytes += entryOverhead;
+    lru_.push_front (k);
+    e.lru = lru_.begin();
+    bytes_ += e.bytes;
+    stations_ += (bool)e.station;
+    while (bytes_ > capacity_ && lru_.size() > 1) {
+      const auto victim (entries_.find (lru_.back()));
+      bytes_ -= victim->second.bytes;
+      stations_ -= (bool)victim->second.station;
+      entries_.erase (victim);
+      lru_.pop_back ();
+      ++evictions_;
+    }
+    return e;
+  }
+
+
+  // Records are read and years folded without holding lock_, so that
+  // one miss doesn't stall the threads that hit.
+  std::shared_ptr<const Station> CoefficientCache::station (int32_t record) {
+    const uint64_t k (key (record, noYear));
+    {
+      std::lock_guard<std::mutex> lock (lock_);
+      if (const Entry *e = find (k))
+        return e->station;
+    }
+    Entry entry;
+    entry.station = std::make_shared<const Station> (db_.loadStation (record));
+    entry.bytes = stationBytes (*entry.station);
+    std::lock_guard<std::mutex> lock (lock_);
+    return insert (k, std::move (entry)).station;
+  }
+
+
+  std::shared_ptr<const Folded> CoefficientCache::folded (int32_t record,
+                                                          int year) {
+    const uint64_t k (key (record, year));
+    {
+      std::lock_guard<std::mutex> lock (lock_);
+      if (const Entry *e = find (k))
+        return e->folded;
+    }
+    const std::shared_ptr<const Station> s (station (record));
+    Entry entry;
+    entry.folded = foldYear (db_, *s, year);
+    entry.bytes = entry.folded->bytes();
+    std::lock_guard<std::mutex> lock (lock_);
+    return insert (k, std::move (entry)).folded;
+  }
+
+
+  CoefficientCache::Stats CoefficientCache::stats () const {
+    std::lock_guard<std::mutex> lock (lock_);
+    Stats stats;
+    stats.bytes = bytes_;
+    stats.capacity = capacity_;
+    stats.stations = stations_;
+    stats.folds = entries_.size() - stations_;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    return stats;
+  }
+
+
+  void CoefficientCache::clear () {
+    std::lock_guard<std::mutex> lock (lock_);
+    entries_.clear ();
+    lru_.clear ();
+    bytes_ = stations_ = 0;
+  }
+
+}
@@ -0,0 +1,288 @@
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+#include <string.h>
+#include <tcd.h>
+#include "TcdPredict"
+
+
+namespace TcdPredict {
+
+
+  Database::Database (const std::string &filename):
+    filename_ (filename) {
+    if (!open_tide_db (filename.c_str()))
+      throw Error ("can't open " + filename);
+    const DB_HEADER_PUBLIC db (get_tide_db_header());
+    numRecords_ = db.number_of_records;
+    firstYear_ = db.start_year;
+    speed_.resize (db.constituents);
+    name_.resize (db.constituents);
+    for (uint32_t c (0); c < db.constituents; ++c) {
+      speed_[c] = get_speed (c) / 360.0;
+      name_[c] = get_constituent (c);
+    }
+    std::vector<std::atomic<Year *> > years (db.number_of_years);
+    years_.swap (years);
+    for (auto &y: years_)
+      y.store (nullptr, std::memory_order_relaxed);
+  }
+
+
+  Database::~Database () {
+    for (auto &y: years_)
+      delete y.load (std::memory_order_relaxed);
+    close_tide_db ();
+  }
+
+
+  // Decoded years are published with a release store so that a thread
+  // that sees the pointer also sees the tables it points to; after that
+  // first decode, looking a year up takes no lock.
+  const Database::Year &Database::year (int y) const {
+    if (y < firstYear_ || y > lastYear())
+      throw Error (filename_ + " has no tables for " + std::to_string (y) +
+                   " (covers " + std::to_string (firstYear_) + " through " +
+                   std::to_string (lastYear()) + ")");
+    std::atomic<Year *> &slot (years_[y - firstYear_]);
+    Year *year (slot.load (std::memory_order_acquire));
+    if (year)
+      return *year;
+
+    std::lock_guard<std::mutex> lock (tcdLock_);
+    year = slot.load (std::memory_order_relaxed);
+    if (!year) {
+      year = new Year;
+      const uint32_t n (numConstituents());
+      year->arg.resize (n);
+      year->nodeFactor.resize (n);
+      for (uint32_t c (0); c < n; ++c) {
+        year->arg[c] = get_equilibrium (c, y - firstYear_) / 360.0;
+        year->nodeFactor[c] = get_node_factor (c, y - firstYear_);
+      }
+      slot.store (year, std::memory_order_release);
+    }
+    return *year;
+  }
+
+
+  // Harmonic constants of a reference station record.
+  static void toStation (const TIDE_RECORD &rec,
+                         const std::vector<double> &speed,
+                         Station &station) {
+    station.record = rec.header.record_number;
+    station.name = rec.header.name;
+    station.latitude = rec.header.latitude;
+    station.longitude = rec.header.longitude;
+    station.units = get_level_units (rec.level_units);
+    station.datumOffset = rec.datum_offset;
+
+    // Epochs in the file are referred to the station's time meridian,
+    // zone_offset (±HHMM).  κ referred to UTC is κ − speed × offset.
+    const double zoneHours (rec.zone_offset / 100 +
+                            rec.zone_offset % 100 / 60.0);
+    for (uint32_t c (0); c < speed.size(); ++c)
+      if (rec.amplitude[c] != 0.0) {
+        station.constituent.push_back (c);
+        station.amplitude.push_back (rec.amplitude[c]);
+        station.epoch.push_back (rec.epoch[c] / 360.0 - speed[c] * zoneHours);
+      }
+  }
+
+
+  void Database::checkRecord (int32_t record) const {
+    if (record < 0 || (uint32_t)record >= numRecords_)
+      throw Error ("no record " + std::to_string (record) + " in " +
+                   filename_);
+  }
+
+
+  Station Database::loadStation (int32_t record) const {
+    checkRecord (record);
+    static TIDE_RECORD rec;   // too big for the stack; guarded by tcdLock_
+    Station station;
+    std::lock_guard<std::mutex> lock (tcdLock_);
+    if (read_tide_record (record, &rec) != record)
+      throw Error ("can't read record " + std::to_string (record) + " of " +
+                   filename_);
+    if (rec.header.record_type != REFERENCE_STATION)
+      throw Error (std::string (rec.header.name) +
+                   " is a subordinate station");
+    toStation (rec, speed_, station);
+    return station;
+  }
+
+
+  struct LoadStations {
+    const std::vector<double> *speed;
+    std::vector<Station> *stations;       // indexed by record number
+    std::vector<char> *loaded;            // likewise
+  };
+
+  // Called concurrently for different records, so it touches only
+  // their own slots.
+  static NV_BOOL loadStationVisitor (const TIDE_RECORD *rec, void *data) {
+    const LoadStations &load (*(const LoadStations *)data);
+    const int32_t record (rec->header.record_number);
+    toStation (*rec, *load.speed, (*load.stations)[record]);
+    (*load.loaded)[record] = 1;
+    return NVTrue;
+  }
+
+
+  std::vector<Station> Database::loadStations (unsigned threads) const {
+    std::vector<Station> byRecord (numRecords_);
+    std::vector<char> loaded (numRecords_);
+    LoadStations load = {&speed_, &byRecord, &loaded};
+    TIDE_RECORD_FILTER filter = {REFERENCE_STATION, -1, -1, NVFalse,
+                                 0.0, 0.0, 0.0, 0.0};
+    {
+      std::lock_guard<std::mutex> lock (tcdLock_);
+      if (iterate_tide_records (&filter, TIDE_FIELDS_CONSTITUENTS, threads,
+                                NVFalse, loadStationVisitor, &load) < 0)
+        throw Error ("can't read the stations of " + filename_);
+    }
+    std::vector<Station> stations;
+    for (uint32_t i (0); i < numRecords_; ++i)
+      if (loaded[i])
+        stations.push_back (std::move (byRecord[i]));
+    return stations;
+  }
+
+
+  // Time offsets in the file are ±HHMM, like zone offsets.
+  static Time offsetSeconds (int32_t hhmm) {
+    return (Time)(hhmm / 100) * 3600 + hhmm % 100 * 60;
+  }
+
+
+  static double multiply (double m) {
+    return m == 0.0 ? 1.0 : m;
+  }
+
+
+  // Offsets of a subordinate station record.
+  static void toSubordinate (const TIDE_RECORD &rec, Subordinate &sub) {
+    sub.record = rec.header.record_number;
+    sub.name = rec.header.name;
+    sub.latitude = rec.header.latitude;
+    sub.longitude = rec.header.longitude;
+    sub.units = get_level_units (rec.level_units);
+    sub.current = !sub.units.compare (0, 5, "knots");
+    sub.reference = rec.header.reference_station;
+    sub.minTimeAdd = offsetSeconds (rec.min_time_add);
+    sub.maxTimeAdd = offsetSeconds (rec.max_time_add);
+    sub.minLevelMultiply = multiply (rec.min_level_multiply);
+    sub.maxLevelMultiply = multiply (rec.max_level_multiply);
+    sub.minLevelAdd = rec.min_level_add;
+    sub.maxLevelAdd = rec.max_level_add;
+  }
+
+
+  Subordinate Database::loadSubordinate (int32_t record) const {
+    checkRecord (record);
+    static TIDE_RECORD rec;   // guarded by tcdLock_
+    Subordinate sub;
+    std::lock_guard<std::mutex> lock (tcdLock_);
+    if (read_tide_record (record, &rec) != record)
+      throw Error ("can't read record " + std::to_string (record) + " of " +
+                   filename_);
+    if (rec.header.record_type != SUBORDINATE_STATION)
+      throw Error (std::string (rec.header.name) +
+                   " is not a subordinate station");
+    toSubordinate (rec, sub);
+    return sub;
+  }
+
+
+  struct LoadSubordinates {
+    std::vector<Subordinate> *subordinates;     // indexed by record number
+    std::vector<char> *loaded;                  // likewise
+  };
+
+  static NV_BOOL loadSubordinateVisitor (const TIDE_RECORD *rec, void *data) {
+    const LoadSubordinates &load (*(const LoadSubordinates *)data);
+    const int32_t record (rec->header.record_number);
+    toSubordinate (*rec, (*load.subordinates)[record]);
+    (*load.loaded)[record] = 1;
+    return NVTrue;
+  }
+
+
+  std::vector<Subordinate> Database::loadSubordinates (unsigned threads)
+    const {
+    std::vector<Subordinate> byRecord (numRecords_);
+    std::vector<char> loaded (numRecords_);
+    LoadSubordinates load = {&byRecord, &loaded};
+    TIDE_RECORD_FILTER filter = {SUBORDINATE_STATION, -1, -1, NVFalse,
+                                 0.0, 0.0, 0.0, 0.0};
+    {
+      // The offsets are fixed-size fields, which are always decoded.
+      std::lock_guard<std::mutex> lock (tcdLock_);
+      if (iterate_tide_records (&filter, 0, threads, NVFalse,
+                                loadSubordinateVisitor, &load) < 0)
+        throw Error ("can't read the stations of " + filename_);
+    }
+    std::vector<Subordinate> subordinates;
+    for (uint32_t i (0); i < numRecords_; ++i)
+      if (loaded[i])
+        subordinates.push_back (std::move (byRecord[i]));
+    return subordinates;
+  }
+
+
+  void Database::buildIndex () const {
+    std::lock_guard<std::mutex> lock (tcdLock_);
+    referenceOf_.assign (numRecords_, -1);
+    subordinates_.assign (numRecords_, std::vector<int32_t>());
+    TIDE_STATION_HEADER header;
+    for (uint32_t i (0); i < numRecords_; ++i) {
+      if (!get_partial_tide_record (i, &header))
+        throw Error ("can't read record " + std::to_string (i) + " of " +
+                     filename_);
+      if (header.record_type == SUBORDINATE_STATION) {
+        if (header.reference_station < 0 ||
+            (uint32_t)header.reference_station >= numRecords_)
+          throw Error (std::string (header.name) +
+                       " has no reference station");
+        referenceOf_[i] = header.reference_station;
+        subordinates_[header.reference_station].push_back (i);
+      }
+    }
+  }
+
+
+  int32_t Database::referenceOf (int32_t record) const {
+    checkRecord (record);
+    std::call_once (indexOnce_, &Database::buildIndex, this);
+    return referenceOf_[record];
+  }
+
+
+  const std::vector<int32_t> &Database::subordinatesOf (int32_t reference)
+    const {
+    checkRecord (reference);
+    std::call_once (indexOnce_, &Database::buildIndex, this);
+    return subordinates_[reference];
+  }
+
+
+  int32_t Database::findStation (const std::string &name) const {
+    std::lock_guard<std::mutex> lock (tcdLock_);
+    int32_t record (find_station (name.c_str()));
+    if (record < 0) {
+      TIDE_STATION_HEADER header;
+      for (uint32_t i (0); i < numRecords_; ++i)
+        if (get_partial_tide_record (i, &header) &&
+            strstr (header.name, name.c_str())) {
+          record = i;
+          break;
+        }
+    }
+    return record;
+  }
+
+}
@@ -0,0 +1,115 @@
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "TcdPredict"
+
+
+namespace TcdPredict {
+
+
+  // Events and hourly heights are taken this many seconds at a time, so
+  // that memory doesn't grow with the length of the epoch.
+  static const Time chunk = 366 * 86400;
+
+
+  // Running mean of one kind of extremum, plus the extreme of each day.
+  class DayExtremes {
+  public:
+    DayExtremes (bool high): high_ (high), day_ (-1), sum_ (0.0), count_ (0),
+      daySum_ (0.0), days_ (0), extreme_ (high ? -HUGE_VAL : HUGE_VAL) {}
+
+    void add (int64_t day, double height) {
+      if (day != day_) {
+        flush ();
+        day_ = day;
+        dayExtreme_ = height;
+      } else if (high_ ? height > dayExtreme_ : height < dayExtreme_)
+        dayExtreme_ = height;
+      sum_ += height;
+      ++count_;
+      extreme_ = high_ ? std::max (extreme_, height)
+                       : std::min (extreme_, height);
+    }
+
+    void flush () {
+      if (day_ >= 0) {
+        daySum_ += dayExtreme_;
+        ++days_;
+      }
+      day_ = -1;
+    }
+
+    int64_t day () const { return day_; }
+    Datum mean () const { return mean (sum_, count_); }
+    Datum dayMean () const { return mean (daySum_, days_); }
+    Datum extreme () const {
+      Datum datum = {days_ ? extreme_ : NAN, days_};
+      return datum;
+    }
+
+  private:
+    static Datum mean (double sum, uint64_t count) {
+      Datum datum = {count ? sum / count : NAN, count};
+      return datum;
+    }
+
+    const bool high_;
+    int64_t day_;
+    double dayExtreme_;
+    double sum_;
+    uint64_t count_;
+    double daySum_;
+    uint64_t days_;
+    double extreme_;
+  };
+
+
+  Datums computeDatums (Predictor &predictor, Time begin, Time end,
+                        int64_t dayLength) {
+    DayExtremes highs (true), lows (false);
+    uint64_t bothDays (0);
+    double heightSum (0.0);
+    uint64_t hours (0);
+    std::vector<double> heights;
+
+    for (Time from (begin); from < end; from += chunk) {
+      const Time to (std::min (end, from + chunk));
+      for (const Event &event: predictor.events (from, to)) {
+        const int64_t day ((event.time - begin) / dayLength);
+        DayExtremes &same (event.high ? highs : lows),
+                    &other (event.high ? lows : highs);
+        // A day has both once the second kind first appears in it.
+        if (same.day () != day && other.day () == day)
+          ++bothDays;
+        same.add (day, event.height);
+      }
+      // chunk is whole hours, so from is on the hourly grid.
+      heights.resize ((to - 1 - from) / 3600 + 1);
+      predictor.series (from, 3600, heights.size(), heights.data());
+      for (double height: heights)
+        heightSum += height;
+      hours += heights.size();
+    }
+    highs.flush ();
+    lows.flush ();
+
+    Datums datums;
+    datums.HAT = highs.extreme ();
+    datums.MHHW = highs.dayMean ();
+    datums.MHW = highs.mean ();
+    datums.MSL.value = hours ? heightSum / hours : NAN;
+    datums.MSL.count = hours;
+    datums.MLW = lows.mean ();
+    datums.MLLW = lows.dayMean ();
+    datums.LAT = lows.extreme ();
+    datums.MTL.value = (datums.MHW.value + datums.MLW.value) / 2.0;
+    datums.MTL.count = bothDays;
+    return datums;
+  }
+
+}
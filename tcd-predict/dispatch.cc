@@ -0,0 +1,93 @@
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+// Compiled for the baseline instruction set, like everything but the
+// kernels, since it runs before any choice is made.
+
+#include <stdlib.h>
+#include <string.h>
+#include "TcdPredict"
+#include "kernels.hh"
+
+
+namespace TcdPredict {
+
+
+  // The sets in this build, best first.
+  static const Kernels *const built[] = {
+#ifdef HAVE_KERNELS_AVX512
+    &avx512Kernels,
+#endif
+#ifdef HAVE_KERNELS_AVX2
+    &avx2Kernels,
+#endif
+    &baselineKernels,
+    &scalarKernels
+  };
+
+
+  // Whether the processor (and the operating system, which must save
+  // the wider registers) can run a set.  GCC's and Clang's
+  // __builtin_cpu_supports check both.
+  static bool runs (const Kernels *k) {
+#ifdef HAVE_KERNELS_AVX512
+    if (k == &avx512Kernels)
+      return __builtin_cpu_supports ("avx512f");
+#endif
+#ifdef HAVE_KERNELS_AVX2
+    if (k == &avx2Kernels)
+      return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+#endif
+    return k != nullptr;
+  }
+
+
+  static std::atomic<const Kernels *> current (nullptr);
+
+
+  const Kernels &kernels () {
+    const Kernels *k (current.load (std::memory_order_acquire));
+    if (k)
+      return *k;
+    for (const Kernels *b: built)
+      if (runs (b)) {
+        k = b;
+        break;
+      }
+    const char *name (getenv ("TCDPREDICT_KERNELS"));
+    if (name)
+      for (const Kernels *b: built)
+        if (runs (b) && !strcmp (b->name, name))
+          k = b;
+    current.store (k, std::memory_order_release);
+    return *k;
+  }
+
+
+  std::vector<std::string> kernelSets () {
+    std::vector<std::string> names;
+    for (const Kernels *b: built)
+      if (runs (b))
+        names.push_back (b->name);
+    return names;
+  }
+
+
+  std::string kernelSet () {
+    return kernels().name;
+  }
+
+
+  bool selectKernelSet (const std::string &name) {
+    for (const Kernels *b: built)
+      if (runs (b) && name == b->name) {
+        current.store (b, std::memory_order_release);
+        return true;
+      }
+    return false;
+  }
+
+}
@@ -0,0 +1,182 @@
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "TcdPredict"
+#include "kernels.hh"
+
+
+namespace TcdPredict {
+
+
+  // Extrema are located to within this many hours (about 0.1 s), well
+  // under the one-second resolution of Event::time.  The turning points
+  // used to split brackets need less.
+  static const double eventTolerance = 3e-5, splitTolerance = 1e-3;
+
+  // A constituent counts toward the scan step if its share of the
+  // curvature, f·A·speed², is at least this fraction of the largest.
+  static const double significant = 0.01;
+
+
+  void Predictor::derivatives (double hours, double d[5]) const {
+    sumCosDerivatives (amp_, speed_, phase_, padded_,
+                       hours, d);
+  }
+
+
+  // In hours.  No constituent that matters turns over more than once
+  // within a step.
+  double Predictor::scanStep () const {
+    double maxCurvature (0.0), fastest (0.0);
+    for (size_t i (0); i < padded_; ++i)
+      maxCurvature = std::max (maxCurvature,
+                               fabs (amp_[i]) * speed_[i] * speed_[i]);
+    for (size_t i (0); i < padded_; ++i)
+      if (fabs (amp_[i]) * speed_[i] * speed_[i] >=
+          significant * maxCurvature)
+        fastest = std::max (fastest, speed_[i]);
+    return fastest > 0.0 ? 1.0 / (8.0 * fastest) : 1.0;
+  }
+
+
+  // The zero of derivative number order (1 to 3) in [a, b], where it
+  // has opposite signs at the ends; da and db are the derivatives
+  // there.  The search starts from the false-position point.  Newton
+  // steps that would leave the bracket, or that don't shrink it fast
+  // enough, are replaced by bisection.
+  double Predictor::refine (int order, double a, double b,
+                            const double da[5], const double db[5],
+                            double tolerance) const {
+    const double fa (da[order]), fb (db[order]);
+    double x (fa != fb ? a - fa * (b - a) / (fb - fa) : 0.5 * (a + b));
+    if (fa > 0.0)
+      std::swap (a, b);         // now the derivative is ≤ 0 at a
+    double dxOld (fabs (b - a)), dx (dxOld), d[5];
+    for (int i (0); i < 60; ++i) {
+      derivatives (x, d);
+      if (d[order] < 0.0)
+        a = x;
+      else
+        b = x;
+      const double slope (d[order+1]);
+      if (slope == 0.0 ||
+          ((x - a) * slope - d[order]) * ((x - b) * slope - d[order]) > 0.0 ||
+          fabs (2.0 * d[order]) > fabs (dxOld * slope)) {
+        dxOld = dx;
+        dx = 0.5 * (b - a);
+        x = a + dx;
+      } else {
+        dxOld = dx;
+        dx = d[order] / slope;
+        x -= dx;
+      }
+      if (fabs (dx) < tolerance)
+        break;
+    }
+    return x;
+  }
+
+
+  static bool negative (double x) {
+    return x < 0.0;
+  }
+
+
+  // Appends the zeros of the first derivative in [a, b] to roots, in
+  // order.  maxCurvature bounds the second derivative.
+  void Predictor::extrema (double a, double b, const double da[5],
+                           const double db[5], double maxCurvature,
+                           std::vector<double> &roots) const {
+    // Over most of the tide the slope is too steep to reach zero within
+    // the bracket, and there is nothing more to look at.
+    if (fabs (da[1]) + fabs (db[1]) > maxCurvature * (b - a))
+      return;
+    if (negative (da[3]) != negative (db[3])) {
+      // The second derivative turns inside; split there.
+      const double m (refine (3, a, b, da, db, splitTolerance));
+      if (m > a && m < b) {
+        double dm[5];
+        derivatives (m, dm);
+        extrema (a, m, da, dm, maxCurvature, roots);
+        extrema (m, b, dm, db, maxCurvature, roots);
+        return;
+      }
+    }
+    // The second derivative is monotone, so the first has at most one
+    // turning point and at most two zeros.
+    if (negative (da[1]) != negative (db[1]))
+      roots.push_back (refine (1, a, b, da, db, eventTolerance));
+    else if (negative (da[2]) != negative (db[2])) {
+      const double m (refine (2, a, b, da, db, splitTolerance));
+      double dm[5];
+      derivatives (m, dm);
+      if (negative (dm[1]) != negative (da[1])) {
+        roots.push_back (refine (1, a, m, da, dm, eventTolerance));
+        roots.push_back (refine (1, m, b, dm, db, eventTolerance));
+      }
+    }
+  }
+
+
+  std::vector<Event> Predictor::events (Time begin, Time end) {
+    std::vector<Event> found;
+    std::vector<double> roots;
+    for (Time segment (begin); segment < end; ) {
+      fold (yearOf (segment));
+      const Time segmentEnd (std::min (end, yearStart (year_ + 1)));
+      const double first ((segment - yearStart_) / 3600.0),
+                   last ((segmentEnd - yearStart_) / 3600.0),
+                   step (scanStep ());
+      double maxCurvature (0.0);
+      for (size_t i (0); i < padded_; ++i) {
+        const double w (2.0 * M_PI * speed_[i]);
+        maxCurvature += fabs (amp_[i]) * w * w;
+      }
+
+      // The scan points are evenly spaced, so the derivatives there come
+      // from rotating phasors, re-anchored as in series().  The last
+      // point, at the end of the segment, is evaluated directly.
+      roots.clear ();
+      const size_t steps (ceil ((last - first) / step));
+      double da[5], db[5];
+      derivatives (first, da);
+      for (size_t k (1); k <= steps; ++k) {
+        const double a (first + (k - 1) * step);
+        if (k == steps)
+          derivatives (last, db);
+        else {
+          if ((k - 1) % anchorInterval == 0)
+            anchorPhasors (amp_, speed_, phase_,
+                           padded_, first + k * step, step, re_.data(),
+                           im_.data(), rotRe_.data(), rotIm_.data());
+          phasorDerivatives (re_.data(), im_.data(), rotRe_.data(),
+                             rotIm_.data(), speed_, padded_, db);
+        }
+        extrema (a, k == steps ? last : first + k * step, da, db,
+                 maxCurvature, roots);
+        std::copy (db, db + 5, da);
+      }
+
+      for (double root: roots) {
+        const Time t (yearStart_ + llround (root * 3600.0));
+        if (t < segment || t >= segmentEnd)
+          continue;
+        double d[5];
+        derivatives (root, d);
+        Event event;
+        event.time = t;
+        event.height = station_.datumOffset + d[0];
+        event.high = d[2] < 0.0;
+        found.push_back (event);
+      }
+      segment = segmentEnd;
+    }
+    return found;
+  }
+
+}
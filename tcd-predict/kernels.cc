@@ -0,0 +1,315 @@
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+// Compiled once for each instruction set, with KERNEL_SET defined to
+// its name and the compiler flags for it (see Makefile.am).  Nothing
+// here may have external linkage except the table at the end, or the
+// linker could pick a copy built for a processor other than the one the
+// program runs on.
+
+#include "kernels.hh"
+
+#ifndef KERNEL_SET
+#define KERNEL_SET baseline
+#endif
+
+#define KERNEL_STRING2(x) #x
+#define KERNEL_STRING(x) KERNEL_STRING2 (x)
+#define KERNEL_TABLE2(x) x ## Kernels
+#define KERNEL_TABLE(x) KERNEL_TABLE2 (x)
+
+
+namespace TcdPredict {
+namespace KERNEL_SET {
+
+
+  // Adding and subtracting 1.5·2⁵² rounds a double to the nearest
+  // integer without a library call (for magnitudes below 2⁵¹).
+  static const double roundConst = 6755399441055744.0;
+  static const double twoPi = 6.283185307179586476925287;
+
+  // Minimax coefficients for sin and cos on [−π/4, π/4], from fdlibm's
+  // __kernel_sin and __kernel_cos.
+  static const double S1 = -1.66666666666666324348e-01,
+                      S2 =  8.33333333332248946124e-03,
+                      S3 = -1.98412698298579493134e-04,
+                      S4 =  2.75573137070700676789e-06,
+                      S5 = -2.50507602534068634195e-08,
+                      S6 =  1.58969099521155010221e-10;
+  static const double C1 =  4.16666666666666019037e-02,
+                      C2 = -1.38888888888741095749e-03,
+                      C3 =  2.48015872894767294178e-05,
+                      C4 = -2.75573143513906633035e-07,
+                      C5 =  2.08757232129817482790e-09,
+                      C6 = -1.13596475577881948265e-11;
+
+
+  // Reduces x (in cycles) to a whole number of quarter cycles q and a
+  // remainder r, in radians, of at most an eighth of a cycle, and
+  // evaluates cos r and sin r.  Subtracting q/4 from x is exact, so no
+  // accuracy is lost to large arguments.  Returns m = q mod 4, which is
+  // in {−2, −1, 0, 1, 2}.
+  static inline double reduce (double x, double &c, double &s) {
+    const double q = (x * 4.0 + roundConst) - roundConst;
+    const double r = (x - q * 0.25) * twoPi;
+    const double z = r * r;
+    c = 1.0 - 0.5 * z +
+      z * z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+    s = r + r * z * (S1 + z * (S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)))));
+    return q - 4.0 * ((q * 0.25 + roundConst) - roundConst);
+  }
+
+  // cos (2π x) is cos r, −sin r, sin r, or −cos r for m = 0, 1, −1, and
+  // ±2 respectively, and sin (2π x) is sin r, cos r, −cos r, or −sin r.
+  // The weights below are those values, computed exactly.  Choosing
+  // arithmetically rather than with branches or selects is what lets
+  // the compiler vectorize the loops that call these.
+  static inline double cosWeight (double m2) {
+    return 1.0 - m2 * (7.0 - m2) / 6.0;
+  }
+
+  static inline double sinWeight (double m, double m2) {
+    return m * (4.0 - m2) / 3.0;
+  }
+
+
+  // cos (2π x).
+  static inline double cosCycles (double x) {
+    double c, s;
+    const double m = reduce (x, c, s);
+    const double m2 = m * m;
+    return cosWeight (m2) * c - sinWeight (m, m2) * s;
+  }
+
+
+  // cos (2π x) and sin (2π x).
+  static inline void sinCosCycles (double x, double &cosx, double &sinx) {
+    double c, s;
+    const double m = reduce (x, c, s);
+    const double m2 = m * m, wc = cosWeight (m2), ws = sinWeight (m, m2);
+    cosx = wc * c - ws * s;
+    sinx = wc * s + ws * c;
+  }
+
+
+  // Single-precision counterparts, from Cephes' sinf and cosf.
+  static const float roundConst32 = 12582912.0f;        // 1.5·2²³
+  static const float twoPi32 = 6.28318530717958647692f;
+  static const float S1f = -1.6666654611e-1f,
+                     S2f =  8.3321608736e-3f,
+                     S3f = -1.9515295891e-4f;
+  static const float C1f =  4.166664568298827e-2f,
+                     C2f = -1.388731625493765e-3f,
+                     C3f =  2.443315711809948e-5f;
+
+  // cos (2π x) as cosCycles computes it, for |x| < 2²¹.
+  static inline float cosCycles32 (float x) {
+    const float q = (x * 4.0f + roundConst32) - roundConst32;
+    const float r = (x - q * 0.25f) * twoPi32;
+    const float z = r * r;
+    const float c = 1.0f - 0.5f * z + z * z * (C1f + z * (C2f + z * C3f));
+    const float s = r + r * z * (S1f + z * (S2f + z * S3f));
+    const float m = q - 4.0f * ((q * 0.25f + roundConst32) - roundConst32);
+    const float m2 = m * m;
+    return (1.0f - m2 * (7.0f - m2) / 6.0f) * c - m * (4.0f - m2) / 3.0f * s;
+  }
+
+
+  // A group of rotateGroup keeps 4 G doubles in registers, which at
+  // this width is 16 vectors.
+#if defined __AVX512F__
+  static const size_t groupWidth = 4 * kernelLanes;
+#elif defined __AVX__
+  static const size_t groupWidth = 2 * kernelLanes;
+#else
+  static const size_t groupWidth = kernelLanes;
+#endif
+
+
+  static double sumCos (const double *amp, const double *speed,
+                 const double *phase, size_t n, double hours) {
+    double sum[kernelLanes] = {0.0};
+    for (size_t i = 0; i < n; i += kernelLanes)
+      for (size_t l = 0; l < kernelLanes; ++l)
+        sum[l] += amp[i+l] * cosCycles (speed[i+l] * hours + phase[i+l]);
+    double total = 0.0;
+    for (size_t l = 0; l < kernelLanes; ++l)
+      total += sum[l];
+    return total;
+  }
+
+
+
+  static void sumCosDerivatives (const double *amp, const double *speed,
+                                 const double *phase, size_t n,
+                                 double hours, double d[5]) {
+    double s0[kernelLanes] = {0.0}, s1[kernelLanes] = {0.0},
+           s2[kernelLanes] = {0.0}, s3[kernelLanes] = {0.0},
+           s4[kernelLanes] = {0.0};
+    for (size_t i = 0; i < n; i += kernelLanes)
+      for (size_t l = 0; l < kernelLanes; ++l) {
+        double c, s;
+        sinCosCycles (speed[i+l] * hours + phase[i+l], c, s);
+        const double w = twoPi * speed[i+l], aw = amp[i+l] * w,
+                     aw2 = aw * w, aw3 = aw2 * w;
+        s0[l] += amp[i+l] * c;
+        s1[l] -= aw * s;
+        s2[l] -= aw2 * c;
+        s3[l] += aw3 * s;
+        s4[l] += aw3 * w * c;
+      }
+    d[0] = d[1] = d[2] = d[3] = d[4] = 0.0;
+    for (size_t l = 0; l < kernelLanes; ++l) {
+      d[0] += s0[l];
+      d[1] += s1[l];
+      d[2] += s2[l];
+      d[3] += s3[l];
+      d[4] += s4[l];
+    }
+  }
+
+
+  static void anchorPhasors (const double *amp, const double *speed,
+                             const double *phase, size_t n, double hours,
+                             double stepHours, double *re, double *im,
+                             double *rotRe, double *rotIm) {
+    for (size_t i = 0; i < n; ++i) {
+      double c, s;
+      sinCosCycles (speed[i] * hours + phase[i], c, s);
+      re[i] = amp[i] * c;
+      im[i] = amp[i] * s;
+      sinCosCycles (speed[i] * stepHours, rotRe[i], rotIm[i]);
+    }
+  }
+
+
+  // One group of G phasors, G a multiple of kernelLanes, carried in
+  // local arrays so that they stay in registers across the loop over
+  // steps.  Groups of more than kernelLanes give the processor
+  // independent rotations to overlap; each step's rotation depends on
+  // the previous one.
+  template <size_t G> static inline void rotateGroup (
+    double *re, double *im, const double *rotRe, const double *rotIm,
+    size_t count, double *acc) {
+    double x[G], y[G], cr[G], ci[G];
+    for (size_t l = 0; l < G; ++l) {
+      x[l] = re[l];
+      y[l] = im[l];
+      cr[l] = rotRe[l];
+      ci[l] = rotIm[l];
+    }
+    for (size_t k = 0; k < count; ++k) {
+      for (size_t l = 0; l < kernelLanes; ++l) {
+        double s = x[l];
+        for (size_t j = l + kernelLanes; j < G; j += kernelLanes)
+          s += x[j];
+        acc[k*kernelLanes+l] += s;
+      }
+      for (size_t l = 0; l < G; ++l) {
+        const double nx = x[l] * cr[l] - y[l] * ci[l];
+        y[l] = x[l] * ci[l] + y[l] * cr[l];
+        x[l] = nx;
+      }
+    }
+    for (size_t l = 0; l < G; ++l) {
+      re[l] = x[l];
+      im[l] = y[l];
+    }
+  }
+
+
+  static void rotateSeries (double *re, double *im, const double *rotRe,
+                            const double *rotIm, size_t n, size_t count,
+                            double *acc, double *out) {
+    for (size_t k = 0; k < count * kernelLanes; ++k)
+      acc[k] = 0.0;
+    size_t i = 0;
+    for (; i + groupWidth <= n; i += groupWidth)
+      rotateGroup<groupWidth> (re+i, im+i, rotRe+i, rotIm+i, count, acc);
+    // The rest, if any, as one group too, since a lone vector's
+    // rotations would wait on each other.
+    switch ((n - i) / kernelLanes) {
+    case 3:
+      rotateGroup<3*kernelLanes> (re+i, im+i, rotRe+i, rotIm+i, count, acc);
+      break;
+    case 2:
+      rotateGroup<2*kernelLanes> (re+i, im+i, rotRe+i, rotIm+i, count, acc);
+      break;
+    case 1:
+      rotateGroup<kernelLanes> (re+i, im+i, rotRe+i, rotIm+i, count, acc);
+      break;
+    }
+    for (size_t k = 0; k < count; ++k) {
+      double total = 0.0;
+      for (size_t l = 0; l < kernelLanes; ++l)
+        total += acc[k*kernelLanes+l];
+      out[k] += total;
+    }
+  }
+
+
+
+  static void phasorDerivatives (double *re, double *im,
+                                 const double *rotRe, const double *rotIm,
+                                 const double *speed, size_t n,
+                                 double d[5]) {
+    double s0[kernelLanes] = {0.0}, s1[kernelLanes] = {0.0},
+           s2[kernelLanes] = {0.0}, s3[kernelLanes] = {0.0},
+           s4[kernelLanes] = {0.0};
+    for (size_t i = 0; i < n; i += kernelLanes)
+      for (size_t l = 0; l < kernelLanes; ++l) {
+        const double x = re[i+l], y = im[i+l],
+                     w = twoPi * speed[i+l], w2 = w * w;
+        s0[l] += x;
+        s1[l] -= w * y;
+        s2[l] -= w2 * x;
+        s3[l] += w2 * w * y;
+        s4[l] += w2 * w2 * x;
+        re[i+l] = x * rotRe[i+l] - y * rotIm[i+l];
+        im[i+l] = x * rotIm[i+l] + y * rotRe[i+l];
+      }
+    d[0] = d[1] = d[2] = d[3] = d[4] = 0.0;
+    for (size_t l = 0; l < kernelLanes; ++l) {
+      d[0] += s0[l];
+      d[1] += s1[l];
+      d[2] += s2[l];
+      d[3] += s3[l];
+      d[4] += s4[l];
+    }
+  }
+
+
+  static void sumCosSeries32 (const float *amp, const float *speed,
+                              const float *phase, size_t n, float stepHours,
+                              size_t count, double *out) {
+    for (size_t k = 0; k < count; ++k) {
+      const float hours = (float)k * stepHours;
+      float sum[kernelLanes32] = {0.0f};
+      for (size_t i = 0; i < n; i += kernelLanes32)
+        for (size_t l = 0; l < kernelLanes32; ++l)
+          sum[l] += amp[i+l] * cosCycles32 (speed[i+l] * hours + phase[i+l]);
+      float total = 0.0f;
+      for (size_t l = 0; l < kernelLanes32; ++l)
+        total += sum[l];
+      out[k] += total;
+    }
+  }
+
+}
+
+
+  extern const Kernels KERNEL_TABLE (KERNEL_SET);
+  const Kernels KERNEL_TABLE (KERNEL_SET) = {
+    KERNEL_STRING (KERNEL_SET),
+    KERNEL_SET::sumCos,
+    KERNEL_SET::sumCosDerivatives,
+    KERNEL_SET::anchorPhasors,
+    KERNEL_SET::rotateSeries,
+    KERNEL_SET::phasorDerivatives,
+    KERNEL_SET::sumCosSeries32
+  };
+
+}
@@ -0,0 +1,134 @@
+// -*- c++ -*-
+
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+// Inner loops shared by the library, and the choice among their
+// builds for different instruction sets.  Not installed.
+
+#ifndef TCDPREDICT_KERNELS
+#define TCDPREDICT_KERNELS
+
+#include <stddef.h>
+
+namespace TcdPredict {
+
+
+  // Arrays handed to the kernels are padded with zero amplitudes to a
+  // multiple of this many elements, one AVX-512 vector of doubles, so
+  // that the loops have no remainder to deal with.  Single-precision
+  // arrays are padded to a multiple of kernelLanes32.
+  const size_t kernelLanes = 8, kernelLanes32 = 16;
+
+  inline size_t padLength (size_t n) {
+    return (n + kernelLanes - 1) / kernelLanes * kernelLanes;
+  }
+
+  inline size_t padLength32 (size_t n) {
+    return (n + kernelLanes32 - 1) / kernelLanes32 * kernelLanes32;
+  }
+
+
+  // One implementation of every inner loop.  kernels.cc is compiled
+  // once per instruction set, each time with its own flags, and
+  // defines one of these; see dispatch.cc for the choice among them.
+  struct Kernels {
+    const char *name;
+
+    // Σ amp[i] cos (2π (speed[i]·hours + phase[i])) for i < n, n a
+    // multiple of kernelLanes.  The cosine is a polynomial rather than
+    // a call to cos(), which is what lets the compiler vectorize the
+    // loop across constituents.
+    double (*sumCos) (const double *amp, const double *speed,
+                      const double *phase, size_t n, double hours);
+
+    // The same sum and its first four derivatives with respect to
+    // hours, in d[0] through d[4].
+    void (*sumCosDerivatives) (const double *amp, const double *speed,
+                               const double *phase, size_t n,
+                               double hours, double d[5]);
+
+    // Sets (re[i], im[i]) to the phasor amp[i] e^(2πi (speed[i]·hours
+    // + phase[i])), and (rotRe[i], rotIm[i]) to the unit phasor that
+    // advances it by stepHours.
+    void (*anchorPhasors) (const double *amp, const double *speed,
+                           const double *phase, size_t n, double hours,
+                           double stepHours, double *re, double *im,
+                           double *rotRe, double *rotIm);
+
+    // Adds to out[k], for k < count, Σ re[i] for i < n (n a multiple
+    // of kernelLanes) with every phasor rotated k steps, and leaves the
+    // phasors rotated count steps.  Each group of phasors is carried
+    // through all count steps before the next, so that it stays in
+    // registers.  acc is scratch space for count × kernelLanes doubles.
+    void (*rotateSeries) (double *re, double *im, const double *rotRe,
+                          const double *rotIm, size_t n, size_t count,
+                          double *acc, double *out);
+
+    // The derivatives that sumCosDerivatives would give at the
+    // phasors' current time, after which the phasors are rotated one
+    // step.
+    void (*phasorDerivatives) (double *re, double *im, const double *rotRe,
+                               const double *rotIm, const double *speed,
+                               size_t n, double d[5]);
+
+    // Adds to out[k], for k < count, Σ amp[i] cos (2π (speed[i]·k·
+    // stepHours + phase[i])) for i < n (n a multiple of kernelLanes32),
+    // in single precision with a polynomial cosine.  The arguments must
+    // stay within a few tens of cycles for full single precision.
+    void (*sumCosSeries32) (const float *amp, const float *speed,
+                            const float *phase, size_t n, float stepHours,
+                            size_t count, double *out);
+  };
+
+  extern const Kernels scalarKernels, baselineKernels, avx2Kernels,
+    avx512Kernels;
+
+  // The set in use, chosen on first call.
+  const Kernels &kernels ();
+
+
+  inline double sumCos (const double *amp, const double *speed,
+                        const double *phase, size_t n, double hours) {
+    return kernels().sumCos (amp, speed, phase, n, hours);
+  }
+
+  inline void sumCosDerivatives (const double *amp, const double *speed,
+                                 const double *phase, size_t n,
+                                 double hours, double d[5]) {
+    kernels().sumCosDerivatives (amp, speed, phase, n, hours, d);
+  }
+
+  inline void anchorPhasors (const double *amp, const double *speed,
+                             const double *phase, size_t n, double hours,
+                             double stepHours, double *re, double *im,
+                             double *rotRe, double *rotIm) {
+    kernels().anchorPhasors (amp, speed, phase, n, hours, stepHours, re, im,
+                             rotRe, rotIm);
+  }
+
+  inline void rotateSeries (double *re, double *im, const double *rotRe,
+                            const double *rotIm, size_t n, size_t count,
+                            double *acc, double *out) {
+    kernels().rotateSeries (re, im, rotRe, rotIm, n, count, acc, out);
+  }
+
+  inline void phasorDerivatives (double *re, double *im,
+                                 const double *rotRe, const double *rotIm,
+                                 const double *speed, size_t n,
+                                 double d[5]) {
+    kernels().phasorDerivatives (re, im, rotRe, rotIm, speed, n, d);
+  }
+
+  inline void sumCosSeries32 (const float *amp, const float *speed,
+                              const float *phase, size_t n, float stepHours,
+                              size_t count, double *out) {
+    kernels().sumCosSeries32 (amp, speed, phase, n, stepHours, count, out);
+  }
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+/*  precision_test:  checks the single-precision synthesis, and every
+    kernel set, against double precision over a whole TCD file.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+// The database is named by the TCD_TEST_FILE environment variable (make
+// check points it at the TICON file at the top of the tree); without it
+// the test is skipped.
+
+// For every reference station, two windows are predicted:  15 days at
+// 6-minute steps across a new year, and 30 days at hourly steps, where
+// the single-precision phases span the most cycles.  The reference is
+// Synthesis::direct with the scalar kernels.  Then, with each kernel
+// set the processor supports:
+
+//   direct and phasor must agree with it to 10⁻¹¹ × Σ f·A;
+//   float32 must agree with it to 1 mm (stations in units other than
+//   meters or feet are left out of this check).
+
+// A Predictor that has predicted a window in 1968 must give the same
+// direct series for one in 1969 as a fresh one, to 10⁻¹¹ × Σ f·A.
+
+// Lastly, with the default set, phasor series with a budget of 5 mm
+// must stay within it.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "TcdPredict"
+
+using namespace TcdPredict;
+
+static const int SKIP = 77;
+static const double float32Bound = 1.0;         // mm
+static const double float64Bound = 1e-11;       // of Σ f·A
+static const double budget = 5.0;               // mm
+
+
+struct Window {
+  Time start;
+  int64_t step;
+  size_t count;
+};
+
+
+int main () {
+  const char *filename (getenv ("TCD_TEST_FILE"));
+  FILE *f (filename ? fopen (filename, "rb") : NULL);
+  if (!f) {
+    printf ("precision_test: no TCD_TEST_FILE; skipped\n");
+    return SKIP;
+  }
+  fclose (f);
+
+  try {
+    Database db (filename);
+    const std::vector<Station> stations (db.loadStations ());
+    const Window windows[] = {
+      {makeTime (2024, 12, 25), 360, 15 * 240},
+      {makeTime (2025, 3, 1), 3600, 30 * 24}
+    };
+
+    // The reference series, station by station, window by window.
+    if (!selectKernelSet ("scalar"))
+      throw Error ("no scalar kernels");
+    std::vector<std::vector<double> > reference;
+    std::vector<double> scale, mm;
+    for (const Station &station: stations) {
+      Predictor predictor (db, station);
+      for (const Window &w: windows) {
+        reference.emplace_back (w.count);
+        predictor.series (w.start, w.step, w.count, reference.back().data(),
+                          Synthesis::direct);
+      }
+      double sum (0.0);
+      const std::shared_ptr<const Folded> folded (
+        foldYear (db, station, yearOf (windows[0].start)));
+      for (size_t j (0); j < folded->count; ++j)
+        sum += fabs (folded->amp()[j]);
+      scale.push_back (sum);
+      mm.push_back (station.units == "meters" ? 1000.0 :
+                    station.units == "feet" ? 304.8 : 0.0);
+    }
+
+    bool pass (true);
+    for (const std::string &set: kernelSets()) {
+      selectKernelSet (set);
+      const Synthesis checks[] = {Synthesis::direct, Synthesis::phasor,
+                                  Synthesis::float32};
+      const char *names[] = {"direct", "phasor", "float32"};
+      for (int c (0); c < 3; ++c) {
+        double worst (0.0);
+        size_t worstStation (0), checked (0);
+        std::vector<double> out;
+        for (size_t s (0), r (0); s < stations.size(); ++s) {
+          Predictor predictor (db, stations[s]);
+          for (const Window &w: windows) {
+            out.resize (w.count);
+            predictor.series (w.start, w.step, w.count, out.data(),
+                              checks[c]);
+            const std::vector<double> &ref (reference[r++]);
+            double err (0.0);
+            for (size_t k (0); k < w.count; ++k)
+              err = std::max (err, fabs (out[k] - ref[k]));
+            // In mm for float32, and relative to Σ f·A otherwise.
+            if (checks[c] == Synthesis::float32) {
+              if (!mm[s])
+                continue;
+              err *= mm[s];
+            } else if (scale[s] > 0.0)
+              err /= scale[s];
+            ++checked;
+            if (err > worst) {
+              worst = err;
+              worstStation = s;
+            }
+          }
+        }
+        const bool ok (worst <= (checks[c] == Synthesis::float32 ?
+                                 float32Bound : float64Bound));
+        printf ("%-8s %-7s %s %.3g %s over %lu series; worst at %s\n",
+                set.c_str(), names[c], ok ? "ok  " : "FAIL", worst,
+                checks[c] == Synthesis::float32 ? "mm" : "of sum f A",
+                (unsigned long)checked,
+                stations.empty() ? "-" : stations[worstStation].name.c_str());
+        pass = pass && ok;
+      }
+    }
+    selectKernelSet (kernelSets().front());
+    {
+      const Window before {makeTime (1968, 6, 1), 3600, 4},
+                   after {makeTime (1969, 3, 1), 3600, 4};
+      double worst (0.0);
+      size_t worstStation (0);
+      std::vector<double> out (after.count), fresh (after.count);
+      for (size_t s (0); s < stations.size(); ++s) {
+        Predictor reused (db, stations[s]), predictor (db, stations[s]);
+        reused.series (before.start, before.step, before.count, out.data(),
+                       Synthesis::direct);
+        reused.series (after.start, after.step, after.count, out.data(),
+                       Synthesis::direct);
+        predictor.series (after.start, after.step, after.count,
+                          fresh.data(), Synthesis::direct);
+        double err (0.0);
+        for (size_t k (0); k < after.count; ++k)
+          err = std::max (err, fabs (out[k] - fresh[k]));
+        if (scale[s] > 0.0)
+          err /= scale[s];
+        if (err > worst) {
+          worst = err;
+          worstStation = s;
+        }
+      }
+      const bool ok (worst <= float64Bound);
+      printf ("%-8s reused  %s %.3g of sum f A before 1970; worst at %s\n",
+              kernelSet().c_str(), ok ? "ok  " : "FAIL", worst,
+              stations.empty() ? "-" : stations[worstStation].name.c_str());
+      pass = pass && ok;
+    }
+    double worst (0.0);
+    size_t terms (0), all (0);
+    std::vector<double> out;
+    for (size_t s (0), r (0); s < stations.size(); ++s, r += 2) {
+      if (!mm[s])
+        continue;
+      Predictor predictor (db, stations[s]);
+      predictor.setBudget (budget / mm[s]);
+      const Window &w (windows[0]);
+      out.resize (w.count);
+      predictor.series (w.start, w.step, w.count, out.data());
+      for (size_t k (0); k < w.count; ++k)
+        worst = std::max (worst, fabs (out[k] - reference[r][k]) * mm[s]);
+      terms += predictor.terms();
+      all += foldYear (db, stations[s], yearOf (w.start))->count;
+    }
+    const bool ok (worst <= budget);
+    printf ("%-8s budget  %s %.3g mm of %g mm with %lu of %lu terms\n",
+            kernelSet().c_str(), ok ? "ok  " : "FAIL", worst, budget,
+            (unsigned long)terms, (unsigned long)all);
+    pass = pass && ok;
+    return pass ? 0 : 1;
+  } catch (const Error &e) {
+    fprintf (stderr, "precision_test: %s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,223 @@
+/*  predict_tide:  print predicted heights for one station of a TCD file.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "TcdPredict"
+
+using namespace TcdPredict;
+
+
+static void usage () {
+  fprintf (stderr,
+    "Usage: predict_tide (-r record | -s station) -b begin -e end\n"
+    "                    [-i minutes] [-m direct|float32|phasor] [-a budget]\n"
+    "                    [-E] file.tcd\n"
+    "       predict_tide -o out.bin -b begin -e end [-i minutes] [-j threads]\n"
+    "                    file.tcd\n"
+    "Times are UTC, YYYY-MM-DD HH:MM[:SS]; the step defaults to 60 minutes.\n"
+    "-m chooses how the series is evaluated (default phasor).\n"
+    "-a leaves out the smallest constituents while their amplitudes add up\n"
+    "   to no more than budget, in station units.\n"
+    "-E lists high and low waters instead of a series.\n"
+    "-o writes every station to a binary file, using threads (default one\n"
+    "   per processor).  Subordinate current stations are skipped.\n");
+  exit (-1);
+}
+
+
+static Time getTime (const char *arg) {
+  Time t;
+  if (!parseTime (arg, t)) {
+    fprintf (stderr, "Bad time: %s\n", arg);
+    exit (-1);
+  }
+  return t;
+}
+
+
+static void printEvent (const Event &event) {
+  printf ("%s %9.4f  %s\n", formatTime (event.time).c_str(), event.height,
+          event.high ? "high" : "low");
+}
+
+
+static void printSeries (Time begin, long step,
+                         const std::vector<double> &heights) {
+  for (size_t i (0); i < heights.size(); ++i)
+    printf ("%s %9.4f\n", formatTime (begin + (Time)i * step).c_str(),
+            heights[i]);
+}
+
+
+int main (int argc, char **argv) {
+
+  const char *tcdFileName (NULL), *stationName (NULL), *outFileName (NULL);
+  int32_t record (-1);
+  Time begin (0), end (0);
+  bool haveBegin (false), haveEnd (false);
+  long step (3600);
+  Synthesis synthesis (Synthesis::phasor);
+  double budget (0.0);
+  bool listEvents (false);
+  unsigned threads (0);
+
+  for (int argnum (1); argnum < argc; ++argnum) {
+    const char *arg (argv[argnum]);
+    if (arg[0] == '-' && arg[1] && !arg[2] && strchr ("rsbeimoja", arg[1])) {
+      if (++argnum >= argc)
+        usage ();
+      const char *val (argv[argnum]);
+      switch (arg[1]) {
+      case 'r':
+        record = atoi (val);
+        break;
+      case 's':
+        stationName = val;
+        break;
+      case 'b':
+        begin = getTime (val);
+        haveBegin = true;
+        break;
+      case 'e':
+        end = getTime (val);
+        haveEnd = true;
+        break;
+      case 'i':
+        step = (long)(atof (val) * 60.0 + 0.5);
+        if (step <= 0) {
+          fprintf (stderr, "Bad step: %s\n", val);
+          exit (-1);
+        }
+        break;
+      case 'o':
+        outFileName = val;
+        break;
+      case 'j':
+        threads = atoi (val);
+        break;
+      case 'a':
+        budget = atof (val);
+        if (!(budget >= 0.0)) {
+          fprintf (stderr, "Bad budget: %s\n", val);
+          exit (-1);
+        }
+        break;
+      case 'm':
+        if (!strcmp (val, "direct"))
+          synthesis = Synthesis::direct;
+        else if (!strcmp (val, "float32"))
+          synthesis = Synthesis::float32;
+        else if (!strcmp (val, "phasor"))
+          synthesis = Synthesis::phasor;
+        else
+          usage ();
+        break;
+      }
+    } else if (!strcmp (arg, "-E"))
+      listEvents = true;
+    else if (arg[0] != '-' && !tcdFileName)
+      tcdFileName = arg;
+    else
+      usage ();
+  }
+  if (!tcdFileName || !haveBegin || !haveEnd ||
+      (outFileName ? record >= 0 || stationName || listEvents
+                   : (record < 0) == (stationName == NULL)))
+    usage ();
+  if (end < begin) {
+    fprintf (stderr, "End time is before begin time\n");
+    exit (-1);
+  }
+
+  try {
+    Database db (tcdFileName);
+    if (outFileName) {
+      const std::vector<Station> stations (db.loadStations (threads));
+      std::vector<Subordinate> subordinates;
+      unsigned long currents (0);
+      for (Subordinate &sub: db.loadSubordinates (threads))
+        if (sub.current)
+          ++currents;
+        else
+          subordinates.push_back (std::move (sub));
+      const size_t count ((end - begin) / step + 1);
+      const std::map<int32_t, std::string> failed (
+        writeSeriesFile (outFileName, db, stations, subordinates, begin,
+                         step, count, threads));
+      fprintf (stderr, "predict_tide: wrote %lu stations and %lu subordinate"
+               " stations, %lu samples each\n",
+               (unsigned long)stations.size(),
+               (unsigned long)subordinates.size(), (unsigned long)count);
+      if (currents)
+        fprintf (stderr, "predict_tide: skipped %lu subordinate current"
+                 " stations\n", currents);
+      for (const auto &f: failed)
+        fprintf (stderr, "predict_tide: record %d written as NaN: %s\n",
+                 f.first, f.second.c_str());
+      if (!failed.empty())
+        fprintf (stderr, "predict_tide: %lu stations could not be"
+                 " predicted\n", (unsigned long)failed.size());
+      return 0;
+    }
+    if (stationName) {
+      record = db.findStation (stationName);
+      if (record < 0) {
+        fprintf (stderr, "No station matches %s\n", stationName);
+        exit (-1);
+      }
+    }
+    if (db.referenceOf (record) >= 0) {
+      const Subordinate sub (db.loadSubordinate (record));
+      ReferenceCache cache (db, begin, end);
+      printf ("# %s (record %d, subordinate to record %d)\n"
+              "# UTC, %s above station datum\n", sub.name.c_str(), sub.record,
+              sub.reference, sub.units.c_str());
+      if (listEvents) {
+        for (const Event &event: cache.events (sub))
+          printEvent (event);
+      } else {
+        const size_t count ((end - begin) / step + 1);
+        std::vector<double> heights (count);
+        cache.series (sub, begin, step, count, heights.data());
+        printSeries (begin, step, heights);
+      }
+      return 0;
+    }
+
+    const Station station (db.loadStation (record));
+    Predictor predictor (db, station);
+    predictor.setBudget (budget);
+
+    // Predicted before the header, which gives the constituents used.
+    std::vector<Event> events;
+    std::vector<double> heights;
+    if (listEvents)
+      events = predictor.events (begin, end);
+    else {
+      heights.resize ((end - begin) / step + 1);
+      predictor.series (begin, step, heights.size(), heights.data(),
+                        synthesis);
+    }
+    printf ("# %s (record %d)\n# UTC, %s above station datum\n",
+            station.name.c_str(), station.record, station.units.c_str());
+    if (budget > 0.0)
+      printf ("# %lu of %lu constituents, within %g %s\n",
+              (unsigned long)predictor.terms(),
+              (unsigned long)station.constituent.size(), budget,
+              station.units.c_str());
+    if (listEvents) {
+      for (const Event &event: events)
+        printEvent (event);
+    } else
+      printSeries (begin, step, heights);
+  } catch (const Error &e) {
+    fprintf (stderr, "predict_tide: %s\n", e.what());
+    exit (-1);
+  }
+  return 0;
+}
@@ -0,0 +1,236 @@
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <algorithm>
+#include "TcdPredict"
+#include "kernels.hh"
+
+
+namespace TcdPredict {
+
+
+  // The most cycles of phase left to single precision in
+  // Synthesis::float32, where its rounding error is 2⁻²⁰ cycles.
+  static const double float32Cycles = 16.0;
+
+
+  const size_t Predictor::anchorInterval;
+
+
+  size_t Folded::bytes () const {
+    return sizeof *this + block.capacity() * sizeof (double);
+  }
+
+
+  std::shared_ptr<const Folded> foldYear (const Database &db,
+                                          const Station &station, int year) {
+    const Database::Year &tables (db.year (year));
+    std::shared_ptr<Folded> folded (std::make_shared<Folded>());
+    folded->year = year;
+    folded->yearStart = yearStart (year);
+    std::vector<std::pair<double, size_t> > order;
+    for (size_t i (0); i < station.constituent.size(); ++i) {
+      const double f (tables.nodeFactor[station.constituent[i]]);
+      if (f != 0.0)
+        order.emplace_back (-fabs (f * station.amplitude[i]), i);
+    }
+    std::sort (order.begin(), order.end());
+    folded->count = order.size();
+    folded->padded = padLength (folded->count);
+    folded->block.resize (3 * folded->padded);
+    double *amp (folded->block.data()), *speed (amp + folded->padded),
+      *phase (speed + folded->padded);
+    for (size_t j (0); j < order.size(); ++j) {
+      const size_t i (order[j].second);
+      const uint32_t c (station.constituent[i]);
+      amp[j] = tables.nodeFactor[c] * station.amplitude[i];
+      speed[j] = db.speed (c);
+      phase[j] = tables.arg[c] - station.epoch[i];
+    }
+    return folded;
+  }
+
+
+  size_t Folded::terms (double budget) const {
+    size_t n (count);
+    double dropped (0.0);
+    while (n > 0 && (dropped += fabs (amp()[n - 1])) <= budget)
+      --n;
+    return n;
+  }
+
+
+  Predictor::Predictor (const Database &db, const Station &station):
+    db_ (db),
+    cache_ (nullptr),
+    station_ (station),
+    year_ (INT_MIN),
+    yearStart_ (0),
+    padded_ (0),
+    budget_ (0.0),
+    terms_ (0),
+    amp_ (nullptr),
+    speed_ (nullptr),
+    phase_ (nullptr),
+    re_ (padLength (station.constituent.size())),
+    im_ (re_.size()),
+    rotRe_ (re_.size()),
+    rotIm_ (re_.size()),
+    year32_ (INT_MIN),
+    amp32_ (padLength32 (station.constituent.size())),
+    speed32_ (amp32_.size()),
+    phase32_ (amp32_.size()),
+    fastest_ (0.0) {
+  }
+
+
+  Predictor::Predictor (CoefficientCache &cache, int32_t record):
+    db_ (cache.database()),
+    cache_ (&cache),
+    cachedStation_ (cache.station (record)),
+    station_ (*cachedStation_),
+    year_ (INT_MIN),
+    yearStart_ (0),
+    padded_ (0),
+    budget_ (0.0),
+    terms_ (0),
+    amp_ (nullptr),
+    speed_ (nullptr),
+    phase_ (nullptr),
+    re_ (padLength (station_.constituent.size())),
+    im_ (re_.size()),
+    rotRe_ (re_.size()),
+    rotIm_ (re_.size()),
+    year32_ (INT_MIN),
+    amp32_ (padLength32 (station_.constituent.size())),
+    speed32_ (amp32_.size()),
+    phase32_ (amp32_.size()),
+    fastest_ (0.0) {
+  }
+
+
+  void Predictor::fold (int year) {
+    if (year == year_)
+      return;
+    folded_ = cache_ ? cache_->folded (station_.record, year)
+                     : foldYear (db_, station_, year);
+    year_ = year;
+    yearStart_ = folded_->yearStart;
+    padded_ = folded_->padded;
+    terms_ = folded_->count;
+    if (budget_ > 0.0) {
+      padded_ = padLength (folded_->terms (budget_));
+      terms_ = std::min (terms_, padded_);
+    }
+    amp_ = folded_->amp();
+    speed_ = folded_->speed();
+    phase_ = folded_->phase();
+  }
+
+
+  void Predictor::setBudget (double budget) {
+    if (!(budget >= 0.0))
+      throw Error ("the budget must not be negative");
+    budget_ = budget;
+    // Taking the change at the next prediction.
+    year_ = year32_ = INT_MIN;
+  }
+
+
+  double Predictor::height (Time t) {
+    const int year (yearOf (t));
+    if (year != year_)
+      fold (year);
+    return station_.datumOffset +
+      sumCos (amp_, speed_, phase_, padded_,
+              (t - yearStart_) / 3600.0);
+  }
+
+
+  void Predictor::anchor (Time t, int64_t step) {
+    anchorPhasors (amp_, speed_, phase_, padded_,
+                   (t - yearStart_) / 3600.0, step / 3600.0, re_.data(),
+                   im_.data(), rotRe_.data(), rotIm_.data());
+  }
+
+
+  void Predictor::series (Time start, int64_t step, size_t count,
+                          double *out, Synthesis synthesis) {
+    if (synthesis == Synthesis::direct) {
+      Time t (start),
+        nextYear (year_ == INT_MIN ? 0 : yearStart (year_ + 1));
+      for (size_t i (0); i < count; ++i, t += step) {
+        if (year_ == INT_MIN || t < yearStart_ || t >= nextYear) {
+          fold (yearOf (t));
+          nextYear = yearStart (year_ + 1);
+        }
+        out[i] = station_.datumOffset +
+          sumCos (amp_, speed_, phase_, padded_,
+                  (t - yearStart_) / 3600.0);
+      }
+      return;
+    }
+
+    // Runs of at most anchorInterval steps that stay within one year,
+    // each starting from freshly computed phasors or phases.
+    const bool single (synthesis == Synthesis::float32);
+    if (!single && acc_.empty())
+      acc_.resize (anchorInterval * kernelLanes);
+    Time t (start);
+    for (size_t i (0); i < count; ) {
+      const int year (yearOf (t));
+      if (year != year_)
+        fold (year);
+      size_t run (std::min (count - i, anchorInterval));
+      if (step > 0)
+        run = std::min<size_t> (run,
+                                (yearStart (year_ + 1) - t + step - 1) / step);
+      else if (step < 0)
+        run = std::min<size_t> (run, (t - yearStart_) / -step + 1);
+      if (single) {
+        if (year32_ != year_)
+          fold32 ();
+        const double span (fastest_ * fabs (step / 3600.0));
+        if (span * run > float32Cycles)
+          run = std::max<size_t> (1, float32Cycles / span);
+      }
+      std::fill (out + i, out + i + run, station_.datumOffset);
+      if (single) {
+        const double hours ((t - yearStart_) / 3600.0);
+        for (size_t j (0); j < terms_; ++j) {
+          const double x (speed_[j] * hours + phase_[j]);
+          phase32_[j] = x - floor (x + 0.5);
+        }
+        sumCosSeries32 (amp32_.data(), speed32_.data(), phase32_.data(),
+                        padLength32 (terms_), step / 3600.0, run,
+                        out + i);
+      } else {
+        anchor (t, step);
+        rotateSeries (re_.data(), im_.data(), rotRe_.data(), rotIm_.data(),
+                      padded_, run, acc_.data(), out + i);
+      }
+      i += run;
+      t += (Time)run * step;
+    }
+  }
+
+
+  // Single-precision copies of the folded year, with the phases left
+  // to series.
+  void Predictor::fold32 () {
+    std::fill (amp32_.begin(), amp32_.end(), 0.0f);
+    fastest_ = 0.0;
+    for (size_t j (0); j < terms_; ++j) {
+      amp32_[j] = amp_[j];
+      speed32_[j] = speed_[j];
+      fastest_ = std::max (fastest_, speed_[j]);
+    }
+    year32_ = year_;
+  }
+
+}
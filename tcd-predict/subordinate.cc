@@ -0,0 +1,153 @@
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+#include "TcdPredict"
+
+
+namespace TcdPredict {
+
+
+  ReferenceCache::ReferenceCache (const Database &db, Time begin, Time end):
+    db_ (db),
+    begin_ (begin),
+    end_ (end) {
+    if (end < begin)
+      throw Error ("the window ends before it begins");
+  }
+
+
+  void ReferenceCache::clear () {
+    references_.clear ();
+  }
+
+
+  const ReferenceCache::Reference &ReferenceCache::reference (int32_t record)
+  {
+    const auto found (references_.find (record));
+    if (found != references_.end())
+      return found->second;
+
+    const Station station (db_.loadStation (record));
+    Predictor predictor (db_, station);
+    Reference ref;
+    ref.units = station.units;
+    ref.curveStart = begin_ - margin;
+    ref.curve.resize ((end_ + margin - ref.curveStart) / resolution + 1);
+    predictor.series (ref.curveStart, resolution, ref.curve.size(),
+                      ref.curve.data());
+    // Kept two samples inside the curve, so that every time between two
+    // of them has the four samples the interpolation needs.
+    ref.events = predictor.events (ref.curveStart + 2 * resolution,
+                                   end_ + margin - 2 * resolution);
+    return references_[record] = std::move (ref);
+  }
+
+
+  void ReferenceCache::pairs (const Subordinate &sub, std::vector<Pair> &out)
+  {
+    if (sub.current)
+      throw Error (sub.name + " is a current station; subordinate currents"
+                   " are not supported");
+    if (llabs (sub.minTimeAdd) >= offsetLimit ||
+        llabs (sub.maxTimeAdd) >= offsetLimit)
+      throw Error ("the time offsets of " + sub.name + " are too large");
+    const Reference &ref (reference (sub.reference));
+    double scale (1.0);
+    if (ref.units != sub.units) {
+      if (ref.units == "feet" && sub.units == "meters")
+        scale = 0.3048;
+      else if (ref.units == "meters" && sub.units == "feet")
+        scale = 1.0 / 0.3048;
+      else
+        throw Error (sub.name + " is in " + sub.units +
+                     " but its reference station is in " + ref.units);
+    }
+
+    out.clear ();
+    for (const Event &event: ref.events) {
+      Pair pair;
+      pair.refTime = event.time;
+      pair.refHeight = event.height;
+      pair.high = event.high;
+      if (event.high) {
+        pair.subTime = event.time + sub.maxTimeAdd;
+        pair.subHeight = event.height * scale * sub.maxLevelMultiply +
+          sub.maxLevelAdd;
+      } else {
+        pair.subTime = event.time + sub.minTimeAdd;
+        pair.subHeight = event.height * scale * sub.minLevelMultiply +
+          sub.minLevelAdd;
+      }
+      // Dropping both keeps highs and lows alternating.
+      if (!out.empty() && pair.subTime <= out.back().subTime) {
+        out.pop_back ();
+        continue;
+      }
+      out.push_back (pair);
+    }
+  }
+
+
+  // Lagrange cubic through the samples either side of the two that
+  // bracket seconds from the start of the curve.
+  double ReferenceCache::curve (const Reference &ref, double seconds) const {
+    const double x (seconds / resolution);
+    const size_t i ((size_t)x);
+    const double f (x - i);
+    const double *y (&ref.curve[i - 1]);
+    return f * (f - 1) * ((f + 1) * y[3] - (f - 2) * y[0]) / 6 +
+      (f + 1) * (f - 2) * ((f - 1) * y[1] - f * y[2]) / 2;
+  }
+
+
+  std::vector<Event> ReferenceCache::events (const Subordinate &sub) {
+    pairs (sub, pairs_);
+    std::vector<Event> events;
+    for (const Pair &pair: pairs_)
+      if (pair.subTime >= begin_ && pair.subTime < end_)
+        events.push_back (Event {pair.subTime, pair.subHeight, pair.high});
+    return events;
+  }
+
+
+  void ReferenceCache::series (const Subordinate &sub, Time start,
+                               int64_t step, size_t count, double *out) {
+    if (!count)
+      return;
+    const Time last (start + (Time)(count - 1) * step);
+    if (std::min (start, last) < begin_ || std::max (start, last) > end_)
+      throw Error ("series outside the window of the reference cache");
+    pairs (sub, pairs_);
+    const Reference &ref (reference (sub.reference));
+
+    size_t k (0);
+    Time t (start);
+    for (size_t i (0); i < count; ++i, t += step) {
+      if (k + 1 >= pairs_.size() || t < pairs_[k].subTime ||
+          t >= pairs_[k + 1].subTime) {
+        k = std::upper_bound (pairs_.begin(), pairs_.end(), t,
+                              [] (Time t, const Pair &pair) {
+                                return t < pair.subTime;
+                              }) - pairs_.begin();
+        if (k == 0 || k >= pairs_.size())
+          throw Error ("no high or low water at " + sub.name + " near " +
+                       formatTime (t));
+        --k;
+      }
+      const Pair &a (pairs_[k]), &b (pairs_[k + 1]);
+      const double tau (a.refTime - ref.curveStart +
+                        (double)(t - a.subTime) * (b.refTime - a.refTime) /
+                        (b.subTime - a.subTime));
+      const double range (b.refHeight - a.refHeight);
+      out[i] = range == 0.0 ? a.subHeight :
+        a.subHeight + (curve (ref, tau) - a.refHeight) / range *
+        (b.subHeight - a.subHeight);
+    }
+  }
+
+}
@@ -0,0 +1,207 @@
+/*  tide_datums:  compute tidal datums for every station of a TCD file.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include "TcdPredict"
+
+using namespace TcdPredict;
+
+
+static void usage () {
+  fprintf (stderr,
+    "Usage: tide_datums [-b first_year] [-y years] [-T] [-j threads]\n"
+    "                   [-r record] file.tcd > datums.json\n"
+    "The epoch starts on January 1 of first_year (default 1983) and lasts\n"
+    "years (default 19; 18.6 for one nodal cycle).  -T uses tidal days of\n"
+    "24.84 hours for MHHW and MLLW instead of UTC calendar days.  Threads\n"
+    "default to one per processor.  -r computes a single station.\n");
+  exit (-1);
+}
+
+
+// TiconToTCD.py names stations "name::tide_gauge_name::start::end::datum";
+// y25nf.datums.json identifies them by tide_gauge_name.
+static std::string gaugeName (const std::string &name) {
+  const size_t start (name.find ("::"));
+  if (start == std::string::npos)
+    return name;
+  const size_t end (name.find ("::", start + 2));
+  return name.substr (start + 2, end == std::string::npos ? std::string::npos
+                                                          : end - start - 2);
+}
+
+
+static void printString (const std::string &s) {
+  putchar ('"');
+  for (unsigned char c: s)
+    if (c == '"' || c == '\\')
+      printf ("\\%c", c);
+    else if (c < 0x20)
+      printf ("\\u%04x", c);
+    else
+      putchar (c);
+  putchar ('"');
+}
+
+
+static void printDatum (const char *name, const Datum &datum) {
+  if (isnan (datum.value))
+    printf (", \"%s\": null", name);
+  else
+    printf (", \"%s\": %.9g", name, datum.value);
+  printf (", \"%s_count\": %llu", name, (unsigned long long)datum.count);
+}
+
+
+struct Result {
+  bool ok;
+  std::string name;
+  double latitude, longitude;
+  Datums datums;
+};
+
+
+int main (int argc, char **argv) {
+
+  const char *tcdFileName (NULL);
+  int firstYear (1983), record (-1);
+  double years (19.0);
+  int64_t dayLength (86400);
+  unsigned threads (std::thread::hardware_concurrency());
+
+  for (int argnum (1); argnum < argc; ++argnum) {
+    const char *arg (argv[argnum]);
+    if (arg[0] == '-' && arg[1] && !arg[2] && strchr ("byjr", arg[1])) {
+      if (++argnum >= argc)
+        usage ();
+      const char *val (argv[argnum]);
+      switch (arg[1]) {
+      case 'b':
+        firstYear = atoi (val);
+        break;
+      case 'y':
+        years = atof (val);
+        if (!(years > 0.0))
+          usage ();
+        break;
+      case 'j':
+        threads = atoi (val);
+        break;
+      case 'r':
+        record = atoi (val);
+        break;
+      }
+    } else if (!strcmp (arg, "-T"))
+      dayLength = 89424;
+    else if (arg[0] != '-' && !tcdFileName)
+      tcdFileName = arg;
+    else
+      usage ();
+  }
+  if (!tcdFileName)
+    usage ();
+  if (threads < 1)
+    threads = 1;
+
+  // Whole years run to January 1; a fraction of a year is rounded to
+  // whole hours so that MSL is over a whole number of samples.
+  const Time begin (yearStart (firstYear));
+  const Time end (years == floor (years)
+                  ? yearStart (firstYear + (int)years)
+                  : begin + llround (years * 365.2425 * 24.0) * 3600);
+
+  try {
+    Database db (tcdFileName);
+    if (record >= (int)db.numRecords()) {
+      fprintf (stderr, "No record %d in %s\n", record, tcdFileName);
+      exit (-1);
+    }
+    const uint32_t first (record < 0 ? 0 : record),
+                   last (record < 0 ? db.numRecords() : record + 1);
+    std::vector<Result> results (last - first);
+    std::atomic<uint32_t> next (first);
+    std::atomic<bool> failed (false);
+    std::string failure;
+
+    // Stations are handed out one at a time; each takes long enough
+    // that contention on next doesn't matter.
+    auto work = [&] () {
+      uint32_t r;
+      while ((r = next++) < last && !failed) {
+        Result &result (results[r - first]);
+        Station station;
+        try {
+          station = db.loadStation (r);
+        } catch (const Error &) {
+          result.ok = false;    // subordinate; reported below
+          continue;
+        }
+        // y25nf.datums.json is relative to the mean of the harmonic
+        // constants, not to the station datum.
+        station.datumOffset = 0.0;
+        try {
+          Predictor predictor (db, station);
+          result.datums = computeDatums (predictor, begin, end, dayLength);
+        } catch (const Error &e) {
+          if (!failed.exchange (true))
+            failure = e.what();
+          return;
+        }
+        result.ok = true;
+        result.name = gaugeName (station.name);
+        result.latitude = station.latitude;
+        result.longitude = station.longitude;
+      }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i (1); i < threads; ++i)
+      pool.emplace_back (work);
+    work ();
+    for (std::thread &thread: pool)
+      thread.join ();
+    if (failed)
+      throw Error (failure);
+
+    uint32_t skipped (0);
+    bool firstOut (true);
+    putchar ('[');
+    for (uint32_t r (first); r < last; ++r) {
+      const Result &result (results[r - first]);
+      if (!result.ok) {
+        ++skipped;
+        continue;
+      }
+      printf ("%s{\"index\": %u, \"name\": ", firstOut ? "" : ",\n ", r);
+      firstOut = false;
+      printString (result.name);
+      printf (", \"Lat\": %.9g, \"Lon\": %.9g", result.latitude,
+              result.longitude);
+      const Datums &d (result.datums);
+      printDatum ("HAT", d.HAT);
+      printDatum ("MHHW", d.MHHW);
+      printDatum ("MHW", d.MHW);
+      printDatum ("MSL", d.MSL);
+      printDatum ("MTL", d.MTL);
+      printDatum ("MLW", d.MLW);
+      printDatum ("MLLW", d.MLLW);
+      printDatum ("LAT", d.LAT);
+      putchar ('}');
+    }
+    printf ("]\n");
+    if (skipped)
+      fprintf (stderr, "tide_datums: skipped %u subordinate stations\n",
+               skipped);
+  } catch (const Error &e) {
+    fprintf (stderr, "tide_datums: %s\n", e.what());
+    exit (-1);
+  }
+  return 0;
+}
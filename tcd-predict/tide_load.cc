@@ -0,0 +1,341 @@
+/*  tide_load:  load tide_server with concurrent requests and report
+    their latencies.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+// Each connection keeps pipeline requests outstanding, each for a
+// station chosen at random (from a hot set of stations with -k) at a
+// time chosen at random in the year.  Latency is measured from sending
+// a request to reading the end of its response.
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <thread>
+#include "TcdPredict"
+
+using namespace TcdPredict;
+typedef std::chrono::steady_clock Clock;
+
+
+static void usage () {
+  fprintf (stderr,
+    "Usage: tide_load -u socket [-c connections] [-p pipeline] [-d seconds]\n"
+    "                 [-m point:series:events:nearest] [-k stations]\n"
+    "                 [-y year] [-r seed] [-S]\n"
+    "Defaults are 16 connections, 8 requests outstanding on each, 10\n"
+    "seconds, a mix of 80:10:5:5, every station, and 2025.  A series is a\n"
+    "day at 6-minute steps and events cover two days.  Subordinate\n"
+    "current stations, which the server cannot predict, are left out.  -S\n"
+    "prints the server's counters at the end.\n");
+  exit (-1);
+}
+
+
+static const int kinds = 4;
+static const char *const kindNames[kinds] = {
+  "point", "series", "events", "nearest"
+};
+
+
+static int connectTo (const std::string &path) {
+  sockaddr_un addr;
+  memset (&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof addr.sun_path)
+    throw Error ("socket path too long: " + path);
+  strcpy (addr.sun_path, path.c_str());
+  const int fd (socket (AF_UNIX, SOCK_STREAM, 0));
+  if (fd < 0 || connect (fd, (sockaddr *)&addr, sizeof addr))
+    throw Error ("can't connect to " + path + ": " + strerror (errno));
+  return fd;
+}
+
+
+// Buffered reading of lines from the server, and sending requests.
+class Client {
+public:
+
+  explicit Client (const std::string &path): fd_ (connectTo (path)),
+                                             begin_ (0) {}
+  ~Client () { close (fd_); }
+
+  void send (const std::string &s) {
+    for (size_t done (0); done < s.size(); ) {
+      const ssize_t n (::send (fd_, s.data() + done, s.size() - done,
+                               MSG_NOSIGNAL));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        throw Error ("the server closed the connection");
+      done += n;
+    }
+  }
+
+  std::string line () {
+    for (;;) {
+      const size_t end (buffer_.find ('\n', begin_));
+      if (end != std::string::npos) {
+        std::string line (buffer_, begin_, end - begin_);
+        begin_ = end + 1;
+        return line;
+      }
+      buffer_.erase (0, begin_);
+      begin_ = 0;
+      char chunk[65536];
+      const ssize_t n (recv (fd_, chunk, sizeof chunk, 0));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        throw Error ("the server closed the connection");
+      buffer_.append (chunk, n);
+    }
+  }
+
+  // Reads one response; returns false for an error, and the lines of
+  // one that succeeded if lines is not null.
+  bool response (std::vector<std::string> *lines) {
+    const std::string head (line ());
+    if (head.compare (0, 3, "ok "))
+      return false;
+    const unsigned long n (strtoul (head.c_str() + 3, NULL, 10));
+    for (unsigned long i (0); i < n; ++i)
+      if (lines)
+        lines->push_back (line ());
+      else
+        line ();
+    return true;
+  }
+
+private:
+  Client (const Client &) = delete;
+  Client &operator= (const Client &) = delete;
+
+  const int fd_;
+  std::string buffer_;
+  size_t begin_;
+};
+
+
+struct Results {
+  std::vector<double> us[kinds];
+  uint64_t errors[kinds];
+};
+
+
+static double quantile (const std::vector<double> &sorted, double q) {
+  return sorted.empty() ? 0.0 :
+    sorted[std::min (sorted.size() - 1, (size_t)(q * sorted.size()))];
+}
+
+
+int main (int argc, char **argv) {
+
+  const char *socketName (NULL);
+  unsigned connections (16), pipeline (8);
+  double seconds (10.0);
+  double weights[kinds] = {80, 10, 5, 5};
+  size_t hot (0);
+  int year (2025);
+  unsigned seed (1);
+  bool serverStats (false);
+
+  for (int argnum (1); argnum < argc; ++argnum) {
+    const char *arg (argv[argnum]);
+    if (arg[0] == '-' && arg[1] && !arg[2] && strchr ("ucpdmkyr", arg[1])) {
+      if (++argnum >= argc)
+        usage ();
+      const char *val (argv[argnum]);
+      switch (arg[1]) {
+      case 'u':
+        socketName = val;
+        break;
+      case 'c':
+        connections = atoi (val);
+        break;
+      case 'p':
+        pipeline = atoi (val);
+        break;
+      case 'd':
+        seconds = atof (val);
+        break;
+      case 'm':
+        if (sscanf (val, "%lf:%lf:%lf:%lf", &weights[0], &weights[1],
+                    &weights[2], &weights[3]) != kinds)
+          usage ();
+        break;
+      case 'k':
+        hot = atol (val);
+        break;
+      case 'y':
+        year = atoi (val);
+        break;
+      case 'r':
+        seed = atoi (val);
+        break;
+      }
+    } else if (!strcmp (arg, "-S"))
+      serverStats = true;
+    else
+      usage ();
+  }
+  if (!socketName || !connections || !pipeline || !(seconds > 0.0))
+    usage ();
+  for (double w: weights)
+    if (!(w >= 0.0))
+      usage ();
+
+  try {
+    // The stations worth asking for, hot ones first.
+    std::vector<int32_t> records;
+    {
+      Client client (socketName);
+      std::vector<std::string> lines;
+      client.send ("stations\n");
+      if (!client.response (&lines))
+        throw Error ("the server would not list its stations");
+      for (const std::string &line: lines) {
+        int record;
+        char kind[8], units[64];
+        if (sscanf (line.c_str(), "%d %*f %*f %7s %63s", &record, kind,
+                    units) == 3 &&
+            (strcmp (kind, "sub") || strcmp (units, "knots")))
+          records.push_back (record);
+      }
+    }
+    if (records.empty())
+      throw Error ("the server has no stations");
+    std::mt19937_64 shuffler (seed);
+    std::shuffle (records.begin(), records.end(), shuffler);
+    if (hot && hot < records.size())
+      records.resize (hot);
+
+    const Time first (yearStart (year)), length (yearStart (year + 1) -
+                                                 first - 2 * 86400);
+    std::vector<Results> results (connections);
+    std::vector<std::thread> threads;
+    const Clock::time_point start (Clock::now());
+    const Clock::time_point deadline (
+      start + std::chrono::duration_cast<Clock::duration> (
+        std::chrono::duration<double> (seconds)));
+    std::atomic<bool> failed (false);
+
+    for (unsigned c (0); c < connections; ++c)
+      threads.emplace_back ([&, c] {
+        Results &r (results[c]);
+        std::fill (r.errors, r.errors + kinds, 0);
+        try {
+          Client client (socketName);
+          std::mt19937_64 rng (seed * 1000003ULL + c);
+          std::discrete_distribution<int> kind (weights, weights + kinds);
+          std::uniform_int_distribution<size_t> station (0,
+                                                         records.size() - 1);
+          std::uniform_int_distribution<Time> when (0, length);
+          std::uniform_real_distribution<double> unit (-1.0, 1.0);
+          std::deque<std::pair<int, Clock::time_point> > sent;
+          std::string out;
+          for (;;) {
+            const Clock::time_point now (Clock::now());
+            out.clear ();
+            while (now < deadline && sent.size() < pipeline) {
+              const int k (kind (rng));
+              const long long t (first + when (rng));
+              const int record (records[station (rng)]);
+              char request[128];
+              switch (k) {
+              case 0:
+                snprintf (request, sizeof request, "point %d %lld\n",
+                          record, t);
+                break;
+              case 1:
+                snprintf (request, sizeof request, "series %d %lld 360 240\n",
+                          record, t);
+                break;
+              case 2:
+                snprintf (request, sizeof request, "events %d %lld %lld\n",
+                          record, t, t + 2 * 86400);
+                break;
+              default:
+                snprintf (request, sizeof request, "nearest %.4f %.4f 5\n",
+                          asin (unit (rng)) * 180.0 / M_PI,
+                          unit (rng) * 180.0);
+                break;
+              }
+              out += request;
+              sent.emplace_back (k, now);
+            }
+            if (!out.empty())
+              client.send (out);
+            if (sent.empty())
+              break;
+            const bool ok (client.response (NULL));
+            const int k (sent.front().first);
+            r.us[k].push_back (std::chrono::duration<double, std::micro> (
+                                 Clock::now() - sent.front().second).count());
+            r.errors[k] += !ok;
+            sent.pop_front ();
+          }
+        } catch (const Error &e) {
+          fprintf (stderr, "tide_load: %s\n", e.what());
+          failed = true;
+        }
+      });
+    for (std::thread &t: threads)
+      t.join ();
+    const double elapsed (std::chrono::duration<double> (Clock::now() -
+                                                         start).count());
+
+    uint64_t total (0);
+    for (const Results &r: results)
+      for (int k (0); k < kinds; ++k)
+        total += r.us[k].size();
+    printf ("%u connections, %u outstanding each, %.1f s:  %llu requests,"
+            " %.0f per second\n", connections, pipeline, elapsed,
+            (unsigned long long)total, total / elapsed);
+    printf ("%-8s %9s %7s %9s %9s %9s %9s %9s  (microseconds)\n", "",
+            "count", "errors", "mean", "p50", "p90", "p99", "max");
+    for (int k (0); k < kinds; ++k) {
+      std::vector<double> us;
+      uint64_t errors (0);
+      for (const Results &r: results) {
+        us.insert (us.end(), r.us[k].begin(), r.us[k].end());
+        errors += r.errors[k];
+      }
+      if (us.empty())
+        continue;
+      std::sort (us.begin(), us.end());
+      double sum (0.0);
+      for (double u: us)
+        sum += u;
+      printf ("%-8s %9lu %7llu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+              kindNames[k], (unsigned long)us.size(),
+              (unsigned long long)errors, sum / us.size(),
+              quantile (us, 0.5), quantile (us, 0.9), quantile (us, 0.99),
+              us.back());
+    }
+
+    if (serverStats) {
+      Client client (socketName);
+      std::vector<std::string> lines;
+      client.send ("stats\n");
+      if (client.response (&lines))
+        for (const std::string &line: lines)
+          printf ("server %s\n", line.c_str());
+    }
+    return failed ? 1 : 0;
+  } catch (const Error &e) {
+    fprintf (stderr, "tide_load: %s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,895 @@
+/*  tide_server:  answer tide queries for one TCD file over a Unix socket.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+// The protocol is lines of text.  Each request is one line, and each
+// response is "ok n" followed by n lines, or a single "error message"
+// line.  A client may send any number of requests without waiting and
+// gets the responses in the same order.  Times are Unix seconds, and
+// heights are in station units above the station datum.
+
+//   point record time [budget]               n = 1:  height
+//   series record start step count [budget]  n = count:  height
+//   events record begin end [budget]         time height high|low
+//   nearest latitude longitude [n]           record km ref|sub units name
+//   stations                                 record latitude longitude
+//                                              ref|sub units name
+//   stats                                    counters
+
+// budget is as for Predictor::setBudget; it is ignored at subordinate
+// stations.  events gives those with begin ≤ time < end.
+
+// Requests wait in one queue, grouped by station.  A worker takes all
+// the requests for the station that has waited longest, once its first
+// has waited for the batching window (at once if the queue is full),
+// and answers them with one Predictor from a shared CoefficientCache,
+// or for a subordinate station with one ReferenceCache for each week
+// that the requests span.  Requests that name no station are grouped
+// together likewise.
+
+// Backpressure:  a connection's requests stop being read while
+// maxPending of its responses are outstanding, so a client that does
+// not read its responses cannot make the server buffer them; readers
+// wait while the queue is full; and connections beyond the limit wait
+// to be accepted.
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include "TcdPredict"
+
+using namespace TcdPredict;
+typedef std::chrono::steady_clock Clock;
+
+
+static const size_t maxPending = 256;           // responses, per connection
+static const size_t maxLine = 4096;
+static const size_t maxCount = 1 << 20;         // heights in a series
+static const Time maxSpan = 366 * 86400;        // of a series or events
+static const Time weekSpan = 7 * 86400;         // of one ReferenceCache
+static const size_t maxNearest = 100;
+static const double earthRadius = 6371.0;       // km
+
+
+static void usage () {
+  fprintf (stderr,
+    "Usage: tide_server -u socket [-j threads] [-w window] [-q queue]\n"
+    "                   [-c connections] [-m megabytes] file.tcd\n"
+    "Listens on the Unix socket until interrupted, then prints its\n"
+    "counters.  Threads default to one per processor.  Requests for one\n"
+    "station that arrive within window milliseconds (default 0.2) of\n"
+    "each other are answered together.  The queue holds at most queue\n"
+    "requests (default 4096), at most connections clients are served at\n"
+    "once (default 256), and the coefficient cache may use megabytes\n"
+    "(default 64).\n");
+  exit (-1);
+}
+
+
+enum class Kind { point, series, events, nearest, stations, stats };
+static const int kinds = 6;
+static const char *const kindNames[kinds] = {
+  "point", "series", "events", "nearest", "stations", "stats"
+};
+
+
+static void appendf (std::string &s, const char *format, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+static void appendf (std::string &s, const char *format, ...) {
+  char line[512];
+  va_list args;
+  va_start (args, format);
+  const int n (vsnprintf (line, sizeof line, format, args));
+  va_end (args);
+  s.append (line, std::min<size_t> (std::max (n, 0), sizeof line - 1));
+}
+
+
+// Sends all of it, or returns false if the connection has failed.
+static bool sendAll (int fd, const std::string &s) {
+  for (size_t done (0); done < s.size(); ) {
+    const ssize_t n (send (fd, s.data() + done, s.size() - done,
+                           MSG_NOSIGNAL));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  return true;
+}
+
+
+// Latencies, from when a request was read to when its response was
+// ready, counted in buckets a quarter of an octave wide.
+class Latencies {
+public:
+
+  Latencies (): count_ (0), errors_ (0), sum_ (0.0), max_ (0.0),
+                bucket_ (buckets) {}
+
+  void add (double us, bool error) {
+    const int b (us < 1.0 ? 0 :
+                 std::min (buckets - 1, 1 + (int)(4.0 * log2 (us))));
+    std::lock_guard<std::mutex> lock (lock_);
+    ++count_;
+    errors_ += error;
+    sum_ += us;
+    max_ = std::max (max_, us);
+    ++bucket_[b];
+  }
+
+  // count, errors, and the mean, median, 90th and 99th percentiles
+  // (to the top of their buckets), and maximum in microseconds.
+  std::string summary () const {
+    std::lock_guard<std::mutex> lock (lock_);
+    std::string s;
+    appendf (s, "count %llu errors %llu mean_us %.1f p50_us %.1f"
+             " p90_us %.1f p99_us %.1f max_us %.1f",
+             (unsigned long long)count_, (unsigned long long)errors_,
+             count_ ? sum_ / count_ : 0.0, quantile (0.5), quantile (0.9),
+             quantile (0.99), max_);
+    return s;
+  }
+
+private:
+  static const int buckets = 129;
+
+  double quantile (double q) const {
+    const uint64_t rank ((uint64_t)ceil (q * count_));
+    uint64_t seen (0);
+    for (int b (0); b < buckets; ++b)
+      if ((seen += bucket_[b]) >= rank && seen)
+        return std::min (max_, b ? exp2 (b / 4.0) : 1.0);
+    return max_;
+  }
+
+  mutable std::mutex lock_;
+  uint64_t count_, errors_;
+  double sum_, max_;
+  std::vector<uint64_t> bucket_;
+};
+
+
+// One client.  Its reader numbers the requests, and its writer sends
+// the responses in that order as they are completed.
+struct Connection {
+  explicit Connection (int fd): fd (fd), issued (0), written (0),
+                                reading (true), broken (false) {}
+
+  void complete (uint64_t seq, std::string &&response) {
+    std::lock_guard<std::mutex> guard (lock);
+    done.emplace (seq, std::move (response));
+    changed.notify_all ();
+  }
+
+  const int fd;
+  std::mutex lock;
+  std::condition_variable changed;
+  std::map<uint64_t, std::string> done; // completed, not yet written
+  uint64_t issued, written;
+  bool reading, broken;
+};
+
+
+struct Request {
+  std::shared_ptr<Connection> connection;
+  uint64_t seq;
+  Kind kind;
+  int32_t key;                  // station record, or -1 for none
+  Time start, end;              // of the times asked for
+  int64_t step;
+  size_t count;
+  double budget;
+  double latitude, longitude;
+  Clock::time_point arrival;
+};
+
+
+// Waiting requests, grouped by key and taken a group at a time in order
+// of their first requests.
+class Queue {
+public:
+
+  Queue (size_t capacity, Clock::duration window):
+    capacity_ (capacity), window_ (window), size_ (0), stalls_ (0),
+    batches_ (0), taken_ (0) {}
+
+  // Waits while the queue is full.
+  void push (Request &&request) {
+    std::unique_lock<std::mutex> lock (lock_);
+    if (size_ >= capacity_) {
+      ++stalls_;
+      space_.wait (lock, [this] { return size_ < capacity_; });
+    }
+    Waiting &w (waiting_[request.key]);
+    if (w.requests.empty()) {
+      w.first = request.arrival;
+      order_.push_back (request.key);
+    }
+    w.requests.push_back (std::move (request));
+    if (++size_ == 1 || size_ >= capacity_)
+      ready_.notify_all ();
+  }
+
+  void take (std::vector<Request> &batch) {
+    std::unique_lock<std::mutex> lock (lock_);
+    for (;;) {
+      if (order_.empty())
+        ready_.wait (lock);
+      else {
+        const Clock::time_point due (waiting_[order_.front()].first +
+                                     window_);
+        if (size_ >= capacity_ || Clock::now() >= due)
+          break;
+        ready_.wait_until (lock, due);
+      }
+    }
+    const auto found (waiting_.find (order_.front()));
+    order_.pop_front ();
+    batch = std::move (found->second.requests);
+    waiting_.erase (found);
+    size_ -= batch.size();
+    ++batches_;
+    taken_ += batch.size();
+    space_.notify_all ();
+    if (!order_.empty())
+      ready_.notify_one ();
+  }
+
+  std::string summary () const {
+    std::lock_guard<std::mutex> lock (lock_);
+    std::string s;
+    appendf (s, "queue waiting %lu capacity %lu stalls %llu\n"
+             "batches count %llu requests %llu mean %.2f\n",
+             (unsigned long)size_, (unsigned long)capacity_,
+             (unsigned long long)stalls_, (unsigned long long)batches_,
+             (unsigned long long)taken_,
+             batches_ ? (double)taken_ / batches_ : 0.0);
+    return s;
+  }
+
+private:
+  struct Waiting {
+    Clock::time_point first;
+    std::vector<Request> requests;
+  };
+
+  const size_t capacity_;
+  const Clock::duration window_;
+  mutable std::mutex lock_;
+  std::condition_variable ready_, space_;
+  std::unordered_map<int32_t, Waiting> waiting_;
+  std::deque<int32_t> order_;
+  size_t size_;
+  uint64_t stalls_, batches_, taken_;
+};
+
+
+class Server {
+public:
+
+  Server (const Database &db, unsigned threads, Clock::duration window,
+          size_t queue, size_t connections, size_t cacheBytes);
+
+  void run (int listener);
+  std::string stats () const;
+
+private:
+  // A station, reference or subordinate.
+  struct Entry {
+    int32_t record;
+    std::string name, units;
+    double latitude, longitude;
+    double x, y, z;             // on the unit sphere, for nearest
+    int32_t sub;                // in subordinates_, or -1
+  };
+
+  void accept (int listener);
+  void serve (std::shared_ptr<Connection> connection);
+  void write (Connection &connection);
+  void read (const std::shared_ptr<Connection> &connection,
+             const std::string &line);
+  void parse (const std::vector<std::string> &words, Request &request)
+    const;
+  void work ();
+  void answer (std::vector<Request> &batch);
+  template <class F> void respond (Request &request, F f);
+  size_t predict (Predictor &predictor, const Request &request,
+                  std::string &body);
+  size_t predict (ReferenceCache &refs, const Subordinate &sub,
+                  const Request &request, std::string &body);
+  size_t catalogue (const Request &request, std::string &body);
+
+  const Database &db_;
+  const unsigned threads_;
+  const size_t maxConnections_;
+  const Clock::time_point started_;
+  CoefficientCache cache_;
+  Queue queue_;
+  std::vector<Entry> entries_;
+  std::vector<int32_t> index_;          // record to entry
+  std::vector<Subordinate> subordinates_;
+  Latencies latencies_[kinds];
+
+  mutable std::mutex connectionLock_;
+  std::condition_variable connectionFree_;
+  size_t active_;
+  uint64_t accepted_;
+};
+
+
+Server::Server (const Database &db, unsigned threads, Clock::duration window,
+                size_t queue, size_t connections, size_t cacheBytes):
+  db_ (db),
+  threads_ (threads),
+  maxConnections_ (connections),
+  started_ (Clock::now()),
+  cache_ (db, cacheBytes),
+  queue_ (queue, window),
+  index_ (db.numRecords(), -1),
+  active_ (0),
+  accepted_ (0) {
+  auto add = [this] (const auto &station, int32_t sub) {
+    const double lat (station.latitude * M_PI / 180.0),
+      lon (station.longitude * M_PI / 180.0);
+    entries_.push_back (Entry {station.record, station.name, station.units,
+                               station.latitude, station.longitude,
+                               cos (lat) * cos (lon), cos (lat) * sin (lon),
+                               sin (lat), sub});
+  };
+  for (const Station &station: db.loadStations (threads))
+    add (station, -1);
+  subordinates_ = db.loadSubordinates (threads);
+  for (size_t i (0); i < subordinates_.size(); ++i)
+    add (subordinates_[i], i);
+  std::sort (entries_.begin(), entries_.end(),
+             [] (const Entry &a, const Entry &b) {
+               return a.record < b.record;
+             });
+  for (size_t i (0); i < entries_.size(); ++i)
+    index_[entries_[i].record] = i;
+}
+
+
+void Server::run (int listener) {
+  for (unsigned t (0); t < threads_; ++t)
+    std::thread (&Server::work, this).detach ();
+  std::thread (&Server::accept, this, listener).detach ();
+}
+
+
+void Server::accept (int listener) {
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock (connectionLock_);
+      connectionFree_.wait (lock, [this] {
+        return active_ < maxConnections_;
+      });
+    }
+    const int fd (::accept (listener, NULL, NULL));
+    if (fd < 0) {
+      if (errno != EINTR && errno != ECONNABORTED) {
+        perror ("tide_server: accept");
+        std::this_thread::sleep_for (std::chrono::milliseconds (100));
+      }
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock (connectionLock_);
+      ++active_;
+      ++accepted_;
+    }
+    std::thread (&Server::serve, this, std::make_shared<Connection> (fd))
+      .detach ();
+  }
+}
+
+
+// The reader, which starts the writer and, once the client has stopped
+// sending and every response is written, closes the connection.
+void Server::serve (std::shared_ptr<Connection> connection) {
+  std::thread writer (&Server::write, this, std::ref (*connection));
+  std::string buffer;
+  char chunk[65536];
+  for (;;) {
+    const ssize_t n (recv (connection->fd, chunk, sizeof chunk, 0));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    buffer.append (chunk, n);
+    size_t begin (0);
+    for (size_t end; (end = buffer.find ('\n', begin)) != std::string::npos;
+         begin = end + 1)
+      read (connection, buffer.substr (begin, end - begin));
+    buffer.erase (0, begin);
+    if (buffer.size() > maxLine) {
+      std::unique_lock<std::mutex> lock (connection->lock);
+      connection->done.emplace (connection->issued++,
+                                "error request too long\n");
+      connection->changed.notify_all ();
+      break;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock (connection->lock);
+    connection->reading = false;
+    connection->changed.notify_all ();
+  }
+  writer.join ();
+  close (connection->fd);
+  std::lock_guard<std::mutex> lock (connectionLock_);
+  --active_;
+  connectionFree_.notify_one ();
+}
+
+
+// Sends whatever run of responses is ready next, in one write.  Once
+// the connection has failed, the rest are dropped as they come.
+void Server::write (Connection &connection) {
+  std::string out;
+  for (;;) {
+    bool broken;
+    {
+      std::unique_lock<std::mutex> lock (connection.lock);
+      connection.changed.wait (lock, [&connection] {
+        return (!connection.done.empty() &&
+                connection.done.begin()->first == connection.written) ||
+          (!connection.reading && connection.written == connection.issued);
+      });
+      if (connection.done.empty() ||
+          connection.done.begin()->first != connection.written)
+        return;
+      out.clear ();
+      auto i (connection.done.begin());
+      for (; i != connection.done.end() && i->first == connection.written;
+           ++i, ++connection.written)
+        out += i->second;
+      connection.done.erase (connection.done.begin(), i);
+      connection.changed.notify_all ();
+      broken = connection.broken;
+    }
+    if (!broken && !sendAll (connection.fd, out)) {
+      std::lock_guard<std::mutex> lock (connection.lock);
+      connection.broken = true;
+    }
+  }
+}
+
+
+// Queues one request, or answers it at once if it is malformed.
+void Server::read (const std::shared_ptr<Connection> &connection,
+                   const std::string &line) {
+  Request request;
+  request.connection = connection;
+  {
+    std::unique_lock<std::mutex> lock (connection->lock);
+    connection->changed.wait (lock, [&connection] {
+      return connection->issued - connection->written < maxPending;
+    });
+    request.seq = connection->issued++;
+  }
+  request.arrival = Clock::now ();
+
+  std::vector<std::string> words;
+  for (size_t i (0); ; ) {
+    i = line.find_first_not_of (" \t\r", i);
+    if (i == std::string::npos)
+      break;
+    const size_t end (line.find_first_of (" \t\r", i));
+    words.push_back (line.substr (i, end - i));
+    i = end;
+  }
+  request.kind = Kind::stats;
+  try {
+    parse (words, request);
+  } catch (const Error &e) {
+    connection->complete (request.seq, std::string ("error ") + e.what() +
+                          "\n");
+    return;
+  }
+  queue_.push (std::move (request));
+}
+
+
+static int64_t toInt (const std::string &s) {
+  char *end;
+  errno = 0;
+  const long long v (strtoll (s.c_str(), &end, 10));
+  if (s.empty() || *end || errno)
+    throw Error ("bad number " + s);
+  return v;
+}
+
+
+static double toDouble (const std::string &s) {
+  char *end;
+  const double v (strtod (s.c_str(), &end));
+  if (s.empty() || *end || !std::isfinite (v))
+    throw Error ("bad number " + s);
+  return v;
+}
+
+
+void Server::parse (const std::vector<std::string> &words,
+                    Request &request) const {
+  static const char *const forms[kinds] = {
+    "point record time [budget]",
+    "series record start step count [budget]",
+    "events record begin end [budget]",
+    "nearest latitude longitude [n]",
+    "stations",
+    "stats"
+  };
+  static const size_t required[kinds] = {3, 5, 4, 3, 1, 1};
+  static const size_t allowed[kinds] = {4, 6, 5, 4, 1, 1};
+  if (words.empty())
+    throw Error ("empty request");
+  int k (0);
+  while (k < kinds && words[0] != kindNames[k])
+    ++k;
+  if (k == kinds)
+    throw Error ("unknown request " + words[0]);
+  if (words.size() < required[k] || words.size() > allowed[k])
+    throw Error (std::string ("usage: ") + forms[k]);
+  request.kind = (Kind)k;
+  request.key = -1;
+  request.step = 1;
+  request.count = 1;
+  request.budget = 0.0;
+
+  switch (request.kind) {
+  case Kind::point:
+  case Kind::series:
+  case Kind::events:
+    {
+      const int64_t record (toInt (words[1]));
+      if (record < 0 || record >= (int64_t)index_.size() ||
+          index_[record] < 0)
+        throw Error ("no station " + words[1]);
+      request.key = record;
+      request.start = request.end = toInt (words[2]);
+      if (request.kind == Kind::series) {
+        request.step = toInt (words[3]);
+        const int64_t count (toInt (words[4]));
+        if (request.step <= 0 || count <= 0 || (uint64_t)count > maxCount)
+          throw Error ("step and count must be positive, and count at most " +
+                       std::to_string (maxCount));
+        if (request.step > maxSpan / count)
+          throw Error ("the series spans more than a year");
+        request.count = count;
+        request.end = request.start + (count - 1) * request.step;
+      } else if (request.kind == Kind::events) {
+        request.end = toInt (words[3]);
+        if (request.end < request.start ||
+            request.end - request.start > maxSpan)
+          throw Error ("end must follow begin by at most a year");
+      }
+      if (words.size() == allowed[k] &&
+          !((request.budget = toDouble (words.back())) >= 0.0))
+        throw Error ("the budget must not be negative");
+    }
+    break;
+  case Kind::nearest:
+    request.latitude = toDouble (words[1]);
+    request.longitude = toDouble (words[2]);
+    if (fabs (request.latitude) > 90.0)
+      throw Error ("bad latitude " + words[1]);
+    if (words.size() == 4) {
+      const int64_t n (toInt (words[3]));
+      if (n <= 0 || (uint64_t)n > maxNearest)
+        throw Error ("n must be from 1 to " + std::to_string (maxNearest));
+      request.count = n;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+
+void Server::work () {
+  std::vector<Request> batch;
+  for (;;) {
+    queue_.take (batch);
+    answer (batch);
+  }
+}
+
+
+template <class F> void Server::respond (Request &request, F f) {
+  std::string body, response;
+  bool ok (true);
+  try {
+    const size_t lines (f (body));
+    response = "ok " + std::to_string (lines) + "\n";
+    response += body;
+  } catch (const Error &e) {
+    ok = false;
+    response = std::string ("error ") + e.what() + "\n";
+  }
+  latencies_[(int)request.kind].add (
+    std::chrono::duration<double, std::micro> (Clock::now() -
+                                               request.arrival).count(),
+    !ok);
+  request.connection->complete (request.seq, std::move (response));
+}
+
+
+void Server::answer (std::vector<Request> &batch) {
+  const int32_t key (batch.front().key);
+  if (key < 0) {
+    for (Request &request: batch)
+      respond (request, [&] (std::string &body) {
+        return catalogue (request, body);
+      });
+    return;
+  }
+
+  const Entry &entry (entries_[index_[key]]);
+  if (entry.sub < 0) {
+    std::unique_ptr<Predictor> predictor;
+    for (Request &request: batch)
+      respond (request, [&] (std::string &body) {
+        if (!predictor)
+          predictor.reset (new Predictor (cache_, key));
+        return predict (*predictor, request, body);
+      });
+    return;
+  }
+
+  // The reference curve costs as much as a week of margins on either
+  // side, so requests are taken in runs of at most a week.
+  const Subordinate &sub (subordinates_[entry.sub]);
+  std::sort (batch.begin(), batch.end(),
+             [] (const Request &a, const Request &b) {
+               return a.start < b.start;
+             });
+  for (size_t i (0), j; i < batch.size(); i = j) {
+    Time end (batch[i].end);
+    for (j = i + 1; j < batch.size() &&
+           std::max (end, batch[j].end) - batch[i].start <= weekSpan; ++j)
+      end = std::max (end, batch[j].end);
+    ReferenceCache refs (db_, batch[i].start, end);
+    for (size_t k (i); k < j; ++k)
+      respond (batch[k], [&] (std::string &body) {
+        return predict (refs, sub, batch[k], body);
+      });
+  }
+}
+
+
+size_t Server::predict (Predictor &predictor, const Request &request,
+                        std::string &body) {
+  if (predictor.budget() != request.budget)
+    predictor.setBudget (request.budget);
+  switch (request.kind) {
+  case Kind::point:
+    appendf (body, "%.6f\n", predictor.height (request.start));
+    return 1;
+  case Kind::series:
+    {
+      std::vector<double> heights (request.count);
+      predictor.series (request.start, request.step, request.count,
+                        heights.data());
+      for (double h: heights)
+        appendf (body, "%.6f\n", h);
+      return heights.size();
+    }
+  default:
+    {
+      const std::vector<Event> events (predictor.events (request.start,
+                                                         request.end));
+      for (const Event &e: events)
+        appendf (body, "%lld %.6f %s\n", (long long)e.time, e.height,
+                 e.high ? "high" : "low");
+      return events.size();
+    }
+  }
+}
+
+
+size_t Server::predict (ReferenceCache &refs, const Subordinate &sub,
+                        const Request &request, std::string &body) {
+  if (request.kind == Kind::events) {
+    size_t n (0);
+    for (const Event &e: refs.events (sub))
+      if (e.time >= request.start && e.time < request.end) {
+        appendf (body, "%lld %.6f %s\n", (long long)e.time, e.height,
+                 e.high ? "high" : "low");
+        ++n;
+      }
+    return n;
+  }
+  std::vector<double> heights (request.count);
+  refs.series (sub, request.start, request.step, request.count,
+               heights.data());
+  for (double h: heights)
+    appendf (body, "%.6f\n", h);
+  return heights.size();
+}
+
+
+size_t Server::catalogue (const Request &request, std::string &body) {
+  switch (request.kind) {
+  case Kind::nearest:
+    {
+      // Nearest first is largest cosine first.
+      const double lat (request.latitude * M_PI / 180.0),
+        lon (request.longitude * M_PI / 180.0);
+      const double x (cos (lat) * cos (lon)), y (cos (lat) * sin (lon)),
+        z (sin (lat));
+      std::vector<std::pair<double, size_t> > near (entries_.size());
+      for (size_t i (0); i < entries_.size(); ++i) {
+        const Entry &e (entries_[i]);
+        near[i] = std::make_pair (-(x * e.x + y * e.y + z * e.z), i);
+      }
+      const size_t n (std::min (request.count, near.size()));
+      std::partial_sort (near.begin(), near.begin() + n, near.end());
+      for (size_t i (0); i < n; ++i) {
+        const Entry &e (entries_[near[i].second]);
+        appendf (body, "%d %.3f %s %s ", e.record,
+                 earthRadius * acos (std::min (1.0, -near[i].first)),
+                 e.sub < 0 ? "ref" : "sub", e.units.c_str());
+        body += e.name + "\n";
+      }
+      return n;
+    }
+  case Kind::stations:
+    for (const Entry &e: entries_) {
+      appendf (body, "%d %.6f %.6f %s %s ", e.record, e.latitude,
+               e.longitude, e.sub < 0 ? "ref" : "sub", e.units.c_str());
+      body += e.name + "\n";
+    }
+    return entries_.size();
+  default:
+    body = stats ();
+    return std::count (body.begin(), body.end(), '\n');
+  }
+}
+
+
+std::string Server::stats () const {
+  std::string s;
+  appendf (s, "uptime_s %.1f\n",
+           std::chrono::duration<double> (Clock::now() - started_).count());
+  {
+    std::lock_guard<std::mutex> lock (connectionLock_);
+    appendf (s, "connections active %lu accepted %llu\n",
+             (unsigned long)active_, (unsigned long long)accepted_);
+  }
+  s += queue_.summary ();
+  const CoefficientCache::Stats cache (cache_.stats());
+  appendf (s, "cache bytes %lu capacity %lu stations %lu folds %lu"
+           " hits %llu misses %llu evictions %llu\n",
+           (unsigned long)cache.bytes, (unsigned long)cache.capacity,
+           (unsigned long)cache.stations, (unsigned long)cache.folds,
+           (unsigned long long)cache.hits, (unsigned long long)cache.misses,
+           (unsigned long long)cache.evictions);
+  for (int k (0); k < kinds; ++k)
+    s += std::string (kindNames[k]) + " " + latencies_[k].summary() + "\n";
+  return s;
+}
+
+
+// A socket file left by a server that has gone is removed; one that a
+// server still answers on is not.
+static int listenOn (const std::string &path) {
+  sockaddr_un addr;
+  memset (&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof addr.sun_path)
+    throw Error ("socket path too long: " + path);
+  strcpy (addr.sun_path, path.c_str());
+  const int probe (socket (AF_UNIX, SOCK_STREAM, 0));
+  if (probe < 0)
+    throw Error (std::string ("socket: ") + strerror (errno));
+  const bool inUse (connect (probe, (sockaddr *)&addr, sizeof addr) == 0);
+  const bool stale (!inUse && errno == ECONNREFUSED);
+  close (probe);
+  if (inUse)
+    throw Error (path + " is in use by another server");
+  if (stale)
+    unlink (path.c_str());
+
+  const int fd (socket (AF_UNIX, SOCK_STREAM, 0));
+  if (fd < 0 || bind (fd, (sockaddr *)&addr, sizeof addr) ||
+      listen (fd, 128))
+    throw Error ("can't listen on " + path + ": " + strerror (errno));
+  return fd;
+}
+
+
+int main (int argc, char **argv) {
+
+  const char *tcdFileName (NULL), *socketName (NULL);
+  unsigned threads (std::thread::hardware_concurrency());
+  double window (0.2);
+  size_t queue (4096), connections (256), megabytes (64);
+
+  for (int argnum (1); argnum < argc; ++argnum) {
+    const char *arg (argv[argnum]);
+    if (arg[0] == '-' && arg[1] && !arg[2] && strchr ("ujwqcm", arg[1])) {
+      if (++argnum >= argc)
+        usage ();
+      const char *val (argv[argnum]);
+      switch (arg[1]) {
+      case 'u':
+        socketName = val;
+        break;
+      case 'j':
+        threads = atoi (val);
+        break;
+      case 'w':
+        window = atof (val);
+        break;
+      case 'q':
+        queue = atol (val);
+        break;
+      case 'c':
+        connections = atol (val);
+        break;
+      case 'm':
+        megabytes = atol (val);
+        break;
+      }
+    } else if (arg[0] != '-' && !tcdFileName)
+      tcdFileName = arg;
+    else
+      usage ();
+  }
+  if (!tcdFileName || !socketName || !(window >= 0.0) || !queue ||
+      !connections)
+    usage ();
+  threads = std::max (1U, threads);
+
+  // Every thread inherits this, so that the signals reach only
+  // sigwait below.
+  sigset_t signals;
+  sigemptyset (&signals);
+  sigaddset (&signals, SIGINT);
+  sigaddset (&signals, SIGTERM);
+  pthread_sigmask (SIG_BLOCK, &signals, NULL);
+
+  try {
+    Database db (tcdFileName);
+    Server server (db, threads,
+                   std::chrono::duration_cast<Clock::duration> (
+                     std::chrono::duration<double, std::milli> (window)),
+                   queue, connections, megabytes << 20);
+    const int listener (listenOn (socketName));
+    server.run (listener);
+    fprintf (stderr, "tide_server: serving %s on %s with %u threads\n",
+             tcdFileName, socketName, threads);
+
+    int caught;
+    sigwait (&signals, &caught);
+    close (listener);
+    unlink (socketName);
+    fputs (server.stats().c_str(), stderr);
+    // The threads are still blocked in accept and take; leave without
+    // tearing down what they use.
+    fflush (stderr);
+    _exit (0);
+  } catch (const Error &e) {
+    fprintf (stderr, "tide_server: %s\n", e.what());
+    exit (-1);
+  }
+  return 0;
+}
@@ -0,0 +1,106 @@
+/*  TcdPredict:  harmonic tide prediction from TCD files.
+
+    This is free and unencumbered software released into the public
+    domain.  See the file LICENSE in the top directory.
+ */
+
+#include <stdio.h>
+#include "TcdPredict"
+
+
+namespace TcdPredict {
+
+
+  // Days since 1970-01-01 of a proleptic Gregorian date, for any year.
+  // This is Howard Hinnant's days_from_civil.
+  static int64_t daysFromCivil (int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+  }
+
+
+  // Inverse of daysFromCivil.
+  static void civilFromDays (int64_t z, int &y, unsigned &m, unsigned &d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = (unsigned)(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = (int)(yoe + era * 400 + (m <= 2));
+  }
+
+
+  static int64_t floorDiv (int64_t a, int64_t b) {
+    return a / b - (a % b < 0);
+  }
+
+
+  Time makeTime (int year, unsigned month, unsigned day,
+                 unsigned hour, unsigned minute, unsigned second) {
+    return daysFromCivil (year, month, day) * 86400 +
+      hour * 3600 + minute * 60 + second;
+  }
+
+
+  Time yearStart (int year) {
+    return daysFromCivil (year, 1, 1) * 86400;
+  }
+
+
+  int yearOf (Time t) {
+    int y;
+    unsigned m, d;
+    civilFromDays (floorDiv (t, 86400), y, m, d);
+    return y;
+  }
+
+
+  bool parseTime (const std::string &s, Time &t) {
+    int year, n (0);
+    unsigned month, day, hour (0), minute (0), second (0);
+    char sep;
+    if (sscanf (s.c_str(), "%d-%u-%u%n", &year, &month, &day, &n) != 3)
+      return false;
+    if (s[n]) {
+      int m (0);
+      if (sscanf (s.c_str() + n, "%c%u:%u%n", &sep, &hour, &minute, &m) != 3
+          || (sep != ' ' && sep != 'T'))
+        return false;
+      n += m;
+      if (s[n] == ':') {
+        m = 0;
+        if (sscanf (s.c_str() + n, ":%u%n", &second, &m) != 1)
+          return false;
+        n += m;
+      }
+      if (s[n])
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 ||
+        minute > 59 || second > 59)
+      return false;
+    t = makeTime (year, month, day, hour, minute, second);
+    return true;
+  }
+
+
+  std::string formatTime (Time t) {
+    int y;
+    unsigned m, d;
+    const int64_t days (floorDiv (t, 86400));
+    const unsigned secs ((unsigned)(t - days * 86400));
+    civilFromDays (days, y, m, d);
+    char buf[40];
+    snprintf (buf, sizeof buf, "%04d-%02u-%02u %02u:%02u:%02u", y, m, d,
+              secs / 3600, secs / 60 % 60, secs % 60);
+    return buf;
+  }
+
+}
@@ -67,6 +67,16 @@
 NV_BOOL parse_xml_station (FILE *fp, TIDE_RECORD *rec);
 NV_BOOL parse_line (NV_CHAR *in, NV_CHAR *search, NV_CHAR *result, size_t rlen);
 
+/* Set by -L:  create the TCD file in libtcd's large format. */
+static NV_BOOL large_format = NVFalse;
+
+#ifdef HAVE_LIBCONGEN
+/* congen_header.cc */
+void CreateTCDFromCongen (NV_CHAR *dbname, const NV_CHAR *input,
+                          NV_INT32 first_year, NV_INT32 last_year,
+                          NV_BOOL large);
+#endif
+
 void format_barf (char const * const barfmessage,
                   char const * const file,
                   int line) {
@@ -78,42 +88,68 @@ your chances of success, copy the formatting of a legacy harmonics file as\n\
 closely as possible.  Even blank lines and comments matter.\n", file, line, barfmessage);
 }
 
-NV_INT32 ProcessHarmonicsFile(FILE* fp, NV_U_INT32 num_constituents)
+/*  True if the harmonics file starts with a congen block, i.e. its first
+    line that isn't a comment is the number of constituents.  Files of
+    stations alone, as used with -c, start with a station.  fp is
+    rewound.  */
+
+static NV_BOOL has_congen_header (FILE *fp)
+{
+    NV_CHAR                    string[256], c;
+    NV_INT32                   num;
+    NV_BOOL                    ret = NVFalse;
+
+    while (fgets (string, sizeof (string), fp))
+    {
+	if (string[0] == '#' || strlen (string) < 2) continue;
+	ret = (sscanf (string, "%d %c", &num, &c) == 1);
+	break;
+    }
+    fseek (fp, 0, SEEK_SET);
+    return ret;
+}
+
+NV_INT32 ProcessHarmonicsFile(FILE* fp, NV_U_INT32 num_constituents,
+			      NV_BOOL by_name)
 {
     NV_CHAR                    string[256], tname[100];
-    NV_INT32                   i, j, num, comment_pos = 0, cnt = 0;
+    NV_FLOAT32                 amp, epoch;
+    NV_INT32                   i, j, k, num, comment_pos = 0, cnt = 0;
     NV_BOOL                    got_units;
     TIDE_RECORD                rec;
     int startover = 1;
 
     /*  XTide format ASCII constituent file.  */
 
-    /*  Skip past the speeds and factors since we already have these.  */
-    i = 0;
-    while (i < 2)
+    if (has_congen_header (fp))
     {
+        /*  Skip past the speeds and factors since we already have these.  */
+        i = 0;
+        while (i < 2)
+        {
+            require (fgets (string, sizeof (string), fp) != NULL);
+	    if (!strncmp (string, "*END*", 5)) ++i;
+        }
+
+        /*  Right now this is hard-wired to get past the verbiage at the
+	    beginning of the constituents.  This is not part of the
+	    comments for the first record and I need to grab those
+	    comments.  */
+        /* DWF 2004-08-09 changed from counting 27 lines to looking for
+           MERCHANTABILITY. */
+        /* DWF 2004-08-15 if not found, it's a warning, not an error. */
+        do {
+          if (!fgets (string, sizeof (string), fp)) {
+            format_barf ("format warning: no tide records found.  Creating valid harmonics file containing constituent definitions only.", "build_tide_db.c", __LINE__);
+            return 0;
+          }
+          require (string[0] == '#');
+        } while (!strstr (string, "MERCHANTABILITY"));
+        /* Lose extra blank */
         require (fgets (string, sizeof (string), fp) != NULL);
-	if (!strncmp (string, "*END*", 5)) ++i;
+        require (!strcmp (string, "#\n"));
     }
 
-    /*  Right now this is hard-wired to get past the verbiage at the
-	beginning of the constituents.  This is not part of the
-	comments for the first record and I need to grab those
-	comments.  */
-    /* DWF 2004-08-09 changed from counting 27 lines to looking for
-       MERCHANTABILITY. */
-    /* DWF 2004-08-15 if not found, it's a warning, not an error. */
-    do {
-      if (!fgets (string, sizeof (string), fp)) {
-        format_barf ("format warning: no tide records found.  Creating valid harmonics file containing constituent definitions only.", "build_tide_db.c", __LINE__);
-        return 0;
-      }
-      require (string[0] == '#');
-    } while (!strstr (string, "MERCHANTABILITY"));
-    /* Lose extra blank */
-    require (fgets (string, sizeof (string), fp) != NULL);
-    require (!strcmp (string, "#\n"));
-
     while (fgets (string, sizeof (string), fp))
     {
         if (startover) {
@@ -289,18 +325,37 @@ NV_INT32 ProcessHarmonicsFile(FILE* fp, NV_U_INT32 num_constituents)
 	    {
   	        require (fgets (string, sizeof (string), fp) != NULL);
 
-		require (sscanf (string, "%s %f %f", tname, &rec.amplitude[i], &rec.epoch[i]) == 3);
+		require (sscanf (string, "%s %f %f", tname, &amp, &epoch) == 3);
+
+		/*  With -c the constituents come from congen_input.txt, which
+		    need not list them in the order of the station data, so
+		    match them by name.  x marks an absent constituent.  */
+
+		if (by_name)
+		{
+		    if (!strcmp (tname, "x")) continue;
+
+		    if ((k = find_constituent (tname)) < 0)
+		    {
+			sprintf (string, "unknown constituent %s", tname);
+			format_barf (string, "build_tide_db.c", __LINE__);
+			exit (-1);
+		    }
+		}
+		else
+		    k = i;
 
 		/*  We don't need no stinkin' negatives!  */
 
-		if (rec.amplitude[i] < 0.0)
+		if (amp < 0.0)
 		{
-		    rec.amplitude[i] = -rec.amplitude[i];
-		    rec.epoch[i] += 180.0;
+		    amp = -amp;
+		    epoch += 180.0;
 		}
 
-		while (rec.epoch[i] < 0.0) rec.epoch[i] += 360.0;
-		rec.epoch[i] = fmod ((NV_FLOAT64) rec.epoch[i], 360.0);
+		while (epoch < 0.0) epoch += 360.0;
+		rec.amplitude[k] = amp;
+		rec.epoch[k] = fmod ((NV_FLOAT64) epoch, 360.0);
 	    }
 
 	    /*  Add the final 0 to the comments record since we stripped
@@ -675,7 +730,8 @@ void CreateTCDFromHarmonics(NV_CHAR* dbname, FILE* fp)
 
     /*  Create the database.  */
 
-    if (!create_tide_db (dbname, constituents,
+    if (!(large_format ? create_large_tide_db : create_tide_db) (dbname,
+			 constituents,
 			 (const NV_CHAR **)constituent,
 			 speed, start_year, num_years,
 			 (const NV_FLOAT32 **)equilibrium,
@@ -736,7 +792,8 @@ void CreateTCDFromNavo(NV_CHAR* dbname)
 
     /*  Create the database.  */
 
-    if (!create_tide_db (dbname, constituents,
+    if (!(large_format ? create_large_tide_db : create_tide_db) (dbname,
+			 constituents,
 			 (const NV_CHAR **)default_constituent,
 			 default_speed, start_year, num_years,
 			 (const NV_FLOAT32 **)equilibrium,
@@ -766,12 +823,57 @@ NV_INT32 main (NV_INT32 argc, char *argv[])
     NV_CHAR                    string[256], dbname[512];
     NV_INT32                   i, cnt = 0;
     NV_BOOL                    xml, navo;
+    NV_U_INT32                 curve = 0;
+    NV_CHAR                    *congen_input = NULL;
+#ifdef HAVE_LIBCONGEN
+    NV_INT32                   first_year = 1970, last_year = 2037;
+#endif
     DB_HEADER_PUBLIC           db;
 
+    /*  -c congen_input -b first_year -e last_year:  take the constituents
+	from congen input instead of the first harmonics file.  The years
+	default to congen's.  */
+    while (argc > 1)
+    {
+	if (!strcmp (argv[1], "-L") || !strcmp (argv[1], "-H") ||
+	    !strcmp (argv[1], "-Z"))
+	{
+	    if (argv[1][1] == 'L') large_format = NVTrue;
+	    else if (argv[1][1] == 'H') curve = TIDE_ORDER_HILBERT;
+	    else curve = TIDE_ORDER_ZORDER;
+	    argv[1] = argv[0];
+	    ++argv;
+	    --argc;
+	}
+	else if (argc > 2 && (!strcmp (argv[1], "-c") ||
+			      !strcmp (argv[1], "-b") || !strcmp (argv[1], "-e")))
+	{
+	    if (argv[1][1] == 'c') congen_input = argv[2];
+#ifdef HAVE_LIBCONGEN
+	    else if (argv[1][1] == 'b') first_year = atoi (argv[2]);
+	    else last_year = atoi (argv[2]);
+#endif
+	    argv[2] = argv[0];
+	    argv += 2;
+	    argc -= 2;
+	}
+	else break;
+    }
+#ifndef HAVE_LIBCONGEN
+    if (congen_input)
+    {
+	fprintf (stderr, "build_tide_db was built without libcongen.  To enable -c, install\nlibcongen and recompile.\n");
+	exit (-1);
+    }
+#endif
+
     if (argc < 3)
     {
         fprintf (stderr, "%s\n", PACKAGE_STRING);
-	fprintf (stderr, "Usage: %s output_tcd_filename input_master_harm [input_child_harm...] [input_xml...] [input_nvo...]\n", argv[0]);
+	fprintf (stderr, "Usage: %s [-L] [-H|-Z] [-c congen_input [-b year] [-e year]] output_tcd_filename input_master_harm [input_child_harm...] [input_xml...] [input_nvo...]\n", argv[0]);
+	fprintf (stderr, "  -L  create the TCD file in the large format (more than 131071\n      reference stations or 2 GB; needs a current libtcd to read)\n");
+	fprintf (stderr, "  -H  when done, order the records along a Hilbert curve over lat/lon\n  -Z  likewise with a Z-order curve\n");
+	fprintf (stderr, "  -c  generate the constituents from congen input for the years -b\n      through -e (default 1970 through 2037); the harmonics files then\n      need no congen block\n");
 	exit(-1);
 
     } else {
@@ -803,11 +905,20 @@ NV_INT32 main (NV_INT32 argc, char *argv[])
     /*  Check to see if the data base file already exists.  If not, we'll create it.  */
     if ((fp = fopen (dbname, "rb+")) == NULL)
     {
-	fprintf(stderr, "\nCreating TCD file from %s\n", argv[2]);
+	fprintf(stderr, "\nCreating TCD file from %s\n",
+		congen_input ? congen_input : argv[2]);
 
 	/*  Check for old NAVO format file.  */
         if (strstr (argv[2], ".nvo")) navo = NVTrue;
 
+#ifdef HAVE_LIBCONGEN
+        /*  Constituents straight from libcongen.  */
+        if (congen_input)
+        {
+	    CreateTCDFromCongen (dbname, congen_input, first_year, last_year,
+				 large_format);
+        } else
+#endif
         /*  NAVO format.  */
         if (navo)
         {
@@ -831,6 +942,12 @@ NV_INT32 main (NV_INT32 argc, char *argv[])
 	already in the .tcd file... */
         fclose (fp);
 
+	if (congen_input)
+	{
+	    fprintf (stderr, "%s already exists; -c only applies when creating a TCD file.\n", dbname);
+	    exit (-1);
+	}
+
         if (!open_tide_db (dbname))
         {
             fprintf (stderr, "Unable to read harmonics database: %s\n", dbname);
@@ -880,11 +997,19 @@ NV_INT32 main (NV_INT32 argc, char *argv[])
 	/*  XTide constituent file.  */
 	else
 	{
-	    cnt += ProcessHarmonicsFile(fp, db.constituents);
+	    cnt += ProcessHarmonicsFile(fp, db.constituents,
+					 congen_input != NULL);
 	}
 	fclose(fp);
     }
 
+    /*  Put neighbouring stations next to each other in the file.  */
+    if (curve && !sort_tide_db_by_location (curve))
+    {
+	fprintf (stderr, "Error ordering the records by location.\n");
+	exit (-1);
+    }
+
     close_tide_db ();
 
     fprintf (stderr, "%d records written\n", cnt);
@@ -0,0 +1,125 @@
+/*****************************************************************************\
+
+                               DISTRIBUTION STATEMENT
+
+     This source file is unclassified, distribution unlimited, public
+     domain.  It is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+\*****************************************************************************/
+
+
+
+/*****************************************************************************\
+
+     Function        CreateTCDFromCongen - creates the TCD file with the
+                     constituents defined in a congen input file
+
+     Synopsis        CreateTCDFromCongen (dbname, input, first_year,
+                         last_year, large);
+
+                     NV_CHAR *dbname         database file name
+                     NV_CHAR *input          congen input file (the format
+                                             of congen_input.txt)
+                     NV_INT32 first_year     first year of the tables
+                     NV_INT32 last_year      last year of the tables
+                     NV_BOOL large           create_large_tide_db instead
+                                             of create_tide_db
+
+     Returns         void; exits on failure
+
+     Date            2026-10-19
+
+     This does in memory what congen, restore_tide_db, and
+     CreateTCDFromHarmonics otherwise do through text:  libcongen
+     computes the speeds, equilibrium arguments, and node factors and
+     makeArrays hands them straight to libtcd.  Constituents are created
+     in the order of the input file.  Speeds are calibrated for 1900,
+     as congen does by default.
+
+     This is the only C++ in tcd-utils.  It is compiled only when
+     configure finds libcongen.
+
+\*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <vector>
+#include <Congen>
+#include <tcd.h>
+
+#if Congen_interfaceRevision != 0
+#error trying to compile with an incompatible version of libcongen
+#endif
+
+
+extern "C" void CreateTCDFromCongen (NV_CHAR *dbname, const NV_CHAR *input,
+                                     NV_INT32 first_year, NV_INT32 last_year,
+                                     NV_BOOL large)
+{
+    std::vector<Congen::Constituent> constituents;
+    char **names;
+    double *speeds;
+    float **equilibrium, **node_factor;
+    NV_U_INT32 i, num_years;
+    unsigned lineno;
+
+    if (first_year < 1 || last_year > 4000 || last_year < first_year)
+    {
+        fprintf (stderr, "Bad year range %d through %d for congen (1 through 4000)\n",
+                 first_year, last_year);
+        exit (-1);
+    }
+    num_years = last_year - first_year + 1;
+
+    std::ifstream is (input);
+    if (!is)
+    {
+        perror (input);
+        exit (-1);
+    }
+    lineno = Congen::parseLegacyInput (is, first_year, last_year, 1900,
+                                       constituents);
+    if (lineno)
+    {
+        fprintf (stderr, "%s: error on input line %u\n", input, lineno);
+        exit (-1);
+    }
+    if (constituents.empty())
+    {
+        fprintf (stderr, "%s: no constituents defined\n", input);
+        exit (-1);
+    }
+    if (constituents.size() > MAX_CONSTITUENTS)
+    {
+        fprintf (stderr, "libtcd fatal error:  exceeded MAX_CONSTITUENTS compiled-in limit %d.  Change limit and recompile.\n", MAX_CONSTITUENTS);
+        exit (-1);
+    }
+
+    Congen::makeArrays (constituents, names, speeds, equilibrium,
+                        node_factor);
+
+    if (!(large ? create_large_tide_db : create_tide_db) (dbname,
+                         constituents.size(),
+                         (const NV_CHAR **)names,
+                         speeds, first_year, num_years,
+                         (const NV_FLOAT32 **)equilibrium,
+                         (const NV_FLOAT32 **)node_factor))
+    {
+        fprintf (stderr, "Error creating data base file.\n");
+        exit (-1);
+    }
+
+    for (i = 0 ; i < constituents.size() ; i++)
+    {
+        delete [] names[i];
+        delete [] equilibrium[i];
+        delete [] node_factor[i];
+    }
+    delete [] names;
+    delete [] speeds;
+    delete [] equilibrium;
+    delete [] node_factor;
+}
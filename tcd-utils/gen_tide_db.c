@@ -0,0 +1,448 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <tcd.h>
+
+
+/*****************************************************************************\
+
+                            DISTRIBUTION STATEMENT
+
+    This source file is unclassified, distribution unlimited, public
+    domain.  It is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+\*****************************************************************************/
+
+
+
+/*****************************************************************************\
+
+    Program         gen_tide_db - writes a synthetic harmonic constituent
+                    database for scaling tests.
+
+    Synopsis        gen_tide_db [options] OUTPUT_DB_NAME MASTER_HARMONIC_NAME
+
+                    OUTPUT_DB_NAME          database name, the extension .tcd
+                                            will be appended to the name if
+                                            not already there; an existing
+                                            file is overwritten
+                    MASTER_HARMONIC_NAME    ASCII harmonics file whose congen
+                                            block (constituents, speeds,
+                                            equilibrium arguments, and node
+                                            factors) is used for the
+                                            database, e.g. new.head.txt.
+                                            Any stations in it are ignored.
+
+                    -n count       number of stations (default 100000)
+                    -s seed        random seed (default 1)
+                    -d layout      spatial distribution:  uniform (over the
+                                   sphere, the default), cluster (around
+                                   one centre per 1000 stations), or grid
+                                   (regular lat/lon grid, ignores the seed)
+                    -c density     fraction of constituents with a nonzero
+                                   amplitude in each reference station
+                                   (default 0.2)
+                    -m bytes       mean length of the comments field
+                                   (default 64)
+                    -r ratio       fraction of stations that are
+                                   subordinate stations (default 0.25)
+                    -L             large TCD format (see create_large_tide_db);
+                                   implied by more than 131071 stations
+
+    Returns         0 on success, -1 on failure
+
+    The same options and seed always give the same records.  Only the
+    [LAST MODIFIED] line of the header differs between runs.
+
+    Date            2026-10-19
+
+\*****************************************************************************/
+
+
+#define DEFAULT_STATIONS       100000
+#define DEFAULT_DENSITY        0.2
+#define DEFAULT_COMMENT_BYTES  64
+#define DEFAULT_SUB_RATIO      0.25
+#define CLUSTER_STATIONS       1000
+#define CLUSTER_SIGMA          1.0     /* degrees */
+#define V2_MAX_STATIONS        131071
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+/*  A 32-bit LCG so that the output doesn't depend on the C library's
+    rand.  */
+
+static unsigned long seed, first_seed;
+
+static double next_uniform ()
+{
+    seed = (seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+    return (seed >> 1) / 2147483648.0;
+}
+
+static double next_gaussian ()
+{
+    double u = next_uniform ();
+
+    if (u < 1e-12) u = 1e-12;
+    return sqrt (-2.0 * log (u)) * cos (2.0 * M_PI * next_uniform ());
+}
+
+
+/*  Returns the next whitespace-separated token of the congen block,
+    skipping comment lines, or NULL at end of file.  */
+
+static char *next_token (FILE *fp, char *tok, size_t len)
+{
+    char                    fmt[16];
+
+    sprintf (fmt, "%%%us", (unsigned) len - 1);
+    while (fscanf (fp, fmt, tok) == 1)
+    {
+        if (tok[0] != '#') return tok;
+        if (!fgets (tok, len, fp)) break;
+    }
+    return NULL;
+}
+
+
+static void format_error (const char *file, const char *what)
+{
+    fprintf (stderr, "gen_tide_db: %s: bad congen block (%s)\n", file, what);
+    exit (-1);
+}
+
+
+/*  Reads a table of equilibrium arguments or node factors:  for each
+    constituent its name followed by num_years values.  */
+
+static NV_FLOAT32 **read_table (FILE *fp, const char *file, NV_CHAR **name,
+NV_U_INT32 constituents, NV_U_INT32 num_years)
+{
+    NV_FLOAT32              **table;
+    NV_U_INT32              i, j;
+    char                    tok[256];
+
+    if ((table = (NV_FLOAT32 **) malloc (constituents * sizeof (NV_FLOAT32 *)))
+        == NULL)
+    {
+        perror ("Allocating table");
+        exit (-1);
+    }
+    for (i = 0 ; i < constituents ; i++)
+    {
+        if (!next_token (fp, tok, sizeof (tok)) || strcmp (tok, name[i]))
+            format_error (file, "constituent names don't match");
+        if ((table[i] = (NV_FLOAT32 *) malloc (num_years *
+            sizeof (NV_FLOAT32))) == NULL)
+        {
+            perror ("Allocating table");
+            exit (-1);
+        }
+        for (j = 0 ; j < num_years ; j++)
+        {
+            if (!next_token (fp, tok, sizeof (tok)))
+                format_error (file, "table ends early");
+            table[i][j] = atof (tok);
+        }
+    }
+    if (!next_token (fp, tok, sizeof (tok)) || strcmp (tok, "*END*"))
+        format_error (file, "missing *END*");
+    return table;
+}
+
+
+/*  Reads the congen block of a harmonics file and creates dbname from
+    it.  */
+
+static void create_db (const char *dbname, const char *file, NV_BOOL large)
+{
+    FILE                    *fp;
+    NV_CHAR                 **name;
+    NV_FLOAT64              *speed;
+    NV_FLOAT32              **equilibrium, **node_factor;
+    NV_U_INT32              constituents, num_years, i;
+    NV_INT32                start_year;
+    NV_BOOL                 ok;
+    char                    tok[256];
+
+    if ((fp = fopen (file, "r")) == NULL)
+    {
+        perror (file);
+        exit (-1);
+    }
+
+    if (!next_token (fp, tok, sizeof (tok)) ||
+        sscanf (tok, "%u", &constituents) != 1 || !constituents ||
+        constituents > MAX_CONSTITUENTS)
+        format_error (file, "number of constituents");
+
+    name = (NV_CHAR **) malloc (constituents * sizeof (NV_CHAR *));
+    speed = (NV_FLOAT64 *) malloc (constituents * sizeof (NV_FLOAT64));
+    if (!name || !speed)
+    {
+        perror ("Allocating constituents");
+        exit (-1);
+    }
+    for (i = 0 ; i < constituents ; i++)
+    {
+        if (!next_token (fp, tok, sizeof (tok)))
+            format_error (file, "constituent speeds");
+        name[i] = strdup (tok);
+        if (!next_token (fp, tok, sizeof (tok)) ||
+            sscanf (tok, "%lf", &speed[i]) != 1)
+            format_error (file, "constituent speeds");
+    }
+
+    if (!next_token (fp, tok, sizeof (tok)) ||
+        sscanf (tok, "%d", &start_year) != 1)
+        format_error (file, "start year");
+    if (!next_token (fp, tok, sizeof (tok)) ||
+        sscanf (tok, "%u", &num_years) != 1 || !num_years)
+        format_error (file, "number of years");
+    equilibrium = read_table (fp, file, name, constituents, num_years);
+
+    if (!next_token (fp, tok, sizeof (tok)) ||
+        strtoul (tok, NULL, 10) != num_years)
+        format_error (file, "node factor years don't match");
+    node_factor = read_table (fp, file, name, constituents, num_years);
+    fclose (fp);
+
+    ok = (large ? create_large_tide_db : create_tide_db) (dbname,
+        constituents, (NV_CHAR const * const *) name, speed, start_year,
+        num_years, (NV_FLOAT32 const * const *) equilibrium,
+        (NV_FLOAT32 const * const *) node_factor);
+    if (!ok)
+    {
+        fprintf (stderr, "Error creating data base file.\n");
+        exit (-1);
+    }
+
+    for (i = 0 ; i < constituents ; i++)
+    {
+        free (name[i]);
+        free (equilibrium[i]);
+        free (node_factor[i]);
+    }
+    free (name);
+    free (speed);
+    free (equilibrium);
+    free (node_factor);
+}
+
+
+/*  Fills s with about mean bytes of filler text.  */
+
+static void make_comment (NV_CHAR *s, NV_U_INT32 mean)
+{
+    static const char       *words[] = {"synthetic", "station", "grid",
+                                        "point", "model", "derived",
+                                        "harmonics", "scaling", "test",
+                                        "not", "for", "navigation"};
+    NV_U_INT32              len, n = 0, w;
+
+    len = (NV_U_INT32) (next_uniform () * 2 * mean);
+    if (len > MONOLOGUE_LENGTH - 1) len = MONOLOGUE_LENGTH - 1;
+
+    s[0] = '\0';
+    while (n < len)
+    {
+        w = (NV_U_INT32) (next_uniform () *
+            (sizeof (words) / sizeof (words[0])));
+        n += snprintf (s + n, MONOLOGUE_LENGTH - n, n ? " %s" : "%s",
+            words[w]);
+        if (n >= MONOLOGUE_LENGTH) n = MONOLOGUE_LENGTH - 1;
+    }
+    s[len] = '\0';
+}
+
+
+/*  Offsets for subordinate stations are HHMM with 0 <= MM < 60.  */
+
+static NV_INT32 random_time_add ()
+{
+    NV_INT32 m = (NV_INT32) (next_uniform () * 241) - 120;
+
+    return m < 0 ? -((-m) / 60 * 100 + (-m) % 60) : m / 60 * 100 + m % 60;
+}
+
+
+int main (int argc, char *argv[])
+{
+    static TIDE_RECORD      rec;
+    DB_HEADER_PUBLIC        db;
+    NV_CHAR                 dbname[512];
+    const char              *layout = "uniform";
+    double                  density = DEFAULT_DENSITY,
+                            sub_ratio = DEFAULT_SUB_RATIO,
+                            lat, lon, *centre = NULL;
+    NV_U_INT32              stations = DEFAULT_STATIONS,
+                            comment_bytes = DEFAULT_COMMENT_BYTES,
+                            clusters = 1, rows = 1, cols = 1, i, j;
+    NV_INT32                *refs, nrefs = 0, m2, tzfile, restriction,
+                            datum, level_units, dir_units;
+    NV_BOOL                 large = NVFalse;
+    int                     a;
+
+    seed = 1;
+    for (a = 1 ; a < argc && argv[a][0] == '-' && argv[a][1] ; a++)
+    {
+        if (!strcmp (argv[a], "-L"))
+            large = NVTrue;
+        else if (a + 1 < argc && !strcmp (argv[a], "-n"))
+            stations = strtoul (argv[++a], NULL, 10);
+        else if (a + 1 < argc && !strcmp (argv[a], "-s"))
+            seed = strtoul (argv[++a], NULL, 10) & 0xffffffffUL;
+        else if (a + 1 < argc && !strcmp (argv[a], "-d"))
+            layout = argv[++a];
+        else if (a + 1 < argc && !strcmp (argv[a], "-c"))
+            density = atof (argv[++a]);
+        else if (a + 1 < argc && !strcmp (argv[a], "-m"))
+            comment_bytes = strtoul (argv[++a], NULL, 10);
+        else if (a + 1 < argc && !strcmp (argv[a], "-r"))
+            sub_ratio = atof (argv[++a]);
+        else
+            break;
+    }
+
+    if (argc - a != 2 || !stations || density < 0.0 || density > 1.0 ||
+        sub_ratio < 0.0 || sub_ratio >= 1.0 || (strcmp (layout, "uniform")
+        && strcmp (layout, "cluster") && strcmp (layout, "grid")))
+    {
+        fprintf (stderr, "%s\n", PACKAGE_STRING);
+        fprintf (stderr, "Usage: %s [-n stations] [-s seed] [-d uniform|cluster|grid] [-c density]\n       [-m comment_bytes] [-r subordinate_ratio] [-L] output_tcd_filename\n       input_master_harm\n", argv[0]);
+        exit (-1);
+    }
+
+    strcpy (dbname, argv[a]);
+    if (!strstr (dbname, ".tcd")) strcat (dbname, ".tcd");
+
+    first_seed = seed;
+    if (stations > V2_MAX_STATIONS) large = NVTrue;
+    create_db (dbname, argv[a + 1], large);
+    db = get_tide_db_header ();
+
+    m2 = find_constituent ("M2");
+    if (m2 < 0) m2 = 0;
+    tzfile = find_or_add_tzfile (":UTC", NULL);
+    restriction = find_or_add_restriction ("Non-commercial use only", NULL);
+    datum = find_datum ("Mean Lower Low Water");
+    level_units = find_level_units ("meters");
+    dir_units = find_dir_units ("degrees true");
+
+    if (!strcmp (layout, "cluster"))
+    {
+        clusters = (stations + CLUSTER_STATIONS - 1) / CLUSTER_STATIONS;
+        if ((centre = (double *) malloc (2 * clusters * sizeof (double))) ==
+            NULL)
+        {
+            perror ("Allocating clusters");
+            exit (-1);
+        }
+        for (i = 0 ; i < clusters ; i++)
+        {
+            centre[2 * i] = asin (2.0 * next_uniform () - 1.0) * 180.0 / M_PI;
+            centre[2 * i + 1] = next_uniform () * 360.0 - 180.0;
+        }
+    }
+    else if (!strcmp (layout, "grid"))
+    {
+        rows = (NV_U_INT32) ceil (sqrt (stations / 2.0));
+        cols = (stations + rows - 1) / rows;
+    }
+
+    if ((refs = (NV_INT32 *) malloc (stations * sizeof (NV_INT32))) == NULL)
+    {
+        perror ("Allocating reference list");
+        exit (-1);
+    }
+
+    for (i = 0 ; i < stations ; i++)
+    {
+        if (!strcmp (layout, "grid"))
+        {
+            lat = -90.0 + 180.0 * (i / cols + 0.5) / rows;
+            lon = -180.0 + 360.0 * (i % cols + 0.5) / cols;
+        }
+        else if (!strcmp (layout, "cluster"))
+        {
+            j = (NV_U_INT32) (next_uniform () * clusters);
+            lat = centre[2 * j] + next_gaussian () * CLUSTER_SIGMA;
+            lon = centre[2 * j + 1] + next_gaussian () * CLUSTER_SIGMA;
+            if (lat > 90.0) lat = 90.0;
+            if (lat < -90.0) lat = -90.0;
+            if (lon >= 180.0) lon -= 360.0;
+            if (lon < -180.0) lon += 360.0;
+        }
+        else
+        {
+            lat = asin (2.0 * next_uniform () - 1.0) * 180.0 / M_PI;
+            lon = next_uniform () * 360.0 - 180.0;
+        }
+
+        memset (&rec, 0, sizeof (TIDE_RECORD));
+        rec.header.latitude = lat;
+        rec.header.longitude = lon;
+        rec.header.tzfile = tzfile;
+        sprintf (rec.header.name, "Synthetic station %u", i);
+        rec.restriction = restriction;
+        rec.min_direction = rec.max_direction = 361;
+        rec.direction_units = dir_units;
+        rec.level_units = level_units;
+        rec.confidence = 10;
+        sprintf (rec.source, "gen_tide_db seed %lu", first_seed);
+        make_comment (rec.comments, comment_bytes);
+
+        if (nrefs && next_uniform () < sub_ratio)
+        {
+            rec.header.record_type = SUBORDINATE_STATION;
+            rec.header.reference_station =
+                refs[(NV_U_INT32) (next_uniform () * nrefs)];
+            rec.min_time_add = random_time_add ();
+            rec.max_time_add = random_time_add ();
+            rec.min_level_add = next_uniform () - 0.5;
+            rec.max_level_add = next_uniform () - 0.5;
+            rec.min_level_multiply = 0.8 + 0.4 * next_uniform ();
+            rec.max_level_multiply = 0.8 + 0.4 * next_uniform ();
+            rec.flood_begins = rec.ebb_begins = NULLSLACKOFFSET;
+        }
+        else
+        {
+            rec.header.record_type = REFERENCE_STATION;
+            rec.header.reference_station = -1;
+            rec.datum = datum;
+            rec.datum_offset = 3.0 * next_uniform ();
+            for (j = 0 ; j < db.constituents ; j++)
+            {
+                if ((NV_INT32) j == m2)
+                    rec.amplitude[j] = 0.1 + 1.9 * next_uniform ();
+                else if (next_uniform () < density)
+                    rec.amplitude[j] = 0.5 * next_uniform () *
+                        next_uniform ();
+                else
+                    continue;
+                rec.epoch[j] = 360.0 * next_uniform ();
+            }
+            refs[nrefs++] = i;
+        }
+
+        if (!add_tide_record (&rec, NULL))
+        {
+            fprintf (stderr, "gen_tide_db: add_tide_record failed at station %u\n", i);
+            exit (-1);
+        }
+    }
+
+    close_tide_db ();
+    fprintf (stderr, "%u records written (%d reference)\n", stations, nrefs);
+
+    free (refs);
+    free (centre);
+    return 0;
+}
@@ -1,9 +1,14 @@
 #!/bin/sh
 set -e
+opts=
+while [ "${1#-}" != "$1" ]; do
+  opts="$opts $1"
+  shift
+done
 if [ -z "$2" ]; then
-  echo Usage: rewrite_tide_db infile outfile
+  echo "Usage: rewrite_tide_db [-L] [-H|-Z] infile outfile"
   exit
 fi
 restore_tide_db "$1" deleteme
-build_tide_db "$2" deleteme.txt deleteme.xml
+build_tide_db $opts "$2" deleteme.txt deleteme.xml
 rm deleteme.txt deleteme.xml